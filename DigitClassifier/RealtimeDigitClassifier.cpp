@@ -13,12 +13,401 @@
 
 ******************************************************************************/
 #include "opencv2/opencv.hpp"
+#include "BinaryImage.h"
 #include "HogSvm.h"
-
+#include "ModelReloader.h"
+#include "SimdKernels.h"
+
+//Models compiled into the executable by ModelCompiler (no model files needed)
+#if defined(EMBEDDED_MODELS)
+#include "MnistClassifierModel.h"
+#include "DigitDetectorModel.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <future>
 #include <iostream>
+#include <string>
+#include <tuple>
 
 using namespace cv;
 
+//Set by SIGHUP to reload the models
+static std::atomic<bool> s_reloadSignaled(false);
+
+//Bounding box and pixel count of a connected blob of foreground pixels
+typedef BinaryImage::Blob Blob;
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Signal handler requesting the models be reloaded
+//
+// PARAMETERS:
+//  int - signal number (unused)
+///////////////////////////////////////////////////////////////////////////////
+void OnReloadSignal(int)
+{
+    s_reloadSignaled = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Fill the holes of the blobs of a binary image: the background not 
+//  reachable (4-connected) from outside the image is set
+//
+// PARAMETERS:
+//  binary - binary image (may be a region of a larger image)
+//  filled - reference to return the filled image
+//
+///////////////////////////////////////////////////////////////////////////////
+void FillHoles(const Mat &binary, Mat &filled)
+{
+    //Flood the background from a border around the image
+    Mat background;
+    copyMakeBorder(binary, background, 1, 1, 1, 1, BORDER_CONSTANT, Scalar(0));
+    floodFill(background, Point(0, 0), Scalar(255));
+
+    filled = binary | (background(Rect(1, 1, binary.cols, binary.rows)) == 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Find the external blobs of a binary image with connected component 
+//  labelling (8-connected like findContours). The holes are filled first, 
+//  so a blob in the hole of another (e.g. in the 0 of a digit) is part of 
+//  it, as findContours with CV_RETR_EXTERNAL would find; blob areas include
+//  the holes. OpenCV labels the image in parallel strips and measures the 
+//  bounding boxes and pixel counts in the same pass, so no contours are 
+//  traced.
+//
+// PARAMETERS:
+//  binary - binary image (may be a region of a larger image)
+//  blobs - reference to return the blobs
+//
+///////////////////////////////////////////////////////////////////////////////
+void FindBlobs(const Mat &binary, std::vector<Blob> &blobs)
+{
+    Mat filled;
+    FillHoles(binary, filled);
+
+    Mat labels;
+    Mat stats;
+    Mat centroids;
+    const int count = connectedComponentsWithStats(filled, labels, stats, centroids, 8, CV_32S, CCL_DEFAULT);
+
+    //Label 0 is the background
+    blobs.clear();
+    for (int label = 1; label < count; label++)
+    {
+        const int *stat = stats.ptr<int>(label);
+        Blob blob;
+        blob.box = Rect(stat[CC_STAT_LEFT], stat[CC_STAT_TOP], stat[CC_STAT_WIDTH], stat[CC_STAT_HEIGHT]);
+        blob.area = stat[CC_STAT_AREA];
+        blobs.push_back(blob);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Clean a thresholded frame and find the digit blobs in the region of 
+//  interest with 8-bit images. This is the reference for 
+//  FindDigitBlobsPacked().
+//
+// PARAMETERS:
+//  frame - thresholded frame, returned cleaned
+//  roi - region of interest
+//  blobs - reference to return the blobs (frame coordinates)
+//
+///////////////////////////////////////////////////////////////////////////////
+void FindDigitBlobs(Mat &frame, const Rect &roi, std::vector<Blob> &blobs)
+{
+    //Floodfill outside of roi to eliminate noise at edges of image
+    floodFill(frame, roi.tl(), Scalar(0));
+    floodFill(frame, Point(roi.x, roi.y + roi.height), Scalar(0)); //bl
+    floodFill(frame, roi.br(), Scalar(0));
+    floodFill(frame, Point(roi.x + roi.width, roi.y), Scalar(0)); //tr 
+
+    //Close any holes
+    morphologyEx(frame, frame, MORPH_CLOSE, getStructuringElement(MORPH_ELLIPSE, Size(3, 3)));
+
+    //Find the blobs in the roi (labelled in place)
+    FindBlobs(frame(roi), blobs);
+    for (Blob &blob : blobs)
+    {
+        blob.box = blob.box + Point(roi.x, roi.y);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Clean a thresholded frame and find the digit blobs in the region of 
+//  interest with a bit-packed image. The flood fills, close and blob 
+//  extraction of FindDigitBlobs() work on 1 bit per pixel and the frame is 
+//  unpacked once at the end for display and cropping.
+//
+// PARAMETERS:
+//  frame - thresholded frame, returned cleaned
+//  roi - region of interest
+//  blobs - reference to return the blobs (frame coordinates)
+//
+///////////////////////////////////////////////////////////////////////////////
+void FindDigitBlobsPacked(Mat &frame, const Rect &roi, std::vector<Blob> &blobs)
+{
+    BinaryImage binary;
+    binary.FromMat(frame);
+
+    //Clear the blobs at the roi corners (noise at edges of image)
+    const std::vector<Point> corners = { roi.tl(), Point(roi.x, roi.y + roi.height), 
+                                         roi.br(), Point(roi.x + roi.width, roi.y) };
+    binary.ClearBlobsAt(corners);
+
+    //Close any holes
+    binary.Close();
+
+    //Find the external blobs in the roi (labelled with their holes filled)
+    BinaryImage filled = binary;
+    filled.FillHoles(roi);
+    filled.FindBlobs(roi, 8, blobs);
+    binary.ToMat(frame);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Check the packed and 8-bit digit blob paths give the same frame and blobs
+//
+// PARAMETERS:
+//  frame - thresholded frame (unchanged)
+//  roi - region of interest
+//
+// RETURNS:
+//  true if the results are identical
+///////////////////////////////////////////////////////////////////////////////
+bool CheckPackedBlobs(const Mat &frame, const Rect &roi)
+{
+    Mat reference = frame.clone();
+    Mat packed = frame.clone();
+    std::vector<Blob> referenceBlobs;
+    std::vector<Blob> packedBlobs;
+    FindDigitBlobs(reference, roi, referenceBlobs);
+    FindDigitBlobsPacked(packed, roi, packedBlobs);
+
+    //Compare the blobs in raster order (the label order is not guaranteed),
+    //ordering blobs with the same top left corner by size
+    const auto rasterOrder = [](const Blob &a, const Blob &b)
+    {
+        return std::make_tuple(a.box.y, a.box.x, a.box.height, a.box.width, a.area) <
+               std::make_tuple(b.box.y, b.box.x, b.box.height, b.box.width, b.area);
+    };
+    std::sort(referenceBlobs.begin(), referenceBlobs.end(), rasterOrder);
+    std::sort(packedBlobs.begin(), packedBlobs.end(), rasterOrder);
+
+    bool equal = (norm(reference, packed, NORM_INF) == 0) && (referenceBlobs.size() == packedBlobs.size());
+    for (size_t i = 0; i < referenceBlobs.size() && equal; i++)
+    {
+        equal = (referenceBlobs[i].box == packedBlobs[i].box) && (referenceBlobs[i].area == packedBlobs[i].area);
+    }
+
+    return equal;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compare the time to find the digit bounding boxes of a synthetic frame 
+//  with findContours + boundingRect (on a clone of the region of interest) 
+//  and with FindBlobs (on the region of interest in place), and the time to
+//  clean the frame and find the blobs with 8-bit and bit-packed images
+//
+// RETURNS:
+//  0 if the benchmark completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunBlobBenchmark()
+{
+    //Dark digits on a light background, thresholded as in ProcessFrame
+    Mat frame(480, 640, CV_8UC1, Scalar(230));
+    RNG rng(0x5EED);
+    for (int i = 0; i < 24; i++)
+    {
+        const Point origin(100 + (i % 6) * 75, 140 + (i / 6) * 70);
+        putText(frame, std::to_string(rng.uniform(0, 10)), origin, FONT_HERSHEY_SIMPLEX, 1.8, Scalar(20), 5);
+    }
+    threshold(frame, frame, 110, 255, THRESH_BINARY_INV);
+    const Rect roi(80, 60, 480, 360);
+
+    const int iterations = 200;
+    size_t contourCount = 0;
+    size_t blobCount = 0;
+
+    TickMeter contourTimer;
+    contourTimer.start();
+    for (int i = 0; i < iterations; i++)
+    {
+        std::vector<std::vector<Point>> contours;
+        Mat contourFrame = frame(roi).clone();
+        findContours(contourFrame, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
+
+        std::vector<Rect> boundRects;
+        for (const auto &contour : contours)
+        {
+            boundRects.push_back(boundingRect(contour));
+        }
+        contourCount = boundRects.size();
+    }
+    contourTimer.stop();
+
+    TickMeter blobTimer;
+    blobTimer.start();
+    for (int i = 0; i < iterations; i++)
+    {
+        std::vector<Blob> blobs;
+        FindBlobs(frame(roi), blobs);
+        blobCount = blobs.size();
+    }
+    blobTimer.stop();
+
+    //Whole post-threshold stage (flood fills, close and blobs)
+    size_t referenceCount = 0;
+    size_t packedCount = 0;
+    TickMeter referenceTimer;
+    TickMeter packedTimer;
+    for (int i = 0; i < iterations; i++)
+    {
+        std::vector<Blob> blobs;
+        Mat referenceFrame = frame.clone();
+        referenceTimer.start();
+        FindDigitBlobs(referenceFrame, roi, blobs);
+        referenceTimer.stop();
+        referenceCount = blobs.size();
+
+        Mat packedFrame = frame.clone();
+        packedTimer.start();
+        FindDigitBlobsPacked(packedFrame, roi, blobs);
+        packedTimer.stop();
+        packedCount = blobs.size();
+    }
+
+    std::cout << "findContours + boundingRect: " << contourTimer.getTimeMicro() / iterations << " us/frame, "
+              << contourCount << " boxes" << std::endl
+              << "Connected components: " << blobTimer.getTimeMicro() / iterations << " us/frame, "
+              << blobCount << " boxes" << std::endl
+              << "8-bit clean + blobs: " << referenceTimer.getTimeMicro() / iterations << " us/frame, "
+              << referenceCount << " boxes" << std::endl
+              << "Bit-packed clean + blobs: " << packedTimer.getTimeMicro() / iterations << " us/frame, "
+              << packedCount << " boxes" << std::endl
+              << "Bit-packed matches 8-bit: " << (CheckPackedBlobs(frame, roi) ? "yes" : "NO") << std::endl;
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Check the packed and 8-bit digit blob paths give the same frame and blobs
+//  on varied thresholded frames: empty and full frames, odd widths, random 
+//  noise, digits, rings with blobs in their holes and bars crossing the 
+//  edges of the region of interest, each with the centred region of 
+//  interest of ProcessFrame and random ones
+//
+// RETURNS:
+//  0 if the paths match on every frame
+///////////////////////////////////////////////////////////////////////////////
+int RunBlobCheck()
+{
+    const Size sizes[] = { Size(640, 480), Size(641, 479), Size(129, 67), Size(63, 200), Size(3, 3) };
+    const char *variants[] = { "empty", "full", "sparse noise", "noise", "dense noise", "digits", "rings", "edge bars" };
+    const int variantCount = sizeof(variants) / sizeof(variants[0]);
+    const int roiCount = 4;
+
+    RNG rng(0xB10B);
+    int checks = 0;
+    int failures = 0;
+    for (const Size &size : sizes)
+    {
+        for (int r = 0; r < roiCount; r++)
+        {
+            //The centred roi of ProcessFrame, then random ones (the flood fill
+            //seeds at the roi corners must be inside the frame)
+            Rect roi(static_cast<int>(size.width * 0.125f), static_cast<int>(size.height * 0.125f),
+                     static_cast<int>(size.width * 0.75f), static_cast<int>(size.height * 0.75f));
+            if (r > 0)
+            {
+                roi.x = rng.uniform(0, size.width - 1);
+                roi.y = rng.uniform(0, size.height - 1);
+                roi.width = rng.uniform(1, size.width - roi.x);
+                roi.height = rng.uniform(1, size.height - roi.y);
+            }
+
+            for (int variant = 0; variant < variantCount; variant++)
+            {
+                Mat frame(size, CV_8UC1, Scalar(0));
+                switch (variant)
+                {
+                case 1:
+                    frame.setTo(Scalar(255));
+                    break;
+
+                case 2:
+                case 3:
+                case 4:
+                {
+                    const double density[] = { 0.05, 0.3, 0.6 };
+                    Mat noise(size, CV_8UC1);
+                    rng.fill(noise, RNG::UNIFORM, 0, 256);
+                    threshold(noise, frame, 255 * (1 - density[variant - 2]), 255, THRESH_BINARY);
+                    break;
+                }
+
+                case 5:
+                    for (int i = 0; i < 12; i++)
+                    {
+                        const Point origin(rng.uniform(-20, size.width), rng.uniform(0, size.height + 20));
+                        putText(frame, std::to_string(rng.uniform(0, 10)), origin, FONT_HERSHEY_SIMPLEX,
+                                rng.uniform(0.5, 2.0), Scalar(255), rng.uniform(1, 6));
+                    }
+                    break;
+
+                case 6:
+                    for (int i = 0; i < 8; i++)
+                    {
+                        const Point center(rng.uniform(0, size.width), rng.uniform(0, size.height));
+                        const int radius = rng.uniform(4, 30);
+                        circle(frame, center, radius, Scalar(255), 2);
+                        circle(frame, center, radius / 3, Scalar(255), -1);
+                    }
+                    break;
+
+                case 7:
+                    for (int i = 0; i < 4; i++)
+                    {
+                        const int along = rng.uniform(0, std::max(roi.width, roi.height));
+                        rectangle(frame, Rect(roi.x - 3, roi.y + along % roi.height, 7, 3), Scalar(255), -1);
+                        rectangle(frame, Rect(roi.x + roi.width - 4, roi.y + along % roi.height, 7, 3), Scalar(255), -1);
+                        rectangle(frame, Rect(roi.x + along % roi.width, roi.y - 3, 3, 7), Scalar(255), -1);
+                        rectangle(frame, Rect(roi.x + along % roi.width, roi.y + roi.height - 4, 3, 7), Scalar(255), -1);
+                    }
+                    break;
+
+                default:
+                    break;
+                }
+
+                checks++;
+                if (CheckPackedBlobs(frame, roi) == false)
+                {
+                    failures++;
+                    std::cout << "Bit-packed blobs differ: " << size.width << "x" << size.height << " "
+                              << variants[variant] << " frame, roi " << roi.x << "," << roi.y << " "
+                              << roi.width << "x" << roi.height << std::endl;
+                }
+            }
+        }
+    }
+
+    std::cout << "Bit-packed matches 8-bit on " << checks - failures << " of " << checks << " frames" << std::endl;
+
+    return (failures == 0) ? 0 : 1;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
 //  Process an image frame 
@@ -47,85 +436,169 @@ void ProcessFrame(const HogSvm &classifier, const HogSvm &detector, Mat &display
                     static_cast<int>(frame.rows * size));
     rectangle(displayFrame, roi.tl(), roi.br(), Scalar(0, 0, 255));
 
-    //Floodfill outside of roi to eliminate noise at edges of image
-    floodFill(frame, roi.tl(), Scalar(0));
-    floodFill(frame, Point(roi.x, roi.y + roi.height), Scalar(0)); //bl
-    floodFill(frame, roi.br(), Scalar(0));
-    floodFill(frame, Point(roi.x + roi.width, roi.y), Scalar(0)); //tr 
-
-    //Close any holes
-    morphologyEx(frame, frame, MORPH_CLOSE, getStructuringElement(MORPH_ELLIPSE, Size(3, 3)));
+#ifdef _DEBUG
+    //Verify the bit-packed path against the 8-bit reference (--blob-check 
+    //covers varied frames in any build)
+    if (CheckPackedBlobs(frame, roi) == false)
+    {
+        std::cout << "Bit-packed blobs differ from the 8-bit reference" << std::endl;
+    }
+#endif
 
-    //Find the contours in the roi
-    std::vector<std::vector<Point>> contours;
-    Mat contourFrame = frame(roi).clone();
-    findContours(contourFrame, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
+    //Remove noise at the edges of the roi, close any holes and find the blobs
+    std::vector<Blob> blobs;
+    FindDigitBlobsPacked(frame, roi, blobs);
 
     RNG rng;
-    Rect boundRect;
+    std::vector<Rect> boundRects;
+    std::vector<Mat> images;
+    std::vector<std::future<SvmModel::Prediction>> detections;
 
-    //Perform classification in the image inside each contour's bounding rectangle
-    //and draw bounding rectangles with digit value for classified images    
-    for (int i = 0; i < contours.size(); i++)
+    //Queue detection of the image inside each blob's bounding rectangle.
+    //Requests are predicted in batches while the remaining images are prepared.
+    for (const Blob &blob : blobs)
     {
-        //Get bounding rectangle for this contour
-        boundRect = boundingRect(contours[i]);
-        boundRect += Point(roi.x, roi.y);
+        const Rect &boundRect = blob.box;
 
-        //Get the image contained in the bounding rectangle
-        Mat image = frame(Rect(boundRect.x, boundRect.y, boundRect.width, boundRect.height)).clone();
-            
-        //Extract the area inside the bounding rectangle and add black border padding
+        //Copy the area inside the bounding rectangle with black border padding
         //MNIST digits are padded with 4 pixels on each side of a 20 pixel image (4/20 = 0.2)
+        Mat image;
         const int hpad = static_cast<int>(boundRect.height * 0.2);             
         const int wpad = static_cast<int>(boundRect.width * 0.2);
-        copyMakeBorder(image, image, hpad, hpad, wpad, wpad, BORDER_CONSTANT, 0);
+        copyMakeBorder(frame(boundRect), image, hpad, hpad, wpad, wpad, BORDER_CONSTANT, 0);
 
         //Dilate to fatten the digit lines
         //dilate(image, image, getStructuringElement(MORPH_ELLIPSE, Size(3, 3)));
             
         //Does the image contain a digit?
-        float detect = detector.Predict(image);            
-        if (detect > 0)
+        boundRects.push_back(boundRect);
+        images.push_back(image);
+        detections.push_back(detector.PredictAsync(image));
+    }
+
+    //Queue classification of the images containing a digit
+    std::vector<int> digitIndex;
+    std::vector<std::future<SvmModel::Prediction>> classifications;
+    for (size_t i = 0; i < detections.size(); i++)
+    {
+        if (detections[i].get().label > 0)
         {
-            //Draw bounding rectangle with random color
-            Scalar color = Scalar(rng.uniform(0, 255), rng.uniform(0, 255), rng.uniform(0, 255));
-            rectangle(displayFrame, boundRect.tl(), boundRect.br(), color, 2);
+            digitIndex.push_back(static_cast<int>(i));
+            classifications.push_back(classifier.PredictAsync(images[i]));
+        }
+    }
+
+    //Draw bounding rectangles with digit value for classified images
+    for (size_t d = 0; d < classifications.size(); d++)
+    {
+        const Rect &boundRect = boundRects[digitIndex[d]];
+
+        //Draw bounding rectangle with random color
+        Scalar color = Scalar(rng.uniform(0, 255), rng.uniform(0, 255), rng.uniform(0, 255));
+        rectangle(displayFrame, boundRect.tl(), boundRect.br(), color, 2);
 
-            //Use the SVM to classify the digit in the image
-            int prediction = static_cast<int>(classifier.Predict(image));
+        //Use the SVM to classify the digit in the image
+        int prediction = static_cast<int>(classifications[d].get().label);
 
-            //Display prediction on the image at the top left of the bounding rectangle
-            putText(displayFrame, std::to_string(prediction), boundRect.tl() - Point(0, 5), FONT_HERSHEY_PLAIN, 1.4, Scalar(0, 0, 0));                
-        }        
+        //Display prediction on the image at the top left of the bounding rectangle
+        putText(displayFrame, std::to_string(prediction), boundRect.tl() - Point(0, 5), FONT_HERSHEY_PLAIN, 1.4, Scalar(0, 0, 0));                
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Display the hit rate and memory use of a model's prediction cache
+//
+// PARAMETERS:
+//  name - model name to display
+//  model - model whose cache is displayed
+//
+///////////////////////////////////////////////////////////////////////////////
+void PrintCacheStats(const char *name, const HogSvm &model)
+{
+    const PredictionCache *cache = model.GetCache();
+    if (cache != nullptr)
+    {
+        std::cout << name << " cache: Hit rate: " << cache->GetHitRate() * 100 << "%"
+                  << ", Entries: " << cache->GetSize() << "/" << cache->GetCapacity()
+                  << ", Memory: " << cache->GetMemoryUsage() / 1024 << " KB" << std::endl;
+    }
+}
 
 int main(int argc, char** argv)
 {   
     const char* classifierFilename = "mnistSvm.xml";
     const char* detectorFilename = "svmDigitDetector.xml";
     
-    HogSvm classifier;
-    HogSvm detector;
+    //Models are reloaded in the background when their files change
+    //Predictions of recurring digit images are cached
+    const int pollIntervalMs = 500;
+    const size_t cacheCapacity = 4096;
+    ModelReloader classifier(classifierFilename, pollIntervalMs, cacheCapacity);
+    ModelReloader detector(detectorFilename, pollIntervalMs, cacheCapacity);
     Mat frame;
     Mat processedFrame;
     char c = 0;
 
+    //Parse the command line: --isa <name> forces the kernel instruction set,
+    //--blob-benchmark times blob extraction and exits, --blob-check compares
+    //the packed and 8-bit blob paths on varied frames and exits
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--isa" && i + 1 < argc)
+        {
+            SimdKernels::Isa isa;
+            if (SimdKernels::ParseIsa(argv[++i], isa) == false || SimdKernels::SetIsa(isa) == false)
+            {
+                std::cout << "Instruction set " << argv[i] << " is not supported" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--blob-benchmark")
+        {
+            return RunBlobBenchmark();
+        }
+        else if (arg == "--blob-check")
+        {
+            return RunBlobCheck();
+        }
+    }
+    std::cout << "Kernel instruction set: " << SimdKernels::GetIsaName(SimdKernels::GetIsa()) << std::endl;
+
+#if defined(EMBEDDED_MODELS)
+    // Use the compiled models (model files are still watched for updates)
+    if (classifier.Start(std::make_shared<HogSvm>(MnistClassifierModel)) == false)
+    {
+        std::cout << "Compiled classifier model is invalid" << std::endl;
+        return 1;
+    }
+
+    if (detector.Start(std::make_shared<HogSvm>(DigitDetectorModel)) == false)
+    {
+        std::cout << "Compiled detector model is invalid" << std::endl;
+        return 1;
+    }
+#else
     // Load the classifier model 
-    if (classifier.Load(classifierFilename) == false)
+    if (classifier.Start() == false)
     {
         std::cout << "Failed to load classifier model file" << std::endl;
         return 1;
     }
 
     // Load the detector model 
-    if (detector.Load(detectorFilename) == false)
+    if (detector.Start() == false)
     {
         std::cout << "Failed to load detector model file" << std::endl;
         return 1;
     }
+#endif
+
+#if defined(SIGHUP)
+    //Reload the models on SIGHUP
+    std::signal(SIGHUP, OnReloadSignal);
+#endif
 
     // Grab the first camera on the system
     VideoCapture vidCapture(0);
@@ -171,7 +644,10 @@ int main(int argc, char** argv)
         processedFrame = frame;
 
         // Perform some processing on the frame
-        ProcessFrame(classifier, detector, frame, processedFrame);
+        // Models are held for the whole frame so a swap doesn't affect it
+        const std::shared_ptr<const HogSvm> classifierModel = classifier.GetModel();
+        const std::shared_ptr<const HogSvm> detectorModel = detector.GetModel();
+        ProcessFrame(*classifierModel, *detectorModel, frame, processedFrame);
 
         // Display results
         imshow(WIN_DISPLAY, frame);
@@ -181,9 +657,19 @@ int main(int argc, char** argv)
         c = (char)waitKey(50);
         if (c == 'Q' || c == 'q')
         {
+            PrintCacheStats("Classifier", *classifierModel);
+            PrintCacheStats("Detector", *detectorModel);
             std::cout << "Exiting" << std::endl;
             break;
         }
+
+        // Reload the models on request (loaded in the background)
+        if (c == 'R' || c == 'r' || s_reloadSignaled.exchange(false))
+        {
+            std::cout << "Reloading models" << std::endl;
+            classifier.RequestReload();
+            detector.RequestReload();
+        }
     }
 
     return 0;
@@ -0,0 +1,311 @@
+/******************************************************************************
+
+    FILENAME:       InferenceServer.cpp
+
+    DESCRIPTION:    Local inference daemon. Loads the digit classifier and
+                    detector models once and serves predictions to any number
+                    of processes over a Unix domain socket (see
+                    InferenceClient). Requests from all clients are grouped
+                    into batches under a configurable latency deadline.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x, POSIX sockets
+
+******************************************************************************/
+#include "opencv2/opencv.hpp"
+#include "HogSvm.h"
+#include "InferenceClient.h"
+#include "SimdKernels.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace cv;
+
+//Cleared by SIGINT/SIGTERM to shut down the server
+static std::atomic<bool> s_running(true);
+
+//Time to wait for activity before checking for shutdown
+static const int POLL_TIMEOUT_MS = 500;
+
+//Number of client threads still serving a connection. The threads are
+//detached, so shutdown waits for this to reach zero before the models they
+//use are destroyed.
+static std::atomic<int> s_liveClients(0);
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Signal handler shutting down the server
+//
+// PARAMETERS:
+//  int - signal number (unused)
+///////////////////////////////////////////////////////////////////////////////
+void OnShutdownSignal(int)
+{
+    s_running = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Wait until a socket has data to read or the server is shutting down
+//
+// PARAMETERS:
+//  socket - socket to wait on
+//
+// RETURNS:
+//  true if the socket is readable
+///////////////////////////////////////////////////////////////////////////////
+bool WaitReadable(int socket)
+{
+    pollfd fd = { socket, POLLIN, 0 };
+    while (s_running)
+    {
+        const int ready = poll(&fd, 1, POLL_TIMEOUT_MS);
+        if (ready > 0)
+        {
+            return true;
+        }
+        if (ready < 0 && errno != EINTR)
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Serve requests from one client until it disconnects. The prediction is
+//  queued with the model's batch executor so it is batched with the
+//  requests of all other clients. Decrements the live client count when
+//  the connection is closed.
+//
+// PARAMETERS:
+//  socket - connected client socket
+//  classifier - digit classifier
+//  detector - digit detector
+///////////////////////////////////////////////////////////////////////////////
+void ServeClient(int socket, const HogSvm &classifier, const HogSvm &detector)
+{
+    std::vector<uchar> data;
+
+    while (WaitReadable(socket))
+    {
+        InferenceClient::RequestHeader header;
+        if (InferenceClient::ReceiveAll(socket, &header, sizeof(header)) == false ||
+            header.magic != InferenceClient::MAGIC ||
+            header.rows == 0 || header.rows > InferenceClient::MAX_IMAGE_SIZE ||
+            header.cols == 0 || header.cols > InferenceClient::MAX_IMAGE_SIZE)
+        {
+            break;
+        }
+
+        data.resize(header.rows * header.cols);
+        if (InferenceClient::ReceiveAll(socket, data.data(), data.size()) == false)
+        {
+            break;
+        }
+
+        InferenceClient::Response response;
+        response.magic = InferenceClient::MAGIC;
+        response.requestId = header.requestId;
+        response.status = 0;
+        response.label = 0;
+        response.decision = 0;
+
+        try
+        {
+            const HogSvm &model = (header.model == InferenceClient::MODEL_DETECTOR) ? detector : classifier;
+            const Mat image(static_cast<int>(header.rows), static_cast<int>(header.cols), CV_8UC1, data.data());
+
+            const SvmModel::Prediction prediction = model.PredictAsync(image).get();
+            response.label = prediction.label;
+            response.decision = prediction.decision;
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "Prediction failed: " << e.what() << std::endl;
+            response.status = -1;
+        }
+
+        if (InferenceClient::SendAll(socket, &response, sizeof(response)) == false)
+        {
+            break;
+        }
+    }
+
+    close(socket);
+    s_liveClients--;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Display the command line options
+//
+///////////////////////////////////////////////////////////////////////////////
+void PrintUsage()
+{
+    std::cout << "Usage: InferenceServer [options]" << std::endl
+              << "  --socket <path>       Unix domain socket path (default /tmp/digit-inference.sock)" << std::endl
+              << "  --classifier <file>   Classifier model file (default mnistSvm.xml)" << std::endl
+              << "  --detector <file>     Detector model file (default svmDigitDetector.xml)" << std::endl
+              << "  --batch <n>           Maximum batch size (default 64)" << std::endl
+              << "  --deadline-us <n>     Longest time a request waits for a batch (default 2000)" << std::endl
+              << "  --threads <n>         Batch worker threads per model (default 1)" << std::endl
+              << "  --isa <name>          Force the kernel instruction set (scalar, sse4.2," << std::endl
+              << "                        avx2 or avx512, default best supported)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::string socketPath = "/tmp/digit-inference.sock";
+    std::string classifierFilename = "mnistSvm.xml";
+    std::string detectorFilename = "svmDigitDetector.xml";
+    int maxBatchSize = 64;
+    int deadlineUs = 2000;
+    int threadCount = 1;
+
+    //Parse the command line
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = (i + 1 < argc);
+        if (arg == "--socket" && hasValue)
+        {
+            socketPath = argv[++i];
+        }
+        else if (arg == "--classifier" && hasValue)
+        {
+            classifierFilename = argv[++i];
+        }
+        else if (arg == "--detector" && hasValue)
+        {
+            detectorFilename = argv[++i];
+        }
+        else if (arg == "--batch" && hasValue)
+        {
+            maxBatchSize = std::atoi(argv[++i]);
+        }
+        else if (arg == "--deadline-us" && hasValue)
+        {
+            deadlineUs = std::atoi(argv[++i]);
+        }
+        else if (arg == "--threads" && hasValue)
+        {
+            threadCount = std::atoi(argv[++i]);
+        }
+        else if (arg == "--isa" && hasValue)
+        {
+            SimdKernels::Isa isa;
+            if (SimdKernels::ParseIsa(argv[++i], isa) == false || SimdKernels::SetIsa(isa) == false)
+            {
+                std::cout << "Instruction set " << argv[i] << " is not supported" << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    //Load the models once for all clients (OpenCV XML models are read with
+    //the fast parser when possible)
+    HogSvm classifier;
+    HogSvm detector;
+    if (classifier.LoadXml(classifierFilename) == false && classifier.Load(classifierFilename) == false)
+    {
+        std::cout << "Failed to load classifier model file" << std::endl;
+        return 1;
+    }
+
+    if (detector.LoadXml(detectorFilename) == false && detector.Load(detectorFilename) == false)
+    {
+        std::cout << "Failed to load detector model file" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Classifier: " << classifier.DescribeModel() << std::endl
+              << "Detector: " << detector.DescribeModel() << std::endl;
+
+    classifier.SetAsyncBatching(maxBatchSize, deadlineUs, threadCount);
+    detector.SetAsyncBatching(maxBatchSize, deadlineUs, threadCount);
+
+    //Create the listening socket
+    sockaddr_un address = {};
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        std::cout << "Socket path is too long" << std::endl;
+        return 1;
+    }
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    const int listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if (listenSocket < 0 ||
+        bind(listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listenSocket, SOMAXCONN) != 0)
+    {
+        std::cout << "Failed to listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, OnShutdownSignal);
+    std::signal(SIGTERM, OnShutdownSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::cout << "Listening on " << socketPath << " (batch " << maxBatchSize
+              << ", deadline " << deadlineUs << " us, "
+              << SimdKernels::GetIsaName(SimdKernels::GetIsa()) << " kernels)" << std::endl;
+
+    //Serve each client on its own detached thread, so finished connections
+    //release their threads without being joined
+    while (WaitReadable(listenSocket))
+    {
+        const int clientSocket = accept(listenSocket, nullptr, nullptr);
+        if (clientSocket >= 0)
+        {
+            s_liveClients++;
+            try
+            {
+                std::thread(ServeClient, clientSocket, std::cref(classifier), std::cref(detector)).detach();
+            }
+            catch (const std::system_error &e)
+            {
+                std::cout << "Failed to start client thread: " << e.what() << std::endl;
+                close(clientSocket);
+                s_liveClients--;
+            }
+        }
+    }
+
+    //Clients see the shutdown within one poll timeout
+    std::cout << "Shutting down" << std::endl;
+    while (s_liveClients > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(POLL_TIMEOUT_MS / 10));
+    }
+
+    close(listenSocket);
+    unlink(socketPath.c_str());
+
+    return 0;
+}
@@ -0,0 +1,206 @@
+/******************************************************************************
+
+    FILENAME:       LoadGenerator.cpp
+
+    DESCRIPTION:    Load generator for the inference server. Runs an
+                    increasing number of concurrent clients, each sending
+                    digit crops as fast as the server answers, and reports the
+                    throughput and latency percentiles at each client count.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x, POSIX sockets
+
+******************************************************************************/
+#include "opencv2/opencv.hpp"
+#include "InferenceClient.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cv;
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Create 28x28 digit crops by drawing random digits with random offsets
+//
+// PARAMETERS:
+//  count - number of crops to create
+//  crops - reference to return the crops
+//
+///////////////////////////////////////////////////////////////////////////////
+void CreateCrops(int count, std::vector<Mat> &crops)
+{
+    RNG rng(0x5EED);
+    for (int i = 0; i < count; i++)
+    {
+        Mat crop = Mat::zeros(28, 28, CV_8UC1);
+        const Point origin(4 + rng.uniform(0, 6), 22 + rng.uniform(0, 4));
+        putText(crop, std::to_string(rng.uniform(0, 10)), origin, FONT_HERSHEY_PLAIN, 1.4, Scalar(255), 2);
+        crops.push_back(crop);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get a percentile of sorted latencies
+//
+// PARAMETERS:
+//  latencies - sorted latencies
+//  percentile - percentile (0 to 100)
+//
+// RETURNS:
+//  Latency at the percentile
+///////////////////////////////////////////////////////////////////////////////
+double Percentile(const std::vector<double> &latencies, double percentile)
+{
+    if (latencies.empty())
+    {
+        return 0;
+    }
+
+    const size_t index = static_cast<size_t>(percentile / 100.0 * (latencies.size() - 1) + 0.5);
+    return latencies[std::min(index, latencies.size() - 1)];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Display the command line options
+//
+///////////////////////////////////////////////////////////////////////////////
+void PrintUsage()
+{
+    std::cout << "Usage: LoadGenerator [options]" << std::endl
+              << "  --socket <path>     Server socket path (default /tmp/digit-inference.sock)" << std::endl
+              << "  --clients <list>    Comma separated client counts (default 1,2,4,8,16,32)" << std::endl
+              << "  --requests <n>      Requests sent by each client (default 2000)" << std::endl
+              << "  --detector          Send requests to the detector instead of the classifier" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::string socketPath = "/tmp/digit-inference.sock";
+    std::string clientList = "1,2,4,8,16,32";
+    int requestsPerClient = 2000;
+    InferenceClient::Model model = InferenceClient::MODEL_CLASSIFIER;
+
+    //Parse the command line
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = (i + 1 < argc);
+        if (arg == "--socket" && hasValue)
+        {
+            socketPath = argv[++i];
+        }
+        else if (arg == "--clients" && hasValue)
+        {
+            clientList = argv[++i];
+        }
+        else if (arg == "--requests" && hasValue)
+        {
+            requestsPerClient = std::atoi(argv[++i]);
+        }
+        else if (arg == "--detector")
+        {
+            model = InferenceClient::MODEL_DETECTOR;
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    std::vector<Mat> crops;
+    CreateCrops(1000, crops);
+
+    std::cout << std::setw(8) << "Clients" << std::setw(14) << "Requests/s"
+              << std::setw(12) << "p50 (us)" << std::setw(12) << "p99 (us)"
+              << std::setw(14) << "p99.9 (us)" << std::setw(10) << "Errors" << std::endl;
+
+    std::stringstream counts(clientList);
+    std::string count;
+    while (std::getline(counts, count, ','))
+    {
+        const int clientCount = std::atoi(count.c_str());
+        if (clientCount <= 0)
+        {
+            continue;
+        }
+
+        //Each client records the latency of each of its requests
+        std::vector<std::vector<double>> clientLatencies(clientCount);
+        std::vector<int> clientErrors(clientCount, 0);
+        std::vector<std::thread> clients;
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int c = 0; c < clientCount; c++)
+        {
+            clients.emplace_back([&, c]()
+            {
+                InferenceClient client;
+                if (client.Connect(socketPath) == false)
+                {
+                    clientErrors[c] = requestsPerClient;
+                    return;
+                }
+
+                clientLatencies[c].reserve(requestsPerClient);
+                for (int r = 0; r < requestsPerClient; r++)
+                {
+                    const Mat &crop = crops[(c * requestsPerClient + r) % crops.size()];
+
+                    SvmModel::Prediction prediction;
+                    const auto sent = std::chrono::steady_clock::now();
+                    if (client.Predict(crop, model, prediction) == false)
+                    {
+                        clientErrors[c]++;
+                        if (client.IsConnected() == false)
+                        {
+                            clientErrors[c] += requestsPerClient - r - 1;
+                            return;
+                        }
+                        continue;
+                    }
+                    const auto received = std::chrono::steady_clock::now();
+
+                    clientLatencies[c].push_back(std::chrono::duration<double, std::micro>(received - sent).count());
+                }
+            });
+        }
+
+        for (std::thread &client : clients)
+        {
+            client.join();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        //Combine the results of all clients
+        std::vector<double> latencies;
+        int errors = 0;
+        for (int c = 0; c < clientCount; c++)
+        {
+            latencies.insert(latencies.end(), clientLatencies[c].begin(), clientLatencies[c].end());
+            errors += clientErrors[c];
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        std::cout << std::fixed << std::setprecision(0)
+                  << std::setw(8) << clientCount
+                  << std::setw(14) << latencies.size() / seconds
+                  << std::setw(12) << Percentile(latencies, 50)
+                  << std::setw(12) << Percentile(latencies, 99)
+                  << std::setw(14) << Percentile(latencies, 99.9)
+                  << std::setw(10) << errors << std::endl;
+    }
+
+    return 0;
+}
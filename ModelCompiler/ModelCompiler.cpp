@@ -0,0 +1,139 @@
+/******************************************************************************
+
+    FILENAME:       ModelCompiler.cpp
+
+    DESCRIPTION:    Build step converting an SVM model file into C++ source
+                    (<name>.h and <name>.cpp) and a binary file (<name>.bin)
+                    holding the model buffers. The source embeds the binary
+                    file as aligned read-only data with the assembler's
+                    .incbin directive, so compiling it stays fast for large
+                    models. Constructing a HogSvm from the compiled model
+                    removes the model file and the load step; the buffers are
+                    paged in from the executable on demand and shared between
+                    processes.
+
+                    Usage: ModelCompiler <model file> <name> [output directory]
+
+                    e.g. ModelCompiler mnistSvm.xml MnistClassifierModel
+                         ModelCompiler svmDigitDetector.xml DigitDetectorModel
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#include "opencv2/opencv.hpp"
+#include "HogSvm.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace cv;
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Write the header declaring a compiled model
+//
+// PARAMETERS:
+//  filename - header file path
+//  name - name of the compiled model
+//  modelFilename - model file the model was compiled from
+//
+// RETURNS:
+//  true if the header was written
+///////////////////////////////////////////////////////////////////////////////
+bool WriteHeader(const std::string &filename, const std::string &name, const std::string &modelFilename)
+{
+    std::ofstream header(filename);
+    header << "/******************************************************************************" << std::endl
+           << std::endl
+           << "    FILENAME:       " << name << ".h" << std::endl
+           << std::endl
+           << "    DESCRIPTION:    " << modelFilename << " compiled by ModelCompiler." << std::endl
+           << "                    Do not edit, regenerate when the model changes." << std::endl
+           << std::endl
+           << "******************************************************************************/" << std::endl
+           << "#pragma once" << std::endl
+           << std::endl
+           << "#include \"SvmModel.h\"" << std::endl
+           << std::endl
+           << "extern const SvmModel::StaticModel " << name << ";" << std::endl;
+
+    return header.good();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Write the source defining a compiled model and the binary file of its
+//  buffers
+//
+// PARAMETERS:
+//  filename - source file path
+//  binaryFilename - binary file path (absolute, embedded by the assembler)
+//  name - name of the compiled model
+//  modelFilename - model file the model was compiled from
+//  model - loaded model
+//
+// RETURNS:
+//  true if the source and binary were written
+///////////////////////////////////////////////////////////////////////////////
+bool WriteSource(const std::string &filename, const std::string &binaryFilename, const std::string &name,
+                 const std::string &modelFilename, const HogSvm &model)
+{
+    std::ofstream source(filename);
+    std::ofstream binary(binaryFilename, std::ios::binary);
+    source << "/******************************************************************************" << std::endl
+           << std::endl
+           << "    FILENAME:       " << name << ".cpp" << std::endl
+           << std::endl
+           << "    DESCRIPTION:    " << modelFilename << " compiled by ModelCompiler." << std::endl
+           << "                    Do not edit, regenerate when the model changes." << std::endl
+           << std::endl
+           << "******************************************************************************/" << std::endl
+           << "#include \"" << name << ".h\"" << std::endl
+           << std::endl;
+
+    return model.WriteSource(source, binary, name, binaryFilename) && source.good() && binary.good();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: ModelCompiler <model file> <name> [output directory]" << std::endl;
+        return 1;
+    }
+
+    const std::string modelFilename = argv[1];
+    const std::string name = argv[2];
+    const std::filesystem::path outputDir = (argc > 3) ? argv[3] : ".";
+
+    HogSvm model;
+    if (model.Load(modelFilename) == false)
+    {
+        std::cout << "Failed to load model file " << modelFilename << std::endl;
+        return 1;
+    }
+    std::cout << "Loaded " << modelFilename << ": " << model.DescribeModel() << std::endl;
+
+    const std::string headerFilename = (outputDir / (name + ".h")).string();
+    const std::string sourceFilename = (outputDir / (name + ".cpp")).string();
+    const std::string binaryFilename = std::filesystem::absolute(outputDir / (name + ".bin")).generic_string();
+    const std::string modelName = std::filesystem::path(modelFilename).filename().string();
+
+    if (WriteHeader(headerFilename, name, modelName) == false ||
+        WriteSource(sourceFilename, binaryFilename, name, modelName, model) == false)
+    {
+        std::cout << "Failed to compile " << modelFilename
+                  << " (models with a feature map can't be compiled)" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Compiled " << modelFilename << " to " << headerFilename << ", " << sourceFilename
+              << " and " << binaryFilename << " (" << std::filesystem::file_size(binaryFilename) / 1024
+              << " KB of buffers)" << std::endl;
+
+    return 0;
+}
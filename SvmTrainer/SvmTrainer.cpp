@@ -11,9 +11,21 @@
 ******************************************************************************/
 #include "opencv2/opencv.hpp"
 #include "HogSvm.h"
+#include "HogKnn.h"
+#include "FeatureFile.h"
+#include "ModelMemory.h"
+#include "PackedImages.h"
+#include "SampleFilter.h"
+#include "SimdKernels.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <thread>
 
 using namespace cv;
 
@@ -22,17 +34,20 @@ using namespace cv;
 //  Concatenate multiple images into a single image and display
 //
 // PARAMETERS:
-//  images - vector of image matrices to build display image from
+//  images - packed images to build display image from
 //  numImages - number of images to display
 //
 ///////////////////////////////////////////////////////////////////////////////
-void DisplayImages(const std::vector<Mat> &images, unsigned int numImages)
+void DisplayImages(const PackedImages &images, unsigned int numImages)
 {
     //Place images side by side into a single image for display
-    Mat sampleImages = images[0];
+    Mat sampleImages;
+    images.Unpack(0, sampleImages);
     for (unsigned int i = 1; i < numImages; i++)
     {
-        hconcat(sampleImages, images[i], sampleImages);
+        Mat image;
+        images.Unpack(i, image);
+        hconcat(sampleImages, image, sampleImages);
     }
 
     //Show sample images
@@ -68,17 +83,17 @@ unsigned int ReadInt(std::ifstream &file)
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Read the data from the provided MNIST file into a matrix and store each 
-//  image matrix in a vector 
+//  Read the data from the provided MNIST file, binarize each image and store
+//  it bit-packed (98 bytes per 28 x 28 image)
 //
 // PARAMETERS:
 //  filename - path to the MNIST file
-//  images - reference to return vector of MNIST image matrices
+//  images - reference to return the packed MNIST images
 //
 // RETURNS:
 //  true if MNIST file loaded successfully
 ///////////////////////////////////////////////////////////////////////////////
-bool ReadMnistImageFile(const char *filename, std::vector<Mat> &images)
+bool ReadMnistImageFile(const char *filename, PackedImages &images)
 {      
     //Open the file
     std::ifstream file(filename, std::ios::binary);
@@ -99,17 +114,17 @@ bool ReadMnistImageFile(const char *filename, std::vector<Mat> &images)
     //Compute the total image size
     unsigned int imageSize = numRows * numColumns;    
 
-    //Read each image into a matrix
+    //Read each image into a matrix, binarize and pack it
+    images.Create(numRows, numColumns, numItems);
+    Mat image(numRows, numColumns, CV_8UC1);
     for (unsigned int i = 0; i < numItems; i++)
     {
-        //Read image data and store in vector 
-        Mat image(numRows, numColumns, CV_8UC1);
         file.read(reinterpret_cast<char*>(image.data), imageSize);
 
         //Convert to binary
         threshold(image, image, 90, 255, THRESH_BINARY);
 
-        images.push_back(image);
+        images.Add(image);
     }
 
     file.close();
@@ -178,8 +193,8 @@ bool LoadMnistLabelFile(const char *filename, Mat &labels)
 // RETURNS:
 //  true if all MNIST files loaded successfully
 ///////////////////////////////////////////////////////////////////////////////
-bool LoadMnistData(std::vector<Mat> &trainImages, Mat &trainLabels, 
-                   std::vector<Mat> &testImages, Mat &testLabels)
+bool LoadMnistData(PackedImages &trainImages, Mat &trainLabels, 
+                   PackedImages &testImages, Mat &testLabels)
 {
     if (ReadMnistImageFile("./data/MNIST/train-images.idx3-ubyte", trainImages) == false)
     {
@@ -222,8 +237,8 @@ bool LoadMnistData(std::vector<Mat> &trainImages, Mat &trainLabels,
 // RETURNS:
 //  true if data set loaded successfully
 ///////////////////////////////////////////////////////////////////////////////
-bool CreateDigitDetectorData(std::vector<Mat> &trainImages, Mat &trainLabels,
-    std::vector<Mat> &testImages, Mat &testLabels)
+bool CreateDigitDetectorData(PackedImages &trainImages, Mat &trainLabels,
+    PackedImages &testImages, Mat &testLabels)
 {
     //For all training labels
     for (int i = 0; i < trainLabels.rows; ++i)
@@ -237,59 +252,1567 @@ bool CreateDigitDetectorData(std::vector<Mat> &trainImages, Mat &trainLabels,
     {
         //Read image file
         const std::string filename = "./data/NotDigits/train/image" + std::to_string(i) + ".bmp";
-        trainImages.emplace_back(imread(filename, CV_LOAD_IMAGE_GRAYSCALE));
-        if (trainImages.back().data == nullptr)
+        Mat image = imread(filename, CV_LOAD_IMAGE_GRAYSCALE);
+        if (image.data == nullptr)
         {
             std::cout << "Non-digit training image not found: " << filename << std::endl;
             return false;
         }
 
-        //Convert to binary
-        threshold(trainImages.back(), trainImages.back(), 90, 255, THRESH_BINARY);
+        //Convert to binary and pack
+        threshold(image, image, 90, 255, THRESH_BINARY);
+        if (trainImages.Add(image) == false)
+        {
+            std::cout << "Non-digit image size doesn't match the digit images: " << filename << std::endl;
+            return false;
+        }
+
+        //Label as non-digit
+        trainLabels.push_back(Mat::zeros(1, 1, trainLabels.type()));
+    }
+
+    //For all test labels
+    for (int i = 0; i < testLabels.rows; ++i)
+    {
+        //Set label to indicate image is a digit
+        testLabels.row(i) = 1;        
+    }
+
+    //Add non-digit example test images
+    for (int i = 0; i < 10000; ++i)
+    {
+        //Read image file
+        const std::string filename = "./data/NotDigits/test/image" + std::to_string(i) + ".bmp";
+        Mat image = imread(filename, CV_LOAD_IMAGE_GRAYSCALE);
+        if (image.data == nullptr)
+        {
+            std::cout << "Non-digit training image not found: " << filename << std::endl;
+            return false;
+        }
+
+        //Convert to binary and pack
+        threshold(image, image, 90, 255, THRESH_BINARY);
+        if (testImages.Add(image) == false)
+        {
+            std::cout << "Non-digit image size doesn't match the digit images: " << filename << std::endl;
+            return false;
+        }
+
+        //Label as non-digit
+        testLabels.push_back(Mat::zeros(1, 1, trainLabels.type()));
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Display the peak resident memory of the process
+//
+// PARAMETERS:
+//  stage - description of the work done so far
+//
+///////////////////////////////////////////////////////////////////////////////
+void PrintPeakMemory(const std::string &stage)
+{
+    std::cout << "Peak memory after " << stage << ": " 
+              << ModelMemory::GetPeakResidentMemory() / (1 << 20) << " MB" << std::endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the parameters of the handwritten digit classification SVM
+//
+// PARAMETERS:
+//  digitSvm - classification SVM to configure
+//
+///////////////////////////////////////////////////////////////////////////////
+void ConfigureDigitSvm(HogSvm &digitSvm)
+{
+    digitSvm.SetType(ml::SVM::C_SVC);
+    digitSvm.SetKernel(ml::SVM::POLY);
+    digitSvm.SetGamma(0.1);
+    digitSvm.SetDegree(2);
+    digitSvm.SetC(0.1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the parameters of the digit detection SVM
+//
+// PARAMETERS:
+//  digitDetector - detection SVM to configure
+//
+///////////////////////////////////////////////////////////////////////////////
+void ConfigureDigitDetector(HogSvm &digitDetector)
+{
+    digitDetector.SetType(ml::SVM::C_SVC);
+    digitDetector.SetKernel(ml::SVM::LINEAR);
+    digitDetector.SetC(0.1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the rows of a matrix flagged to keep
+//
+// PARAMETERS:
+//  matrix - input matrix
+//  keep - flag of each row to keep
+//  selected - reference to return the kept rows
+//
+///////////////////////////////////////////////////////////////////////////////
+void SelectRows(const Mat &matrix, const std::vector<bool> &keep, Mat &selected)
+{
+    selected = Mat(0, matrix.cols, matrix.type());
+    for (int i = 0; i < matrix.rows; i++)
+    {
+        if (keep[i])
+        {
+            selected.push_back(matrix.row(i));
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Find the training samples worth keeping: exact duplicates of the 
+//  binarized images and near duplicates of their HOG features are removed,
+//  and optionally only a core set of the rest near the decision boundary is
+//  kept
+//
+// PARAMETERS:
+//  svm - SVM whose features and parameters are used
+//  images - packed binary training images
+//  features - HOG features of the images
+//  labels - label of each image
+//  coreSetChunkSize - samples per core set chunk (0 to keep all the samples
+//                     that are not duplicates)
+//  keep - reference to return the flag of each sample to keep
+//
+// RETURNS:
+//  true if the samples were filtered
+///////////////////////////////////////////////////////////////////////////////
+bool FilterSamples(const HogSvm &svm, const PackedImages &images, const Mat &features, const Mat &labels,
+                   int coreSetChunkSize, std::vector<bool> &keep)
+{
+    keep.assign(images.GetCount(), true);
+
+    SampleFilter filter;
+    if (filter.RemoveExactDuplicates(images, labels, keep) == false)
+    {
+        return false;
+    }
+    const long long exact = std::count(keep.begin(), keep.end(), false);
+
+    if (filter.RemoveNearDuplicates(features, labels, keep) == false)
+    {
+        return false;
+    }
+    const long long near = std::count(keep.begin(), keep.end(), false) - exact;
+
+    std::cout << "Removed " << exact << " exact and " << near << " near duplicates of " 
+              << keep.size() << " samples" << std::endl;
+
+    if (coreSetChunkSize > 0)
+    {
+        const long long before = std::count(keep.begin(), keep.end(), true);
+        if (svm.SelectCoreSet(features, labels, coreSetChunkSize, keep) == false)
+        {
+            return false;
+        }
+
+        std::cout << "Core set of " << std::count(keep.begin(), keep.end(), true) << " of " 
+                  << before << " samples" << std::endl;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Remove the duplicate training images (and optionally those outside the
+//  core set) before training
+//
+// PARAMETERS:
+//  svm - SVM whose features and parameters are used
+//  coreSetChunkSize - samples per core set chunk (0 for no core set)
+//  images - packed binary training images, replaced by the kept images
+//  labels - label of each image, replaced by the kept labels
+//
+// RETURNS:
+//  true if the training set was filtered
+///////////////////////////////////////////////////////////////////////////////
+bool FilterTrainingSet(const HogSvm &svm, int coreSetChunkSize, PackedImages &images, Mat &labels)
+{
+    Mat features;
+    svm.ExtractFeatures(images, features);
+
+    std::vector<bool> keep;
+    if (FilterSamples(svm, images, features, labels, coreSetChunkSize, keep) == false)
+    {
+        return false;
+    }
+
+    PackedImages keptImages;
+    keptImages.Create(images.GetRows(), images.GetCols(), static_cast<int>(std::count(keep.begin(), keep.end(), true)));
+    for (int i = 0; i < images.GetCount(); i++)
+    {
+        if (keep[i])
+        {
+            Mat image;
+            images.Unpack(i, image);
+            keptImages.Add(image);
+        }
+    }
+
+    Mat keptLabels;
+    SelectRows(labels, keep, keptLabels);
+
+    images = keptImages;
+    labels = keptLabels;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compare the accuracy and latency of the prediction modes of the saved 
+//  classification SVM on the MNIST test set
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunDagReport()
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    HogSvm digitSvm;
+    if (digitSvm.Load("mnistSvm.xml") == false)
+    {
+        std::cout << "Failed to load classifier model file" << std::endl;
+        return 1;
+    }
+
+    //Extract the features once so only prediction is timed
+    Mat features;
+    digitSvm.ExtractFeatures(testImages, features);
+
+    const std::pair<const char*, SvmModel::PredictMode> modes[] =
+    {
+        { "Voting (45 pairs)",  SvmModel::PREDICT_VOTE },
+        { "Decision DAG (9 pairs)", SvmModel::PREDICT_DAG }
+    };
+
+    for (const auto &mode : modes)
+    {
+        digitSvm.SetPredictMode(mode.second);
+
+        TickMeter timer;
+        timer.start();
+        float percentError = digitSvm.Svm::Test(features, testLabels);
+        timer.stop();
+
+        std::cout << mode.first << ": Percent error: " << percentError << "%, "
+                  << "Latency: " << timer.getTimeMicro() / features.rows << " us/sample"
+                  << std::endl;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the classification SVM on explicit polynomial feature maps of 
+//  several dimensions and report accuracy, training time and latency
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunSketchReport()
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    const int dimensions[] = { 512, 1024, 2048, 4096, 8192 };
+    for (int dimension : dimensions)
+    {
+        HogSvm digitSvm;
+        ConfigureDigitSvm(digitSvm);
+        digitSvm.SetFeatureMap(dimension);
+
+        TickMeter trainTimer;
+        trainTimer.start();
+        digitSvm.Train(trainImages, trainLabels);
+        trainTimer.stop();
+
+        //Time prediction including feature extraction and mapping
+        TickMeter testTimer;
+        testTimer.start();
+        float percentError = digitSvm.Test(testImages, testLabels);
+        testTimer.stop();
+
+        std::cout << "Dimension: " << dimension 
+                  << ", Percent error: " << percentError << "%"
+                  << ", Training time: " << trainTimer.getTimeSec() << " s"
+                  << ", Latency: " << testTimer.getTimeMicro() / testImages.GetCount() << " us/image"
+                  << std::endl;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Factorize the support vectors of the saved classification SVM with a 
+//  truncated SVD and report accuracy, latency and memory for several ranks. 
+//  The smallest rank within the allowed error increase is saved to 
+//  mnistSvmLowRank.xml.
+//
+// PARAMETERS:
+//  maxErrorIncrease - allowed increase in percent error over the full model
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunLowRankReport(float maxErrorIncrease)
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    HogSvm digitSvm;
+    if (digitSvm.Load("mnistSvm.xml") == false)
+    {
+        std::cout << "Failed to load classifier model file" << std::endl;
+        return 1;
+    }
+
+    Mat features;
+    digitSvm.ExtractFeatures(testImages, features);
+
+    //Accuracy and cost of the full support vectors
+    Mat supportVectors;
+    digitSvm.GetSupportVectors().convertTo(supportVectors, CV_32FC1);
+    const double fullMegabytes = supportVectors.total() * sizeof(float) / (1024.0 * 1024.0);
+
+    TickMeter timer;
+    timer.start();
+    const float fullError = digitSvm.Svm::Test(features, testLabels);
+    timer.stop();
+
+    std::cout << "Full: Percent error: " << fullError << "%"
+              << ", Latency: " << timer.getTimeMicro() / features.rows << " us/sample"
+              << ", Memory: " << fullMegabytes << " MB" << std::endl;
+
+    //Truncated SVD of the support vector matrix
+    std::cout << "Computing SVD of " << supportVectors.rows << " x " 
+              << supportVectors.cols << " support vectors..." << std::endl;
+    Mat w, u, vt;
+    SVD::compute(supportVectors, w, u, vt);
+
+    int chosenRank = 0;
+    Mat chosenU, chosenV;
+
+    const int ranks[] = { 16, 32, 64, 96, 128, 192, 256, 384, 512 };
+    for (int rank : ranks)
+    {
+        if (rank > w.rows)
+        {
+            break;
+        }
+
+        //U is scaled by the singular values so SV ~= U * V
+        Mat lowRankU = u.colRange(0, rank).clone();
+        Mat lowRankV = vt.rowRange(0, rank).clone();
+        for (int i = 0; i < lowRankU.rows; i++)
+        {
+            float *row = lowRankU.ptr<float>(i);
+            for (int k = 0; k < rank; k++)
+            {
+                row[k] *= w.at<float>(k);
+            }
+        }
+
+        digitSvm.SetLowRankFactors(lowRankU, lowRankV);
+
+        TickMeter rankTimer;
+        rankTimer.start();
+        const float percentError = digitSvm.Svm::Test(features, testLabels);
+        rankTimer.stop();
+
+        const double megabytes = (lowRankU.total() + lowRankV.total()) * sizeof(float) / (1024.0 * 1024.0);
+        std::cout << "Rank " << rank << ": Percent error: " << percentError << "%"
+                  << ", Latency: " << rankTimer.getTimeMicro() / features.rows << " us/sample"
+                  << ", Memory: " << megabytes << " MB" << std::endl;
+
+        if (chosenRank == 0 && percentError <= fullError + maxErrorIncrease)
+        {
+            chosenRank = rank;
+            chosenU = lowRankU;
+            chosenV = lowRankV;
+        }
+    }
+
+    if (chosenRank == 0)
+    {
+        std::cout << "No rank within " << maxErrorIncrease << "% of the full model error" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Saving rank " << chosenRank << " model to mnistSvmLowRank.xml" << std::endl;
+    digitSvm.SetLowRankFactors(chosenU, chosenV);
+    digitSvm.Save("mnistSvmLowRank.xml");
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Product quantize the support vectors of the saved classification SVM with
+//  several subspace sizes and report accuracy, latency and model size. Each 
+//  quantized model is saved to mnistSvmPq<subspace dim>.xml.gz.
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunQuantizationReport()
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    HogSvm digitSvm;
+    if (digitSvm.Load("mnistSvm.xml") == false)
+    {
+        std::cout << "Failed to load classifier model file" << std::endl;
+        return 1;
+    }
+
+    Mat features;
+    digitSvm.ExtractFeatures(testImages, features);
+
+    const Mat supportVectors = digitSvm.GetSupportVectors();
+    const double fullKilobytes = supportVectors.total() * sizeof(float) / 1024.0;
+
+    TickMeter timer;
+    timer.start();
+    const float fullError = digitSvm.Svm::Test(features, testLabels);
+    timer.stop();
+
+    std::cout << "Full: Percent error: " << fullError << "%"
+              << ", Latency: " << timer.getTimeMicro() / features.rows << " us/sample"
+              << ", Support vectors: " << fullKilobytes << " KB" << std::endl;
+
+    //Subspace sizes dividing the 1521 HOG features evenly
+    const int subspaceDims[] = { 3, 9, 13 };
+    for (int subspaceDim : subspaceDims)
+    {
+        TickMeter quantizeTimer;
+        quantizeTimer.start();
+        if (digitSvm.QuantizeSupportVectors(subspaceDim) == false)
+        {
+            std::cout << "Failed to quantize with subspace dimension " << subspaceDim << std::endl;
+            return 1;
+        }
+        quantizeTimer.stop();
+
+        TickMeter testTimer;
+        testTimer.start();
+        const float percentError = digitSvm.Svm::Test(features, testLabels);
+        testTimer.stop();
+
+        const std::string filename = "mnistSvmPq" + std::to_string(subspaceDim) + ".xml.gz";
+        digitSvm.Save(filename);
+
+        std::cout << "Subspace dim " << subspaceDim 
+                  << ": Percent error: " << percentError << "% (" 
+                  << (percentError - fullError >= 0 ? "+" : "") << percentError - fullError << "%)"
+                  << ", Latency: " << testTimer.getTimeMicro() / features.rows << " us/sample"
+                  << ", Quantization time: " << quantizeTimer.getTimeSec() << " s"
+                  << ", Saved " << filename << " (" 
+                  << std::filesystem::file_size(filename) / 1024 << " KB)" << std::endl;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compare prediction throughput of the saved classification SVM with its
+//  support vectors in normal pages, in huge pages, and replicated on each 
+//  NUMA node. Worker threads are pinned to each NUMA node and predict the 
+//  test set concurrently.
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunNumaReport()
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    HogSvm digitSvm;
+    if (digitSvm.Load("mnistSvm.xml") == false)
+    {
+        std::cout << "Failed to load classifier model file" << std::endl;
+        return 1;
+    }
+
+    Mat features;
+    digitSvm.ExtractFeatures(testImages, features);
+
+    const int nodeCount = ModelMemory::GetNumaNodeCount();
+    const int threadsPerNode = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / nodeCount);
+    const int samplesPerThread = std::min(features.rows, 1000);
+
+    std::cout << "NUMA nodes: " << nodeCount << ", Threads per node: " << threadsPerNode << std::endl;
+
+    struct Placement
+    {
+        const char *name;
+        bool hugePages;
+        bool numaReplicas;
+    };
+    const Placement placements[] = { { "Normal pages", false, false },
+                                     { "Huge pages", true, false },
+                                     { "Huge pages + NUMA replicas", true, true } };
+
+    for (const Placement &placement : placements)
+    {
+        digitSvm.SetMemoryPlacement(placement.hugePages, placement.numaReplicas);
+
+        std::vector<double> threadSeconds(nodeCount * threadsPerNode, 0);
+        std::vector<std::thread> threads;
+        for (int node = 0; node < nodeCount; node++)
+        {
+            for (int t = 0; t < threadsPerNode; t++)
+            {
+                const int index = node * threadsPerNode + t;
+                threads.emplace_back([&, node, index]()
+                {
+                    ModelMemory::PinThreadToNumaNode(node);
+
+                    TickMeter timer;
+                    timer.start();
+                    for (int i = 0; i < samplesPerThread; i++)
+                    {
+                        digitSvm.Svm::Predict(features.row((index * samplesPerThread + i) % features.rows));
+                    }
+                    timer.stop();
+
+                    threadSeconds[index] = timer.getTimeSec();
+                });
+            }
+        }
+
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+
+        std::cout << placement.name << ":";
+        for (int node = 0; node < nodeCount; node++)
+        {
+            double predictionsPerSecond = 0;
+            for (int t = 0; t < threadsPerNode; t++)
+            {
+                predictionsPerSecond += samplesPerThread / threadSeconds[node * threadsPerNode + t];
+            }
+            std::cout << " Node " << node << ": " << predictionsPerSecond << " predictions/s";
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compare HOG extraction and prediction time of the saved classification
+//  SVM with the kernels forced to each instruction set the CPU supports.
+//  The instruction set applies to the prediction kernels only; OpenCV's HOG
+//  extraction is either unoptimized (scalar) or at its own best level (see
+//  SimdKernels::SetIsa), so the HOG times only separate scalar from the rest.
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunIsaReport()
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    HogSvm digitSvm;
+    if (digitSvm.Load("mnistSvm.xml") == false)
+    {
+        std::cout << "Failed to load classifier model file" << std::endl;
+        return 1;
+    }
+
+    const SimdKernels::Isa bestIsa = SimdKernels::GetBestIsa();
+    std::cout << "Best supported instruction set: " << SimdKernels::GetIsaName(bestIsa) << std::endl;
+
+    for (int i = SimdKernels::ISA_SCALAR; i <= bestIsa; i++)
+    {
+        const SimdKernels::Isa isa = static_cast<SimdKernels::Isa>(i);
+        SimdKernels::SetIsa(isa);
+
+        Mat features;
+        TickMeter hogTimer;
+        hogTimer.start();
+        digitSvm.ExtractFeatures(testImages, features);
+        hogTimer.stop();
+
+        TickMeter predictTimer;
+        predictTimer.start();
+        float percentError = digitSvm.Svm::Test(features, testLabels);
+        predictTimer.stop();
+
+        std::cout << SimdKernels::GetIsaName(isa) << " kernels: Percent error: " << percentError << "%, "
+                  << "HOG (OpenCV " << (useOptimized() ? "optimized" : "unoptimized") << "): "
+                  << hogTimer.getTimeMicro() / features.rows << " us/sample, "
+                  << "Prediction: " << predictTimer.getTimeMicro() / features.rows << " us/sample"
+                  << std::endl;
+    }
+
+    SimdKernels::SetIsa(bestIsa);
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compare the load time of the saved classification SVM through OpenCV's
+//  FileStorage parser (StatModel::load) and through the fast XML parser, 
+//  and check both give the same test error
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunLoadReport()
+{
+    const std::string filename = "mnistSvm.xml";
+
+    TickMeter statModelTimer;
+    statModelTimer.start();
+    Ptr<ml::SVM> statModel = ml::StatModel::load<ml::SVM>(filename);
+    statModelTimer.stop();
+
+    TickMeter loadTimer;
+    HogSvm digitSvm;
+    loadTimer.start();
+    const bool loaded = digitSvm.Load(filename);
+    loadTimer.stop();
+
+    TickMeter fastTimer;
+    HogSvm fastSvm;
+    fastTimer.start();
+    const bool fastLoaded = fastSvm.LoadXml(filename);
+    fastTimer.stop();
+
+    if (statModel.empty() || loaded == false || fastLoaded == false)
+    {
+        std::cout << "Failed to load classifier model file" << std::endl;
+        return 1;
+    }
+
+    std::cout << "StatModel::load: " << statModelTimer.getTimeMilli() << " ms" << std::endl
+              << "HogSvm::Load (StatModel + engine): " << loadTimer.getTimeMilli() << " ms" << std::endl
+              << "HogSvm::LoadXml (" << getNumThreads() << " threads): " << fastTimer.getTimeMilli() << " ms" << std::endl
+              << "Model: " << fastSvm.DescribeModel() << std::endl;
+
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    Mat features;
+    digitSvm.ExtractFeatures(testImages, features);
+    std::cout << "Percent error: " << digitSvm.Svm::Test(features, testLabels) << "% (Load), "
+              << fastSvm.Svm::Test(features, testLabels) << "% (LoadXml)" << std::endl;
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Build the k-nearest neighbour index over the HOG features of the MNIST
+//  training images and save it for memory mapping (mnistKnn.idx)
+//
+// RETURNS:
+//  0 if the index was built and saved
+///////////////////////////////////////////////////////////////////////////////
+int BuildKnnIndex()
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    HogKnn digitKnn;
+    if (digitKnn.Train(trainImages, trainLabels) == false || digitKnn.Save("mnistKnn.idx") == false)
+    {
+        std::cout << "Failed to build k-NN index" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Saved k-NN index mnistKnn.idx" << std::endl;
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compare the accuracy and latency of the k-nearest neighbour classifier
+//  at several search budgets with the saved classification SVM. Both
+//  include HOG extraction in the latency.
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunKnnReport()
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    HogSvm digitSvm;
+    if (digitSvm.Load("mnistSvm.xml") == false)
+    {
+        std::cout << "Failed to load classifier model file" << std::endl;
+        return 1;
+    }
+
+    TickMeter loadTimer;
+    loadTimer.start();
+    HogKnn digitKnn;
+    if (digitKnn.Load("mnistKnn.idx") == false)
+    {
+        std::cout << "Failed to load k-NN index (build it with --knn-index)" << std::endl;
+        return 1;
+    }
+    loadTimer.stop();
+
+    std::cout << "k-NN index: " << digitKnn.GetSize() << " images, mapped in "
+              << loadTimer.getTimeMilli() << " ms" << std::endl;
+
+    TickMeter svmTimer;
+    svmTimer.start();
+    float percentError = digitSvm.Test(testImages, testLabels);
+    svmTimer.stop();
+
+    std::cout << "SVM: Percent error: " << percentError << "%, "
+              << "Latency: " << svmTimer.getTimeMicro() / testImages.GetCount() << " us/sample" << std::endl;
+
+    //Distances computed per search (0 is an exact search)
+    const int budgets[] = { 256, 1024, 4096, 16384, 0 };
+    for (int k : { 1, 3 })
+    {
+        digitKnn.SetK(k);
+        for (int budget : budgets)
+        {
+            digitKnn.SetSearchBudget(budget);
+
+            TickMeter knnTimer;
+            knnTimer.start();
+            percentError = digitKnn.Test(testImages, testLabels);
+            knnTimer.stop();
+
+            std::cout << k << "-NN, budget " << ((budget > 0) ? std::to_string(budget) : "exact") << ": "
+                      << "Percent error: " << percentError << "%, "
+                      << "Latency: " << knnTimer.getTimeMicro() / testImages.GetCount() << " us/sample" << std::endl;
+        }
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the classification SVM with several support vector budgets, for 
+//  the whole model and for each class pair, and report the accuracy, 
+//  training time and latency achieved at each budget
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunBudgetReport()
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    //Extract the features once for all budgets
+    HogSvm digitSvm;
+    ConfigureDigitSvm(digitSvm);
+    Mat trainFeatures;
+    Mat testFeatures;
+    digitSvm.ExtractFeatures(trainImages, trainFeatures);
+    digitSvm.ExtractFeatures(testImages, testFeatures);
+
+    const std::pair<BudgetSolver::Scope, std::vector<int>> budgets[] =
+    {
+        { BudgetSolver::BUDGET_GLOBAL,   { 250, 500, 1000, 2000, 4000 } },
+        { BudgetSolver::BUDGET_PER_PAIR, { 25, 50, 100, 200 } }
+    };
+
+    for (const auto &scope : budgets)
+    {
+        for (int budget : scope.second)
+        {
+            digitSvm.SetBudget(budget, scope.first);
+
+            TickMeter trainTimer;
+            trainTimer.start();
+            const bool trained = digitSvm.Svm::Train(trainFeatures, trainLabels);
+            trainTimer.stop();
+            if (trained == false)
+            {
+                std::cout << "Budgeted training failed" << std::endl;
+                return 1;
+            }
+
+            TickMeter testTimer;
+            testTimer.start();
+            float percentError = digitSvm.Svm::Test(testFeatures, testLabels);
+            testTimer.stop();
+
+            std::cout << ((scope.first == BudgetSolver::BUDGET_GLOBAL) ? "Model" : "Pair") 
+                      << " budget " << budget << ": "
+                      << "Support vectors: " << digitSvm.GetSupportVectors().rows
+                      << ", Percent error: " << percentError << "%"
+                      << ", Training time: " << trainTimer.getTimeSec() << " s"
+                      << ", Latency: " << testTimer.getTimeMicro() / testFeatures.rows << " us/sample"
+                      << std::endl;
+        }
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compare the wall clock training time of cv::ml::SVM::train with the
+//  parallel SMO solver at several kernel cache sizes on the HOG features of
+//  the MNIST training set. Each SMO model is saved and loaded again to check
+//  it gives the same test error.
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunSmoReport()
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
 
-        //Label as non-digit
-        trainLabels.push_back(Mat::zeros(1, 1, trainLabels.type()));
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
     }
 
-    //For all test labels
-    for (int i = 0; i < testLabels.rows; ++i)
+    //Extract the features once for all solvers
+    HogSvm digitSvm;
+    ConfigureDigitSvm(digitSvm);
+    Mat trainFeatures;
+    Mat testFeatures;
+    digitSvm.ExtractFeatures(trainImages, trainFeatures);
+    digitSvm.ExtractFeatures(testImages, testFeatures);
+
+    //cacheSizeMb 0 is the OpenCV solver
+    const int cacheSizes[] = { 0, 64, 256, 1024 };
+    double opencvTime = 0;
+    for (int cacheSizeMb : cacheSizes)
     {
-        //Set label to indicate image is a digit
-        testLabels.row(i) = 1;        
+        const bool smo = (cacheSizeMb > 0);
+        digitSvm.SetSolver(smo ? Svm::SOLVER_SMO : Svm::SOLVER_OPENCV, cacheSizeMb);
+
+        TickMeter trainTimer;
+        trainTimer.start();
+        const bool trained = digitSvm.Svm::Train(trainFeatures, trainLabels);
+        trainTimer.stop();
+        if (trained == false)
+        {
+            std::cout << "Training failed" << std::endl;
+            return 1;
+        }
+
+        if (smo == false)
+        {
+            opencvTime = trainTimer.getTimeSec();
+        }
+
+        float percentError = digitSvm.Svm::Test(testFeatures, testLabels);
+
+        std::cout << (smo ? "SMO, " + std::to_string(cacheSizeMb) + " MB cache" : "cv::ml::SVM::train") << ": "
+                  << "Support vectors: " << digitSvm.GetSupportVectors().rows
+                  << ", Percent error: " << percentError << "%"
+                  << ", Training time: " << trainTimer.getTimeSec() << " s";
+        if (smo)
+        {
+            std::cout << " (" << opencvTime / trainTimer.getTimeSec() << "x)";
+        }
+        std::cout << std::endl;
+
+        //The SMO model is saved as the inference engine
+        if (smo)
+        {
+            HogSvm loadedSvm;
+            if (digitSvm.Save("mnistSvmSmo.xml") == false || loadedSvm.Load("mnistSvmSmo.xml") == false)
+            {
+                std::cout << "Failed to save and load the SMO model" << std::endl;
+                return 1;
+            }
+
+            std::cout << "  Percent error after loading: " 
+                      << loadedSvm.Svm::Test(testFeatures, testLabels) << "%" << std::endl;
+        }
     }
 
-    //Add non-digit example test images
-    for (int i = 0; i < 10000; ++i)
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compare the successive halving search of C and gamma with the 10-fold
+//  grid search of TrainAuto() on the HOG features of the MNIST training 
+//  set, reporting the chosen parameters, test error and search time of each
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunHalvingReport()
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
     {
-        //Read image file
-        const std::string filename = "./data/NotDigits/test/image" + std::to_string(i) + ".bmp";
-        testImages.emplace_back(imread(filename, CV_LOAD_IMAGE_GRAYSCALE));
-        if (testImages.back().data == nullptr)
+        return 1;
+    }
+
+    //Extract the features once for both searches
+    HogSvm digitSvm;
+    ConfigureDigitSvm(digitSvm);
+    Mat trainFeatures;
+    Mat testFeatures;
+    digitSvm.ExtractFeatures(trainImages, trainFeatures);
+    digitSvm.ExtractFeatures(testImages, testFeatures);
+
+    double halvingTime = 0;
+    for (int halving = 1; halving >= 0; halving--)
+    {
+        TickMeter trainTimer;
+        trainTimer.start();
+        const bool trained = halving ? digitSvm.TrainHalving(trainFeatures, trainLabels) :
+                                       digitSvm.TrainAuto(trainFeatures, trainLabels);
+        trainTimer.stop();
+        if (trained == false)
+        {
+            std::cout << "Training failed" << std::endl;
+            return 1;
+        }
+
+        if (halving)
+        {
+            halvingTime = trainTimer.getTimeSec();
+        }
+
+        float percentError = digitSvm.Svm::Test(testFeatures, testLabels);
+
+        std::cout << (halving ? "Successive halving" : "TrainAuto") << ": "
+                  << "C: " << digitSvm.GetC() << ", Gamma: " << digitSvm.GetGamma()
+                  << ", Support vectors: " << digitSvm.GetSupportVectors().rows
+                  << ", Percent error: " << percentError << "%"
+                  << ", Training time: " << trainTimer.getTimeSec() << " s";
+        if (halving == 0)
+        {
+            std::cout << " (" << trainTimer.getTimeSec() / halvingTime << "x slower)";
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Write the HOG features of a set of images to a feature file, extracting
+//  them a block of images at a time
+//
+// PARAMETERS:
+//  digitSvm - SVM whose HOG features are written
+//  images - packed binary images
+//  labels - label of each image
+//  filename - path of the feature file
+//
+// RETURNS:
+//  true if the file was written
+///////////////////////////////////////////////////////////////////////////////
+bool WriteFeatureFile(const HogSvm &digitSvm, const PackedImages &images, const Mat &labels, 
+                      const std::string &filename)
+{
+    const int blockSize = 4096;
+    FeatureFile file;
+    for (int start = 0; start < images.GetCount(); start += blockSize)
+    {
+        const int end = std::min(start + blockSize, images.GetCount());
+        PackedImages block;
+        block.Create(images.GetRows(), images.GetCols(), end - start);
+        for (int i = start; i < end; i++)
+        {
+            Mat image;
+            images.Unpack(i, image);
+            block.Add(image);
+        }
+
+        Mat features;
+        digitSvm.ExtractFeatures(block, features);
+        if ((start == 0 && file.Create(filename, features.cols) == false) ||
+            file.Append(features, labels.rowRange(start, end)) == false)
         {
-            std::cout << "Non-digit training image not found: " << filename << std::endl;
             return false;
         }
+    }
 
-        //Convert to binary
-        threshold(testImages.back(), testImages.back(), 90, 255, THRESH_BINARY);
+    return file.Close();
+}
 
-        //Label as non-digit
-        testLabels.push_back(Mat::zeros(1, 1, trainLabels.type()));
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the classification SVM from a feature file of the MNIST training 
+//  set, with the kernel solver at several chunk sizes and with the linear
+//  solver, and report the accuracy and training time of each
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunOutOfCoreReport()
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    HogSvm digitSvm;
+    ConfigureDigitSvm(digitSvm);
+    const std::string filename = "mnistFeatures.bin";
+    if (WriteFeatureFile(digitSvm, trainImages, trainLabels, filename) == false)
+    {
+        std::cout << "Failed to write " << filename << std::endl;
+        return 1;
+    }
+
+    Mat testFeatures;
+    digitSvm.ExtractFeatures(testImages, testFeatures);
+
+    //Chunk size 0 is the linear solver
+    const int chunkSizes[] = { 5000, 10000, 20000, 0 };
+    for (int chunkSize : chunkSizes)
+    {
+        if (chunkSize == 0)
+        {
+            digitSvm.SetKernel(ml::SVM::LINEAR);
+        }
+
+        TickMeter trainTimer;
+        trainTimer.start();
+        const bool trained = digitSvm.TrainFile(filename, std::max(chunkSize, 1));
+        trainTimer.stop();
+        if (trained == false)
+        {
+            std::cout << "Training from " << filename << " failed" << std::endl;
+            return 1;
+        }
+
+        float percentError = digitSvm.Svm::Test(testFeatures, testLabels);
+
+        std::cout << ((chunkSize > 0) ? "Kernel, chunk size " + std::to_string(chunkSize) : "Linear") << ": "
+                  << "Support vectors: " << digitSvm.GetSupportVectors().rows
+                  << ", Percent error: " << percentError << "%"
+                  << ", Training time: " << trainTimer.getTimeSec() << " s"
+                  << std::endl;
+        PrintPeakMemory("training");
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train an SVM on all of its training samples, without the duplicates and
+//  on the core set of the rest, and report the change in training time, 
+//  support vectors and test error of each against all of the samples
+//
+// PARAMETERS:
+//  svm - configured SVM
+//  name - name of the SVM in the report
+//  trainImages - packed binary training images
+//  trainLabels - training labels
+//  testImages - packed binary test images
+//  testLabels - test labels
+//
+// RETURNS:
+//  true if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+bool ReportFiltering(HogSvm &svm, const std::string &name, const PackedImages &trainImages, const Mat &trainLabels,
+                     const PackedImages &testImages, const Mat &testLabels)
+{
+    //Extract the features once for all training sets
+    Mat trainFeatures;
+    Mat testFeatures;
+    svm.ExtractFeatures(trainImages, trainFeatures);
+    svm.ExtractFeatures(testImages, testFeatures);
+
+    const int coreSetChunkSize = 10000;
+    const std::string stages[] = { "all samples", "duplicates removed", "core set" };
+
+    double baseTime = 0;
+    int baseSvs = 0;
+    float baseError = 0;
+    for (int stage = 0; stage < 3; stage++)
+    {
+        TickMeter filterTimer;
+        filterTimer.start();
+        std::vector<bool> keep(trainImages.GetCount(), true);
+        if (stage > 0 && FilterSamples(svm, trainImages, trainFeatures, trainLabels, 
+                                       (stage == 2) ? coreSetChunkSize : 0, keep) == false)
+        {
+            std::cout << "Filtering the " << name << " training set failed" << std::endl;
+            return false;
+        }
+        filterTimer.stop();
+
+        Mat features;
+        Mat labels;
+        SelectRows(trainFeatures, keep, features);
+        SelectRows(trainLabels, keep, labels);
+
+        TickMeter trainTimer;
+        trainTimer.start();
+        const bool trained = svm.Svm::Train(features, labels);
+        trainTimer.stop();
+        if (trained == false)
+        {
+            std::cout << "Training failed" << std::endl;
+            return false;
+        }
+
+        const int svs = svm.GetSupportVectors().rows;
+        const float percentError = svm.Svm::Test(testFeatures, testLabels);
+        if (stage == 0)
+        {
+            baseTime = trainTimer.getTimeSec();
+            baseSvs = svs;
+            baseError = percentError;
+        }
+
+        std::cout << name << ", " << stages[stage] << ": "
+                  << "Samples: " << features.rows
+                  << ", Filtering time: " << ((stage > 0) ? filterTimer.getTimeSec() : 0.0) << " s"
+                  << ", Training time: " << trainTimer.getTimeSec() << " s ("
+                  << 100.0 * (trainTimer.getTimeSec() - baseTime) / baseTime << "%)"
+                  << ", Support vectors: " << svs << " ("
+                  << 100.0 * (svs - baseSvs) / std::max(baseSvs, 1) << "%)"
+                  << ", Percent error: " << percentError << "% ("
+                  << std::showpos << percentError - baseError << std::noshowpos << ")"
+                  << std::endl;
     }
 
     return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Report the effect of removing duplicate training samples and of 
+//  training on a core set, for the classification SVM (MNIST) and the
+//  detector SVM (MNIST and NotDigits)
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunDedupReport()
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    HogSvm digitSvm;
+    ConfigureDigitSvm(digitSvm);
+    if (ReportFiltering(digitSvm, "Classifier", trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    if (CreateDigitDetectorData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    HogSvm digitDetector;
+    ConfigureDigitDetector(digitDetector);
+    if (ReportFiltering(digitDetector, "Detector", trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Cross-validate the classification SVM on the HOG features of the MNIST
+//  training set and report the error and throughput of each fold, the 
+//  error over all folds and the confusion matrix
+//
+// PARAMETERS:
+//  folds - number of folds
+//  maxThreads - most threads used in total (0 for OpenCV's thread count)
+//
+// RETURNS:
+//  0 if the report completed successfully
+///////////////////////////////////////////////////////////////////////////////
+int RunCrossValidationReport(int folds, int maxThreads)
+{
+    PackedImages trainImages;
+    PackedImages testImages;
+    Mat trainLabels;
+    Mat testLabels;
+
+    if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == false)
+    {
+        return 1;
+    }
+
+    HogSvm digitSvm;
+    ConfigureDigitSvm(digitSvm);
+    Mat trainFeatures;
+    digitSvm.ExtractFeatures(trainImages, trainFeatures);
+
+    TickMeter timer;
+    timer.start();
+    Svm::CrossValidation result;
+    const bool trained = digitSvm.CrossValidate(trainFeatures, trainLabels, folds, maxThreads, result);
+    timer.stop();
+    if (trained == false)
+    {
+        std::cout << "Cross-validation failed" << std::endl;
+        return 1;
+    }
+
+    //Error of each fold, and of all the folds together
+    int errors = 0;
+    int samples = 0;
+    double sumError = 0;
+    double sumSquaredError = 0;
+    for (size_t i = 0; i < result.folds.size(); i++)
+    {
+        const Svm::FoldResult &fold = result.folds[i];
+        const double percentError = (100.0 * fold.errors) / fold.testSamples;
+        errors += fold.errors;
+        samples += fold.testSamples;
+        sumError += percentError;
+        sumSquaredError += percentError * percentError;
+
+        std::cout << "Fold " << i << ": "
+                  << "Percent error: " << percentError << "%"
+                  << ", Training: " << fold.trainSamples / fold.trainSeconds << " samples/s"
+                  << " (" << fold.trainSeconds << " s)"
+                  << ", Prediction: " << fold.testSamples / fold.predictSeconds << " samples/s"
+                  << std::endl;
+    }
+
+    const double meanError = sumError / folds;
+    const double stdError = std::sqrt(std::max(sumSquaredError / folds - meanError * meanError, 0.0));
+    std::cout << folds << "-fold cross-validation (" << timer.getTimeSec() << " s): "
+              << "Percent error: " << (100.0 * errors) / samples << "%"
+              << ", Mean fold error: " << meanError << "% +/- " << stdError << "%" << std::endl;
+
+    //Confusion matrix, true classes down and predicted classes across
+    std::cout << "Confusion matrix (rows: actual, columns: predicted)" << std::endl << "     ";
+    for (int label : result.classLabels)
+    {
+        std::cout << std::setw(6) << label;
+    }
+    std::cout << std::endl;
+
+    for (int i = 0; i < result.confusion.rows; i++)
+    {
+        std::cout << std::setw(5) << result.classLabels[i];
+        for (int j = 0; j < result.confusion.cols; j++)
+        {
+            std::cout << std::setw(6) << result.confusion.at<int>(i, j);
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Display the command line options
+//
+///////////////////////////////////////////////////////////////////////////////
+void PrintUsage()
+{
+    std::cout << "Usage: SvmTrainer [options]" << std::endl
+              << "  --sketch-dim <n>   Train the classifier on an n dimensional explicit" << std::endl
+              << "                     polynomial feature map instead of the POLY kernel" << std::endl
+              << "  --dag-report       Compare voting and DAG prediction of mnistSvm.xml" << std::endl
+              << "  --sketch-report    Report accuracy vs. feature map dimension" << std::endl
+              << "  --low-rank-report [max error increase %]" << std::endl
+              << "                     Report accuracy vs. rank of factorized support" << std::endl
+              << "                     vectors and save the smallest rank within the" << std::endl
+              << "                     allowed error increase (default 0.1%)" << std::endl
+              << "  --pq-report        Report accuracy vs. product quantization of the" << std::endl
+              << "                     support vectors and save the quantized models" << std::endl
+              << "  --numa-report      Report prediction throughput with huge pages and" << std::endl
+              << "                     per NUMA node model replicas" << std::endl
+              << "  --isa-report       Report HOG and prediction time with the kernels" << std::endl
+              << "                     built for each supported instruction set (OpenCV" << std::endl
+              << "                     is only switched between unoptimized and its best)" << std::endl
+              << "  --load-report      Compare model load time of StatModel::load and" << std::endl
+              << "                     the fast XML parser" << std::endl
+              << "  --knn-index        Build the k-NN index over the training features" << std::endl
+              << "                     (mnistKnn.idx)" << std::endl
+              << "  --knn-report       Compare k-NN accuracy and latency with the SVM" << std::endl
+              << "  --budget-report    Report accuracy vs. support vector budget" << std::endl
+              << "  --budget <n>       Train the classifier with at most n support vectors" << std::endl
+              << "  --pair-budget <n>  Train the classifier with at most n support vectors" << std::endl
+              << "                     per class pair" << std::endl
+              << "  --smo-report       Compare training time of cv::ml::SVM and the" << std::endl
+              << "                     parallel SMO solver" << std::endl
+              << "  --smo [cache MB]   Train the classifier with the parallel SMO solver" << std::endl
+              << "                     (default 256 MB kernel cache)" << std::endl
+              << "  --halving-report   Compare the successive halving search of C and" << std::endl
+              << "                     gamma with the TrainAuto() grid search" << std::endl
+              << "  --out-of-core-report" << std::endl
+              << "                     Report accuracy and training time training from" << std::endl
+              << "                     a memory mapped feature file (mnistFeatures.bin)" << std::endl
+              << "  --dedup-report     Report training time, support vectors and accuracy" << std::endl
+              << "                     without duplicate samples and on a core set" << std::endl
+              << "  --dedup            Remove exact and near duplicate training samples" << std::endl
+              << "  --core-set [n]     Remove duplicates and train on the support vectors" << std::endl
+              << "                     of SVMs trained on chunks of n samples (default" << std::endl
+              << "                     10000)" << std::endl
+              << "  --cv-report [k] [max threads]" << std::endl
+              << "                     Report k-fold cross-validation error, confusion" << std::endl
+              << "                     matrix and throughput (default 5 folds, OpenCV's" << std::endl
+              << "                     thread count)" << std::endl
+              << "  --isa <name>       Force the kernel instruction set (scalar, sse4.2," << std::endl
+              << "                     avx2 or avx512; scalar also turns off OpenCV's" << std::endl
+              << "                     optimizations), must precede any report option" << std::endl;
+}
+
 int main(int argc, char** argv)
 {
-    std::vector<Mat> trainImages;
-    std::vector<Mat> testImages;
+    int sketchDim = 0;
+    int budget = 0;
+    BudgetSolver::Scope budgetScope = BudgetSolver::BUDGET_GLOBAL;
+    int smoCacheSizeMb = 0;
+    bool dedup = false;
+    int coreSetChunkSize = 0;
+
+    //Parse the command line. Report modes run and exit without training.
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--dag-report")
+        {
+            return RunDagReport();
+        }
+        else if (arg == "--sketch-report")
+        {
+            return RunSketchReport();
+        }
+        else if (arg == "--low-rank-report")
+        {
+            return RunLowRankReport((i + 1 < argc) ? static_cast<float>(std::atof(argv[i + 1])) : 0.1f);
+        }
+        else if (arg == "--pq-report")
+        {
+            return RunQuantizationReport();
+        }
+        else if (arg == "--numa-report")
+        {
+            return RunNumaReport();
+        }
+        else if (arg == "--load-report")
+        {
+            return RunLoadReport();
+        }
+        else if (arg == "--knn-index")
+        {
+            return BuildKnnIndex();
+        }
+        else if (arg == "--knn-report")
+        {
+            return RunKnnReport();
+        }
+        else if (arg == "--isa-report")
+        {
+            return RunIsaReport();
+        }
+        else if (arg == "--budget-report")
+        {
+            return RunBudgetReport();
+        }
+        else if (arg == "--out-of-core-report")
+        {
+            return RunOutOfCoreReport();
+        }
+        else if (arg == "--smo-report")
+        {
+            return RunSmoReport();
+        }
+        else if (arg == "--halving-report")
+        {
+            return RunHalvingReport();
+        }
+        else if (arg == "--dedup-report")
+        {
+            return RunDedupReport();
+        }
+        else if (arg == "--cv-report")
+        {
+            const int folds = (i + 1 < argc && std::atoi(argv[i + 1]) > 0) ? std::atoi(argv[++i]) : 5;
+            const int maxThreads = (i + 1 < argc && std::atoi(argv[i + 1]) > 0) ? std::atoi(argv[++i]) : 0;
+            return RunCrossValidationReport(folds, maxThreads);
+        }
+        else if (arg == "--dedup")
+        {
+            dedup = true;
+        }
+        else if (arg == "--core-set")
+        {
+            dedup = true;
+            coreSetChunkSize = 10000;
+            if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+            {
+                coreSetChunkSize = std::atoi(argv[++i]);
+            }
+        }
+        else if (arg == "--smo")
+        {
+            smoCacheSizeMb = 256;
+            if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+            {
+                smoCacheSizeMb = std::atoi(argv[++i]);
+            }
+        }
+        else if (arg == "--isa" && i + 1 < argc)
+        {
+            SimdKernels::Isa isa;
+            if (SimdKernels::ParseIsa(argv[++i], isa) == false || SimdKernels::SetIsa(isa) == false)
+            {
+                std::cout << "Instruction set " << argv[i] << " is not supported" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--sketch-dim" && i + 1 < argc)
+        {
+            sketchDim = std::atoi(argv[++i]);
+        }
+        else if ((arg == "--budget" || arg == "--pair-budget") && i + 1 < argc)
+        {
+            budget = std::atoi(argv[++i]);
+            budgetScope = (arg == "--budget") ? BudgetSolver::BUDGET_GLOBAL : BudgetSolver::BUDGET_PER_PAIR;
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    PackedImages trainImages;
+    PackedImages testImages;
     Mat trainLabels;    
     Mat testLabels;  
 
     //Load the data from the MNSIT training and test files
     if (LoadMnistData(trainImages, trainLabels, testImages, testLabels) == true)
     {
+        PrintPeakMemory("loading");
+
         try
         {
             ////////////////////////////////////////////////////////////////
@@ -298,11 +1821,29 @@ int main(int argc, char** argv)
             HogSvm digitSvm;
 
             // Set up SVM parameters    
-            digitSvm.SetType(ml::SVM::C_SVC);
-            digitSvm.SetKernel(ml::SVM::POLY);
-            digitSvm.SetGamma(0.1);
-            digitSvm.SetDegree(2);
-            digitSvm.SetC(0.1);
+            ConfigureDigitSvm(digitSvm);
+
+            //Optionally remove duplicate training samples
+            if (dedup && FilterTrainingSet(digitSvm, coreSetChunkSize, trainImages, trainLabels) == false)
+            {
+                std::cout << "Failed to filter the training set" << std::endl;
+                return 1;
+            }
+
+            //Optionally approximate the polynomial kernel with an explicit feature map
+            if (sketchDim > 0)
+            {
+                digitSvm.SetFeatureMap(sketchDim);
+            }
+
+            //Optionally cap the support vectors to fix the prediction cost
+            digitSvm.SetBudget(budget, budgetScope);
+
+            //Optionally train with the parallel SMO solver
+            if (smoCacheSizeMb > 0)
+            {
+                digitSvm.SetSolver(Svm::SOLVER_SMO, smoCacheSizeMb);
+            }
 
             //Train the SVM
             std::cout << "Training classification SVM (this will take several minutes)..." << std::endl;
@@ -316,6 +1857,7 @@ int main(int argc, char** argv)
             //Display results of test
             std::cout << "Classification SVM testing completed. Percent error: " 
                       << percentError << "%" << std::endl;
+            PrintPeakMemory("classification SVM training");
 
             //Save the SVM model to a file
             digitSvm.Save("mnistSvm.xml");
@@ -328,9 +1870,14 @@ int main(int argc, char** argv)
                 HogSvm digitDetector;
 
                 // Set up SVM parameters
-                digitDetector.SetType(ml::SVM::C_SVC);
-                digitDetector.SetKernel(ml::SVM::LINEAR);
-                digitDetector.SetC(0.1);
+                ConfigureDigitDetector(digitDetector);
+
+                //Optionally remove duplicate training samples
+                if (dedup && FilterTrainingSet(digitDetector, coreSetChunkSize, trainImages, trainLabels) == false)
+                {
+                    std::cout << "Failed to filter the training set" << std::endl;
+                    return 1;
+                }
 
                 //Train the SVM
                 std::cout << "Training detector SVM (this will take several minutes)..." << std::endl;
@@ -344,6 +1891,7 @@ int main(int argc, char** argv)
                 //Display results of test
                 std::cout << "Detector SVM testing completed. Percent error: " 
                           << percentError << "%" << std::endl;
+                PrintPeakMemory("detector SVM training");
 
                 //Save the SVM model to a file
                 digitDetector.Save("svmDigitDetector.xml");
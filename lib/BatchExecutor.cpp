@@ -0,0 +1,228 @@
+/******************************************************************************
+
+    FILENAME:       BatchExecutor.cpp
+
+    DESCRIPTION:    Executor for asynchronous predictions. Requests submitted
+                    from any thread are queued and coalesced into batches that
+                    are predicted together on a worker thread, and each
+                    request's future is fulfilled with its prediction.
+                    Requests can be cancelled while they are queued (e.g.
+                    when the frame they came from has been dropped).
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "BatchExecutor.h"
+
+#include <stdexcept>
+
+using namespace cv;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor
+//
+// PARAMETERS:
+//  predictBatch - function predicting a batch of images
+//  maxBatchSize - maximum number of requests predicted together
+//  maxDelayUs - longest time a request waits for others to join its batch
+//  threadCount - number of worker threads predicting batches
+///////////////////////////////////////////////////////////////////////////////
+BatchExecutor::BatchExecutor(const BatchFunction &predictBatch, int maxBatchSize, int maxDelayUs, int threadCount) :
+    m_predictBatch(predictBatch),
+    m_maxBatchSize(std::max(1, maxBatchSize)),
+    m_maxDelay(std::max(0, maxDelayUs)),
+    m_running(true),
+    m_batchCount(0),
+    m_requestCount(0),
+    m_cancelledCount(0)
+{
+    for (int i = 0; i < std::max(1, threadCount); i++)
+    {
+        m_threads.emplace_back(&BatchExecutor::ProcessBatches, this);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor. Queued requests are completed before the workers exit.
+///////////////////////////////////////////////////////////////////////////////
+BatchExecutor::~BatchExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_condition.notify_all();
+
+    for (std::thread &thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Queue an image for prediction
+//
+// PARAMETERS:
+//  image - image to predict (shared, not copied, so don't modify it until
+//          the future is ready)
+//  cancel - optional token that cancels the request if set before the
+//           request is predicted
+//
+// RETURNS:
+//  Future returning the prediction. If the request is cancelled the future
+//  throws std::runtime_error.
+///////////////////////////////////////////////////////////////////////////////
+std::future<SvmModel::Prediction> BatchExecutor::Submit(const Mat &image, const CancelToken &cancel)
+{
+    Request request;
+    request.image = image;
+    request.cancel = cancel;
+    request.submitted = std::chrono::steady_clock::now();
+    std::future<SvmModel::Prediction> result = request.promise.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(request));
+    }
+    m_condition.notify_one();
+
+    m_requestCount++;
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Create a token to cancel a group of requests (e.g. those of one frame)
+//
+// RETURNS:
+//  Cancel token (set it to true to cancel)
+///////////////////////////////////////////////////////////////////////////////
+BatchExecutor::CancelToken BatchExecutor::CreateCancelToken()
+{
+    return std::make_shared<std::atomic<bool>>(false);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of batches predicted
+//
+// RETURNS:
+//  Number of batches
+///////////////////////////////////////////////////////////////////////////////
+size_t BatchExecutor::GetBatchCount() const
+{
+    return m_batchCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of requests submitted
+//
+// RETURNS:
+//  Number of requests
+///////////////////////////////////////////////////////////////////////////////
+size_t BatchExecutor::GetRequestCount() const
+{
+    return m_requestCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of requests cancelled before they were predicted
+//
+// RETURNS:
+//  Number of cancelled requests
+///////////////////////////////////////////////////////////////////////////////
+size_t BatchExecutor::GetCancelledCount() const
+{
+    return m_cancelledCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Worker thread. Waits until a full batch is queued or the oldest request
+//  has waited the maximum delay, then predicts the batch and fulfills the
+//  requests' futures.
+///////////////////////////////////////////////////////////////////////////////
+void BatchExecutor::ProcessBatches()
+{
+    std::vector<Request> batch;
+    std::vector<Mat> images;
+    std::vector<SvmModel::Prediction> predictions;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_condition.wait(lock, [this] { return m_running == false || m_queue.empty() == false; });
+        if (m_queue.empty())
+        {
+            break;
+        }
+
+        //Give other requests a chance to join the batch
+        const auto deadline = m_queue.front().submitted + m_maxDelay;
+        m_condition.wait_until(lock, deadline, [this] { return m_running == false || m_queue.size() >= m_maxBatchSize; });
+        if (m_queue.empty())
+        {
+            continue;
+        }
+
+        //Take the batch, dropping cancelled requests
+        batch.clear();
+        while (m_queue.empty() == false && batch.size() < m_maxBatchSize)
+        {
+            Request &request = m_queue.front();
+            if (request.cancel && *request.cancel)
+            {
+                request.promise.set_exception(std::make_exception_ptr(std::runtime_error("Prediction cancelled")));
+                m_cancelledCount++;
+            }
+            else
+            {
+                batch.push_back(std::move(request));
+            }
+            m_queue.pop_front();
+        }
+
+        if (batch.empty())
+        {
+            continue;
+        }
+
+        //Predict without holding the lock so requests can keep arriving
+        lock.unlock();
+
+        images.clear();
+        for (const Request &request : batch)
+        {
+            images.push_back(request.image);
+        }
+
+        std::exception_ptr error;
+        try
+        {
+            m_predictBatch(images, predictions);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            if (error || i >= predictions.size())
+            {
+                batch[i].promise.set_exception(error ? error : std::make_exception_ptr(std::runtime_error("Prediction failed")));
+            }
+            else
+            {
+                batch[i].promise.set_value(predictions[i]);
+            }
+        }
+        m_batchCount++;
+
+        lock.lock();
+    }
+}
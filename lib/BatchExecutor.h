@@ -0,0 +1,109 @@
+/******************************************************************************
+
+    FILENAME:       BatchExecutor.h
+
+    DESCRIPTION:    Executor for asynchronous predictions. Requests submitted
+                    from any thread are queued and coalesced into batches that
+                    are predicted together on a worker thread, and each
+                    request's future is fulfilled with its prediction.
+                    Requests can be cancelled while they are queued (e.g.
+                    when the frame they came from has been dropped).
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+#include "SvmModel.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class BatchExecutor
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Types
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    //Predicts a batch of images (one prediction per image)
+    typedef std::function<void(const std::vector<cv::Mat> &images,
+                               std::vector<SvmModel::Prediction> &predictions)> BatchFunction;
+
+    //Shared flag set to cancel every request submitted with it
+    typedef std::shared_ptr<std::atomic<bool>> CancelToken;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    BatchExecutor(const BatchFunction &predictBatch, int maxBatchSize = 32, int maxDelayUs = 1000, int threadCount = 1);
+    virtual ~BatchExecutor();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    std::future<SvmModel::Prediction> Submit(const cv::Mat &image, const CancelToken &cancel = nullptr);
+    static CancelToken CreateCancelToken();
+
+    size_t GetBatchCount() const;
+    size_t GetRequestCount() const;
+    size_t GetCancelledCount() const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Types
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    struct Request
+    {
+        cv::Mat image;
+        CancelToken cancel;
+        std::promise<SvmModel::Prediction> promise;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    void ProcessBatches();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    BatchFunction m_predictBatch;
+    size_t m_maxBatchSize;
+    std::chrono::microseconds m_maxDelay;
+
+    //Queued requests, oldest first
+    std::deque<Request> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_running;
+    std::vector<std::thread> m_threads;
+
+    //Statistics
+    std::atomic<size_t> m_batchCount;
+    std::atomic<size_t> m_requestCount;
+    std::atomic<size_t> m_cancelledCount;
+
+};
@@ -0,0 +1,649 @@
+/******************************************************************************
+
+    FILENAME:       BinaryImage.cpp
+
+    DESCRIPTION:    Bit-packed binary image (1 bit per pixel, 64 pixels per
+                    word) for processing thresholded frames. Morphology works
+                    on whole words at a time and blobs are extracted from runs
+                    of set pixels, so the post-threshold stages move an eighth
+                    of the memory of an 8-bit image.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "BinaryImage.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace cv;
+
+//Bit set in the lowest bit of every byte
+static const std::uint64_t BYTE_LOW_BITS = 0x0101010101010101ULL;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the index of the lowest set bit of a word
+//
+// PARAMETERS:
+//  word - word with at least one bit set
+//
+// RETURNS:
+//  Bit index (0 to 63)
+///////////////////////////////////////////////////////////////////////////////
+static int LowestSetBit(std::uint64_t word)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Find the root label of a run, compressing the path to it
+//
+// PARAMETERS:
+//  labels - parent of each run
+//  i - run
+//
+// RETURNS:
+//  Root label
+///////////////////////////////////////////////////////////////////////////////
+static int FindRoot(std::vector<int> &labels, int i)
+{
+    int root = i;
+    while (labels[root] != root)
+    {
+        root = labels[root];
+    }
+    while (labels[i] != root)
+    {
+        const int next = labels[i];
+        labels[i] = root;
+        i = next;
+    }
+
+    return root;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Default constructor
+///////////////////////////////////////////////////////////////////////////////
+BinaryImage::BinaryImage() :
+    m_rows(0),
+    m_cols(0),
+    m_wordsPerRow(0)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor for a cleared image
+//
+// PARAMETERS:
+//  rows - number of rows
+//  cols - number of columns
+///////////////////////////////////////////////////////////////////////////////
+BinaryImage::BinaryImage(int rows, int cols) :
+    BinaryImage()
+{
+    Create(rows, cols);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+BinaryImage::~BinaryImage()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Size the image and clear every pixel
+//
+// PARAMETERS:
+//  rows - number of rows
+//  cols - number of columns
+///////////////////////////////////////////////////////////////////////////////
+void BinaryImage::Create(int rows, int cols)
+{
+    m_rows = std::max(rows, 0);
+    m_cols = std::max(cols, 0);
+    m_wordsPerRow = (m_cols + 63) / 64;
+    m_words.assign(static_cast<size_t>(m_rows) * m_wordsPerRow, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Pack an 8-bit image, setting the pixels that are not zero
+//
+// PARAMETERS:
+//  image - 8-bit single channel image (e.g. the output of threshold)
+///////////////////////////////////////////////////////////////////////////////
+void BinaryImage::FromMat(const Mat &image)
+{
+    CV_Assert(image.type() == CV_8UC1);
+    Create(image.rows, image.cols);
+
+    for (int r = 0; r < m_rows; r++)
+    {
+        PackPixels(image.ptr<uchar>(r), m_cols, reinterpret_cast<uchar*>(GetRow(r)));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Unpack to an 8-bit image (255 for set pixels, 0 otherwise)
+//
+// PARAMETERS:
+//  image - reference to return the image
+///////////////////////////////////////////////////////////////////////////////
+void BinaryImage::ToMat(Mat &image) const
+{
+    image.create(m_rows, m_cols, CV_8UC1);
+
+    for (int r = 0; r < m_rows; r++)
+    {
+        UnpackPixels(reinterpret_cast<const uchar*>(GetRow(r)), m_cols, image.ptr<uchar>(r));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Pack 8-bit pixels into bits (pixel i in bit i % 8 of byte i / 8), 
+//  setting the bits of the pixels that are not zero. Eight pixels are 
+//  packed at a time in a 64-bit register (assumes a little endian CPU, as
+//  the word layout of BinaryImage does).
+//
+// PARAMETERS:
+//  pixels - pixels to pack
+//  count - number of pixels
+//  bits - pointer to return the (count + 7) / 8 bytes of bits
+///////////////////////////////////////////////////////////////////////////////
+void BinaryImage::PackPixels(const uchar *pixels, int count, uchar *bits)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        //Fold each byte onto its lowest bit, then gather the 8 low bits
+        std::uint64_t bytes;
+        std::memcpy(&bytes, pixels + i, sizeof(bytes));
+        bytes |= bytes >> 4;
+        bytes |= bytes >> 2;
+        bytes |= bytes >> 1;
+        bytes &= BYTE_LOW_BITS;
+
+        bits[i / 8] = static_cast<uchar>((bytes * 0x0102040810204080ULL) >> 56);
+    }
+
+    if (i < count)
+    {
+        uchar last = 0;
+        for (int bit = 0; i + bit < count; bit++)
+        {
+            last |= static_cast<uchar>((pixels[i + bit] != 0) << bit);
+        }
+        bits[i / 8] = last;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Unpack bits into 8-bit pixels (255 for set bits, 0 otherwise). Eight
+//  pixels are unpacked at a time in a 64-bit register.
+//
+// PARAMETERS:
+//  bits - bits packed by PackPixels()
+//  count - number of pixels
+//  pixels - pointer to return the pixels
+///////////////////////////////////////////////////////////////////////////////
+void BinaryImage::UnpackPixels(const uchar *bits, int count, uchar *pixels)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        //Copy the 8 bits to every byte, keep bit i in byte i and widen
+        //each non-zero byte to 255
+        const std::uint64_t spread = (bits[i / 8] * BYTE_LOW_BITS) & 0x8040201008040201ULL;
+        const std::uint64_t bytes = (((spread + 0x7F7F7F7F7F7F7F7FULL) >> 7) & BYTE_LOW_BITS) * 0xFF;
+        std::memcpy(pixels + i, &bytes, sizeof(bytes));
+    }
+
+    for (; i < count; i++)
+    {
+        pixels[i] = ((bits[i / 8] >> (i % 8)) & 1) ? 255 : 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get a pixel
+//
+// PARAMETERS:
+//  row - pixel row
+//  col - pixel column
+//
+// RETURNS:
+//  true if the pixel is set
+///////////////////////////////////////////////////////////////////////////////
+bool BinaryImage::Get(int row, int col) const
+{
+    return ((GetRow(row)[col / 64] >> (col % 64)) & 1) != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of rows
+//
+// RETURNS:
+//  Number of rows
+///////////////////////////////////////////////////////////////////////////////
+int BinaryImage::GetRows() const
+{
+    return m_rows;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of columns
+//
+// RETURNS:
+//  Number of columns
+///////////////////////////////////////////////////////////////////////////////
+int BinaryImage::GetCols() const
+{
+    return m_cols;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Dilate with the 3x3 cross structuring element (the 3x3 MORPH_ELLIPSE of
+//  getStructuringElement). Pixels outside the image are clear, as with
+//  OpenCV's default morphology border.
+//
+// PARAMETERS:
+//  result - reference to return the dilated image (not this image)
+///////////////////////////////////////////////////////////////////////////////
+void BinaryImage::Dilate(BinaryImage &result) const
+{
+    result.Create(m_rows, m_cols);
+    const Word lastMask = GetLastWordMask();
+
+    for (int r = 0; r < m_rows; r++)
+    {
+        const Word *above = (r > 0) ? GetRow(r - 1) : nullptr;
+        const Word *row = GetRow(r);
+        const Word *below = (r + 1 < m_rows) ? GetRow(r + 1) : nullptr;
+        Word *out = result.GetRow(r);
+
+        for (int w = 0; w < m_wordsPerRow; w++)
+        {
+            //Left and right neighbours, carrying bits across word boundaries
+            const Word left = (row[w] << 1) | ((w > 0) ? row[w - 1] >> 63 : 0);
+            const Word right = (row[w] >> 1) | ((w + 1 < m_wordsPerRow) ? row[w + 1] << 63 : 0);
+
+            out[w] = row[w] | left | right | (above ? above[w] : 0) | (below ? below[w] : 0);
+        }
+        out[m_wordsPerRow - 1] &= lastMask;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Erode with the 3x3 cross structuring element. Pixels outside the image
+//  are set, as with OpenCV's default morphology border.
+//
+// PARAMETERS:
+//  result - reference to return the eroded image (not this image)
+///////////////////////////////////////////////////////////////////////////////
+void BinaryImage::Erode(BinaryImage &result) const
+{
+    result.Create(m_rows, m_cols);
+    const Word lastMask = GetLastWordMask();
+    const Word outside = ~static_cast<Word>(0);
+
+    for (int r = 0; r < m_rows; r++)
+    {
+        const Word *above = (r > 0) ? GetRow(r - 1) : nullptr;
+        const Word *row = GetRow(r);
+        const Word *below = (r + 1 < m_rows) ? GetRow(r + 1) : nullptr;
+        Word *out = result.GetRow(r);
+
+        for (int w = 0; w < m_wordsPerRow; w++)
+        {
+            //Columns past the last one are outside the image (set)
+            const bool last = (w + 1 == m_wordsPerRow);
+            const Word word = last ? (row[w] | ~lastMask) : row[w];
+            const Word left = (word << 1) | ((w > 0) ? row[w - 1] >> 63 : 1);
+            const Word right = (word >> 1) | (last ? outside << 63 : row[w + 1] << 63);
+
+            out[w] = word & left & right & (above ? above[w] : outside) & (below ? below[w] : outside);
+        }
+        out[m_wordsPerRow - 1] &= lastMask;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Morphological close (dilate then erode) with the 3x3 cross structuring
+//  element, equivalent to morphologyEx(MORPH_CLOSE) with a 3x3 MORPH_ELLIPSE
+//
+///////////////////////////////////////////////////////////////////////////////
+void BinaryImage::Close()
+{
+    if (m_wordsPerRow == 0)
+    {
+        return;
+    }
+
+    BinaryImage dilated;
+    Dilate(dilated);
+    dilated.Erode(*this);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Clear the blobs containing the seed points, equivalent to flood filling
+//  each seed with 0 (seeds on clear pixels have no effect)
+//
+// PARAMETERS:
+//  seeds - seed points
+//  connectivity - 4 (like floodFill's default) or 8
+///////////////////////////////////////////////////////////////////////////////
+void BinaryImage::ClearBlobsAt(const std::vector<Point> &seeds, int connectivity)
+{
+    std::vector<Run> runs;
+    std::vector<int> labels;
+    LabelRuns(Rect(0, 0, m_cols, m_rows), connectivity, runs, labels);
+
+    //Find the blob of each seed from the run containing it
+    std::vector<bool> clear(runs.size(), false);
+    for (const Point &seed : seeds)
+    {
+        for (size_t i = 0; i < runs.size(); i++)
+        {
+            if (runs[i].row == seed.y && runs[i].start <= seed.x && seed.x < runs[i].end)
+            {
+                clear[FindRoot(labels, static_cast<int>(i))] = true;
+                break;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        if (clear[FindRoot(labels, static_cast<int>(i))] == false)
+        {
+            continue;
+        }
+
+        Word *row = GetRow(runs[i].row);
+        for (int x = runs[i].start; x < runs[i].end; x++)
+        {
+            row[x / 64] &= ~(static_cast<Word>(1) << (x % 64));
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the holes of the blobs in an area of the image, equivalent to flood 
+//  filling the clear pixels from outside the area and setting the clear 
+//  pixels that were not reached. Clear pixels are joined with connectivity 
+//  4 (the complement of 8-connected blobs).
+//
+// PARAMETERS:
+//  area - area of the image (pixels outside are unchanged and are treated 
+//         as clear)
+///////////////////////////////////////////////////////////////////////////////
+void BinaryImage::FillHoles(const Rect &area)
+{
+    const Rect bounds = area & Rect(0, 0, m_cols, m_rows);
+    if (bounds.area() == 0)
+    {
+        return;
+    }
+
+    //Clear pixels of the area as set pixels of a background image
+    const int end = bounds.x + bounds.width;
+    const int firstWord = bounds.x / 64;
+    const int lastWord = (end - 1) / 64;
+    Word firstMask = ~static_cast<Word>(0) << (bounds.x % 64);
+    Word lastMask = (end % 64 == 0) ? ~static_cast<Word>(0) : (static_cast<Word>(1) << (end % 64)) - 1;
+    if (firstWord == lastWord)
+    {
+        firstMask &= lastMask;
+        lastMask = firstMask;
+    }
+
+    BinaryImage background(m_rows, m_cols);
+    for (int r = bounds.y; r < bounds.y + bounds.height; r++)
+    {
+        const Word *source = GetRow(r);
+        Word *target = background.GetRow(r);
+        for (int w = firstWord; w <= lastWord; w++)
+        {
+            const Word mask = (w == firstWord) ? firstMask : ((w == lastWord) ? lastMask : ~static_cast<Word>(0));
+            target[w] = ~source[w] & mask;
+        }
+    }
+
+    std::vector<Run> runs;
+    std::vector<int> labels;
+    background.LabelRuns(bounds, 4, runs, labels);
+
+    //Background blobs touching the edge of the area are outside the blobs
+    std::vector<bool> outside(runs.size(), false);
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        const Run &run = runs[i];
+        if (run.row == bounds.y || run.row == bounds.y + bounds.height - 1 || 
+            run.start == bounds.x || run.end == end)
+        {
+            outside[FindRoot(labels, static_cast<int>(i))] = true;
+        }
+    }
+
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        if (outside[FindRoot(labels, static_cast<int>(i))])
+        {
+            continue;
+        }
+
+        Word *row = GetRow(runs[i].row);
+        for (int x = runs[i].start; x < runs[i].end; x++)
+        {
+            row[x / 64] |= static_cast<Word>(1) << (x % 64);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Find the connected blobs of set pixels in an area of the image from the
+//  runs of set pixels in each row. Blobs are returned in the order of their
+//  first pixel in a raster scan, with boxes in image coordinates.
+//
+// PARAMETERS:
+//  area - area of the image to search (pixels outside are ignored)
+//  connectivity - 4 or 8
+//  blobs - reference to return the blobs
+///////////////////////////////////////////////////////////////////////////////
+void BinaryImage::FindBlobs(const Rect &area, int connectivity, std::vector<Blob> &blobs) const
+{
+    std::vector<Run> runs;
+    std::vector<int> labels;
+    LabelRuns(area, connectivity, runs, labels);
+
+    //Extents of each blob (x0, y0, x1, y1) indexed by its root run
+    std::vector<int> blobIndex(runs.size(), -1);
+    std::vector<Vec4i> extents;
+    blobs.clear();
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        const Run &run = runs[i];
+        const int root = FindRoot(labels, static_cast<int>(i));
+        if (blobIndex[root] < 0)
+        {
+            blobIndex[root] = static_cast<int>(blobs.size());
+            blobs.push_back(Blob{ Rect(), 0 });
+            extents.push_back(Vec4i(run.start, run.row, run.end, run.row + 1));
+        }
+
+        Blob &blob = blobs[blobIndex[root]];
+        Vec4i &extent = extents[blobIndex[root]];
+        blob.area += run.end - run.start;
+        extent[0] = std::min(extent[0], run.start);
+        extent[2] = std::max(extent[2], run.end);
+        extent[3] = run.row + 1;
+    }
+
+    for (size_t b = 0; b < blobs.size(); b++)
+    {
+        const Vec4i &extent = extents[b];
+        blobs[b].box = Rect(extent[0], extent[1], extent[2] - extent[0], extent[3] - extent[1]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get a row of words
+//
+// PARAMETERS:
+//  row - row index
+//
+// RETURNS:
+//  Pointer to the first word of the row
+///////////////////////////////////////////////////////////////////////////////
+BinaryImage::Word *BinaryImage::GetRow(int row)
+{
+    return m_words.data() + static_cast<size_t>(row) * m_wordsPerRow;
+}
+
+const BinaryImage::Word *BinaryImage::GetRow(int row) const
+{
+    return m_words.data() + static_cast<size_t>(row) * m_wordsPerRow;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the mask of the bits of the last word of a row that are pixels
+//
+// RETURNS:
+//  Mask of valid bits
+///////////////////////////////////////////////////////////////////////////////
+BinaryImage::Word BinaryImage::GetLastWordMask() const
+{
+    const int bits = m_cols % 64;
+    return (bits == 0) ? ~static_cast<Word>(0) : (static_cast<Word>(1) << bits) - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Find the next set or clear pixel of a row, skipping whole words
+//
+// PARAMETERS:
+//  row - row index
+//  col - first column to check
+//  end - column to stop at
+//  set - true to find a set pixel, false to find a clear pixel
+//
+// RETURNS:
+//  Column of the pixel (end if there is none before end)
+///////////////////////////////////////////////////////////////////////////////
+int BinaryImage::FindNext(int row, int col, int end, bool set) const
+{
+    if (col >= end)
+    {
+        return end;
+    }
+
+    const Word *words = GetRow(row);
+    const Word invert = set ? 0 : ~static_cast<Word>(0);
+
+    int w = col / 64;
+    Word bits = (words[w] ^ invert) & (~static_cast<Word>(0) << (col % 64));
+    while (bits == 0)
+    {
+        if (++w >= m_wordsPerRow || w * 64 >= end)
+        {
+            return end;
+        }
+        bits = words[w] ^ invert;
+    }
+
+    return std::min(w * 64 + LowestSetBit(bits), end);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Find the runs of set pixels in an area and join the runs of each blob.
+//  Runs of consecutive rows are joined if they overlap (connectivity 4) or
+//  touch diagonally (connectivity 8).
+//
+// PARAMETERS:
+//  area - area of the image to search
+//  connectivity - 4 or 8
+//  runs - reference to return the runs in raster order
+//  labels - reference to return the parent of each run (see FindRoot())
+///////////////////////////////////////////////////////////////////////////////
+void BinaryImage::LabelRuns(const Rect &area, int connectivity, std::vector<Run> &runs, std::vector<int> &labels) const
+{
+    const Rect bounds = area & Rect(0, 0, m_cols, m_rows);
+    const int touch = (connectivity == 8) ? 1 : 0;
+
+    runs.clear();
+    labels.clear();
+
+    size_t previousStart = 0;
+    size_t previousEnd = 0;
+    for (int r = bounds.y; r < bounds.y + bounds.height; r++)
+    {
+        const size_t rowStart = runs.size();
+        const int end = bounds.x + bounds.width;
+        int x = FindNext(r, bounds.x, end, true);
+        while (x < end)
+        {
+            const int runEnd = FindNext(r, x, end, false);
+            runs.push_back(Run{ r, x, runEnd });
+            labels.push_back(static_cast<int>(labels.size()));
+            x = (runEnd < end) ? FindNext(r, runEnd, end, true) : end;
+        }
+
+        //Join with the runs of the previous row (both lists are sorted)
+        size_t p = previousStart;
+        size_t c = rowStart;
+        while (p < previousEnd && c < runs.size())
+        {
+            if (runs[p].start < runs[c].end + touch && runs[c].start < runs[p].end + touch)
+            {
+                const int a = FindRoot(labels, static_cast<int>(p));
+                const int b = FindRoot(labels, static_cast<int>(c));
+                labels[std::max(a, b)] = std::min(a, b);
+            }
+
+            if (runs[p].end < runs[c].end)
+            {
+                p++;
+            }
+            else
+            {
+                c++;
+            }
+        }
+
+        previousStart = rowStart;
+        previousEnd = runs.size();
+    }
+}
@@ -0,0 +1,108 @@
+/******************************************************************************
+
+    FILENAME:       BinaryImage.h
+
+    DESCRIPTION:    Bit-packed binary image (1 bit per pixel, 64 pixels per
+                    word) for processing thresholded frames. Morphology works
+                    on whole words at a time and blobs are extracted from runs
+                    of set pixels, so the post-threshold stages move an eighth
+                    of the memory of an 8-bit image.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+
+#include <cstdint>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class BinaryImage
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Types
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    //Bounding box and pixel count of a connected blob of set pixels
+    struct Blob
+    {
+        cv::Rect box;
+        int      area;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    BinaryImage();
+    BinaryImage(int rows, int cols);
+    virtual ~BinaryImage();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    void Create(int rows, int cols);
+    void FromMat(const cv::Mat &image);
+    void ToMat(cv::Mat &image) const;
+    bool Get(int row, int col) const;
+    int  GetRows() const;
+    int  GetCols() const;
+
+    void Dilate(BinaryImage &result) const;
+    void Erode(BinaryImage &result) const;
+    void Close();
+    void ClearBlobsAt(const std::vector<cv::Point> &seeds, int connectivity = 4);
+    void FillHoles(const cv::Rect &area);
+    void FindBlobs(const cv::Rect &area, int connectivity, std::vector<Blob> &blobs) const;
+
+    static void PackPixels(const unsigned char *pixels, int count, unsigned char *bits);
+    static void UnpackPixels(const unsigned char *bits, int count, unsigned char *pixels);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Types
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    typedef std::uint64_t Word;
+
+    //Horizontal run of set pixels [start, end) in a row
+    struct Run
+    {
+        int row;
+        int start;
+        int end;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    Word       *GetRow(int row);
+    const Word *GetRow(int row) const;
+    Word GetLastWordMask() const;
+    int  FindNext(int row, int col, int end, bool set) const;
+    void LabelRuns(const cv::Rect &area, int connectivity, std::vector<Run> &runs, std::vector<int> &labels) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    int m_rows;
+    int m_cols;
+    int m_wordsPerRow;
+
+    //Rows of pixels, pixel x of a row in bit x % 64 of word x / 64. Bits
+    //past the last column are always clear.
+    std::vector<Word> m_words;
+
+};
@@ -0,0 +1,394 @@
+/******************************************************************************
+
+    FILENAME:       BudgetSolver.cpp
+
+    DESCRIPTION:    Budgeted training of a one-vs-one kernel SVM. Each pair of
+                    classes is trained with kernel stochastic gradient descent
+                    (Pegasos) and the number of support vectors is held under
+                    a budget while training, either for the whole model or for
+                    each pair. When the budget is exceeded the support vector
+                    with the smallest weight is removed and its weight merged
+                    into the support vector it is best projected onto, so the
+                    prediction cost of the model is known before training.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "BudgetSolver.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+using namespace cv;
+
+//Budget checks (and global budget enforcement) per epoch
+static const int ROUNDS_PER_EPOCH = 10;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor
+//
+// PARAMETERS:
+//  kernel - kernel function
+//  c - SVM regularization parameter C
+//  budget - maximum number of support vectors
+//  scope - whether the budget applies to the model or to each class pair
+///////////////////////////////////////////////////////////////////////////////
+BudgetSolver::BudgetSolver(const SvmKernel &kernel, double c, int budget, Scope scope) :
+    m_kernel(kernel),
+    m_c(c),
+    m_budget(budget),
+    m_scope(scope),
+    m_epochs(5)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+BudgetSolver::~BudgetSolver()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the number of passes over the training samples of each class pair
+//
+// PARAMETERS:
+//  epochs - number of epochs (default 5)
+///////////////////////////////////////////////////////////////////////////////
+void BudgetSolver::SetEpochs(int epochs)
+{
+    m_epochs = std::max(epochs, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the one-vs-one decision functions within the budget. The pairs are
+//  trained in parallel in rounds; with a global budget the distinct support
+//  vectors of all pairs are brought back under the budget after each round.
+//
+// PARAMETERS:
+//  features - feature matrix (one CV_32FC1 sample per row)
+//  labels - label matrix (one CV_32SC1 label per row)
+//  classLabels - sorted class labels
+//  model - reference to return the trained model
+//
+// RETURNS:
+//  true if the model was trained
+///////////////////////////////////////////////////////////////////////////////
+bool BudgetSolver::Solve(const Mat &features, const Mat &labels, const std::vector<int> &classLabels,
+                         SvmModel &model)
+{
+    const int classCount = static_cast<int>(classLabels.size());
+    if (m_budget <= 0 || m_c <= 0 || m_kernel.IsSupported() == false || classCount < 2 ||
+        features.type() != CV_32FC1 || labels.type() != CV_32SC1 || features.rows != labels.rows)
+    {
+        return false;
+    }
+
+    m_features = features;
+    m_classIndex.resize(features.rows);
+    m_selfKernel.resize(features.rows);
+    for (int i = 0; i < features.rows; i++)
+    {
+        const int label = labels.at<int>(i, 0);
+        m_classIndex[i] = static_cast<int>(std::lower_bound(classLabels.begin(), classLabels.end(), label) -
+                                           classLabels.begin());
+        m_selfKernel[i] = m_kernel.Evaluate(features.ptr<float>(i), features.ptr<float>(i), features.cols);
+    }
+
+    //Set up the binary problem of each pair in decision function order
+    std::vector<std::vector<int>> classSamples(classCount);
+    for (int i = 0; i < features.rows; i++)
+    {
+        classSamples[m_classIndex[i]].push_back(i);
+    }
+
+    std::vector<Pair> pairs;
+    for (int i = 0; i < classCount; i++)
+    {
+        for (int j = i + 1; j < classCount; j++)
+        {
+            Pair pair;
+            pair.first = i;
+            pair.second = j;
+            pair.samples = classSamples[i];
+            pair.samples.insert(pair.samples.end(), classSamples[j].begin(), classSamples[j].end());
+            pair.next = pair.samples.size();
+            pair.lambda = 1.0 / (m_c * std::max<size_t>(pair.samples.size(), 1));
+            pair.step = 0;
+            pair.rng.seed(static_cast<unsigned int>(pairs.size()));
+            pairs.push_back(pair);
+        }
+    }
+
+    //Train all pairs round by round
+    for (int round = 0; round < m_epochs * ROUNDS_PER_EPOCH; round++)
+    {
+        parallel_for_(Range(0, static_cast<int>(pairs.size())), [&](const Range &range)
+        {
+            for (int p = range.start; p < range.end; p++)
+            {
+                const int steps = static_cast<int>((pairs[p].samples.size() + ROUNDS_PER_EPOCH - 1) / ROUNDS_PER_EPOCH);
+                RunSteps(pairs[p], steps);
+            }
+        });
+
+        if (m_scope == BUDGET_GLOBAL)
+        {
+            EnforceGlobalBudget(pairs);
+        }
+    }
+
+    //Gather the distinct support vectors of all pairs
+    std::map<int, int> svIndex;
+    for (const Pair &pair : pairs)
+    {
+        for (int sample : pair.svs)
+        {
+            svIndex.emplace(sample, 0);
+        }
+    }
+
+    Mat supportVectors(static_cast<int>(svIndex.size()), features.cols, CV_32FC1);
+    int row = 0;
+    for (auto &sv : svIndex)
+    {
+        sv.second = row;
+        features.row(sv.first).copyTo(supportVectors.row(row));
+        row++;
+    }
+
+    //The bias is the weight of the constant 1 added to the kernel, so the
+    //decision value is sum(alpha * K) + sum(alpha)
+    std::vector<SvmModel::DecisionFunction> decisionFunctions;
+    std::vector<double> alpha;
+    std::vector<int> index;
+    for (const Pair &pair : pairs)
+    {
+        SvmModel::DecisionFunction df;
+        df.rho = 0;
+        df.offset = static_cast<int>(alpha.size());
+        df.count = static_cast<int>(pair.svs.size());
+
+        const double scale = (pair.step > 0) ? 1.0 / (pair.lambda * pair.step) : 0.0;
+        for (size_t k = 0; k < pair.svs.size(); k++)
+        {
+            alpha.push_back(pair.counts[k] * scale);
+            index.push_back(svIndex[pair.svs[k]]);
+            df.rho -= alpha.back();
+        }
+
+        decisionFunctions.push_back(df);
+    }
+
+    m_features.release();
+    return model.Create(m_kernel, supportVectors, decisionFunctions, alpha, index, classLabels);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Take gradient steps on a pair's hinge loss, one random sample per step.
+//  Samples violating the margin become (or add weight to) support vectors,
+//  and the smallest support vector is removed whenever the pair is over its
+//  budget.
+//
+// PARAMETERS:
+//  pair - class pair to train
+//  steps - number of steps to take
+///////////////////////////////////////////////////////////////////////////////
+void BudgetSolver::RunSteps(Pair &pair, int steps) const
+{
+    if (pair.samples.empty())
+    {
+        return;
+    }
+
+    for (int s = 0; s < steps; s++)
+    {
+        //Visit the samples in a new random order each epoch
+        if (pair.next >= pair.samples.size())
+        {
+            std::shuffle(pair.samples.begin(), pair.samples.end(), pair.rng);
+            pair.next = 0;
+        }
+
+        const int sample = pair.samples[pair.next++];
+        const double y = (m_classIndex[sample] == pair.first) ? 1.0 : -1.0;
+        pair.step++;
+
+        double f = 0;
+        for (size_t k = 0; k < pair.svs.size(); k++)
+        {
+            f += pair.counts[k] * Kernel(pair.svs[k], sample);
+        }
+        f /= pair.lambda * pair.step;
+
+        if (y * f >= 1)
+        {
+            continue;
+        }
+
+        //Add the violating sample to the support vectors
+        const auto found = std::find(pair.svs.begin(), pair.svs.end(), sample);
+        if (found != pair.svs.end())
+        {
+            pair.counts[found - pair.svs.begin()] += y;
+        }
+        else
+        {
+            pair.svs.push_back(sample);
+            pair.counts.push_back(y);
+        }
+
+        if (static_cast<int>(pair.svs.size()) > m_budget)
+        {
+            Remove(pair, FindSmallest(pair));
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Remove a support vector from a pair, merging its weight into the
+//  remaining support vector that best approximates it (the projection of
+//  the removed vector onto that support vector in feature space)
+//
+// PARAMETERS:
+//  pair - class pair
+//  k - index of the support vector to remove
+///////////////////////////////////////////////////////////////////////////////
+void BudgetSolver::Remove(Pair &pair, int k) const
+{
+    const int removed = pair.svs[k];
+
+    int best = -1;
+    double bestScore = 0;
+    double bestKernel = 0;
+    for (int m = 0; m < static_cast<int>(pair.svs.size()); m++)
+    {
+        if (m == k)
+        {
+            continue;
+        }
+
+        //Projection of the removed vector onto m keeps K(k,m)^2 / K(m,m) of it
+        const double kernel = Kernel(removed, pair.svs[m]);
+        const double score = kernel * kernel / (m_selfKernel[pair.svs[m]] + 1);
+        if (best < 0 || score > bestScore)
+        {
+            best = m;
+            bestScore = score;
+            bestKernel = kernel;
+        }
+    }
+
+    if (best >= 0)
+    {
+        pair.counts[best] += pair.counts[k] * bestKernel / (m_selfKernel[pair.svs[best]] + 1);
+    }
+
+    pair.svs[k] = pair.svs.back();
+    pair.counts[k] = pair.counts.back();
+    pair.svs.pop_back();
+    pair.counts.pop_back();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Find the support vector of a pair with the smallest contribution to the
+//  decision function (norm of its weighted vector in feature space)
+//
+// PARAMETERS:
+//  pair - class pair
+//
+// RETURNS:
+//  Index of the support vector
+///////////////////////////////////////////////////////////////////////////////
+int BudgetSolver::FindSmallest(const Pair &pair) const
+{
+    int smallest = 0;
+    double smallestNorm = 0;
+    for (int k = 0; k < static_cast<int>(pair.svs.size()); k++)
+    {
+        const double norm = pair.counts[k] * pair.counts[k] * (m_selfKernel[pair.svs[k]] + 1);
+        if (k == 0 || norm < smallestNorm)
+        {
+            smallest = k;
+            smallestNorm = norm;
+        }
+    }
+
+    return smallest;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Bring the distinct support vectors of all pairs under the budget. The
+//  samples with the smallest total weight over all pairs are removed from
+//  every pair using them.
+//
+// PARAMETERS:
+//  pairs - class pairs
+///////////////////////////////////////////////////////////////////////////////
+void BudgetSolver::EnforceGlobalBudget(std::vector<Pair> &pairs) const
+{
+    //Total squared weight of each distinct support vector
+    std::map<int, double> weights;
+    for (const Pair &pair : pairs)
+    {
+        const double scale = 1.0 / (pair.lambda * std::max(pair.step, 1));
+        for (size_t k = 0; k < pair.svs.size(); k++)
+        {
+            const double weight = pair.counts[k] * scale;
+            weights[pair.svs[k]] += weight * weight * (m_selfKernel[pair.svs[k]] + 1);
+        }
+    }
+
+    const int excess = static_cast<int>(weights.size()) - m_budget;
+    if (excess <= 0)
+    {
+        return;
+    }
+
+    std::vector<std::pair<double, int>> order;
+    for (const auto &weight : weights)
+    {
+        order.push_back(std::make_pair(weight.second, weight.first));
+    }
+    std::partial_sort(order.begin(), order.begin() + excess, order.end());
+
+    for (int e = 0; e < excess; e++)
+    {
+        const int sample = order[e].second;
+        for (Pair &pair : pairs)
+        {
+            const auto found = std::find(pair.svs.begin(), pair.svs.end(), sample);
+            if (found != pair.svs.end())
+            {
+                Remove(pair, static_cast<int>(found - pair.svs.begin()));
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Evaluate the kernel between two training samples, plus 1 so the constant
+//  feature gives the decision functions their bias
+//
+// PARAMETERS:
+//  a - first sample index
+//  b - second sample index
+//
+// RETURNS:
+//  Kernel value + 1
+///////////////////////////////////////////////////////////////////////////////
+double BudgetSolver::Kernel(int a, int b) const
+{
+    return m_kernel.Evaluate(m_features.ptr<float>(a), m_features.ptr<float>(b), m_features.cols) + 1;
+}
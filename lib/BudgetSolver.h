@@ -0,0 +1,108 @@
+/******************************************************************************
+
+    FILENAME:       BudgetSolver.h
+
+    DESCRIPTION:    Budgeted training of a one-vs-one kernel SVM. Each pair of
+                    classes is trained with kernel stochastic gradient descent
+                    (Pegasos) and the number of support vectors is held under
+                    a budget while training, either for the whole model or for
+                    each pair. When the budget is exceeded the support vector
+                    with the smallest weight is removed and its weight merged
+                    into the support vector it is best projected onto, so the
+                    prediction cost of the model is known before training.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+#include "SvmKernel.h"
+#include "SvmModel.h"
+
+#include <random>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class BudgetSolver
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Types
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    //What the support vector budget applies to
+    enum Scope
+    {
+        BUDGET_GLOBAL,  //Distinct support vectors of the whole model
+        BUDGET_PER_PAIR //Support vectors of each one-vs-one decision function
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    BudgetSolver(const SvmKernel &kernel, double c, int budget, Scope scope);
+    virtual ~BudgetSolver();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    void SetEpochs(int epochs);
+    bool Solve(const cv::Mat &features, const cv::Mat &labels, const std::vector<int> &classLabels,
+               SvmModel &model);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Types
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    //Binary problem of one pair of classes. The weight of support vector k
+    //is counts[k] / (lambda * step), where counts[k] is the signed number of
+    //margin violations of the sample (plus the weight merged into it).
+    struct Pair
+    {
+        int                 first;   //Class index labelled +1
+        int                 second;  //Class index labelled -1
+        std::vector<int>    samples; //Training samples of both classes
+        size_t              next;    //Next sample of the current epoch
+        double              lambda;  //Regularization (1 / (C * sample count))
+        int                 step;    //Gradient steps taken
+        std::vector<int>    svs;     //Sample index of each support vector
+        std::vector<double> counts;  //Scaled weight of each support vector
+        std::mt19937        rng;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    void   RunSteps(Pair &pair, int steps) const;
+    void   Remove(Pair &pair, int k) const;
+    int    FindSmallest(const Pair &pair) const;
+    void   EnforceGlobalBudget(std::vector<Pair> &pairs) const;
+    double Kernel(int a, int b) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    SvmKernel m_kernel;
+    double    m_c;
+    int       m_budget;
+    Scope     m_scope;
+    int       m_epochs;
+
+    //Training data of the current Solve() call
+    cv::Mat             m_features;   //One CV_32FC1 sample per row
+    std::vector<int>    m_classIndex; //Class index of each sample
+    std::vector<double> m_selfKernel; //Kernel of each sample with itself
+
+};
@@ -0,0 +1,309 @@
+/******************************************************************************
+
+    FILENAME:       FeatureFile.cpp
+
+    DESCRIPTION:    On-disk matrix of labelled feature vectors for training
+                    on more samples than fit in memory. The file is written
+                    a block at a time and read through a memory mapping, one
+                    block of rows at a time, with the pages of each block
+                    released once it has been used.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "FeatureFile.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+using namespace cv;
+
+static const char FEATURE_MAGIC[8] = { 'S', 'V', 'M', 'F', 'E', 'A', 'T', '1' };
+
+//Approximate size of the blocks returned by GetBlockRows()
+static const size_t BLOCK_BYTES = 16 << 20;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor
+///////////////////////////////////////////////////////////////////////////////
+FeatureFile::FeatureFile() :
+    m_rows(0),
+    m_cols(0)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+FeatureFile::~FeatureFile()
+{
+    Close();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Create a feature file for writing. Rows are added with Append() and the
+//  file is complete once Close() is called.
+//
+// PARAMETERS:
+//  filename - path of the file to create
+//  cols - number of features per row
+//
+// RETURNS:
+//  true if the file was created
+///////////////////////////////////////////////////////////////////////////////
+bool FeatureFile::Create(const std::string &filename, int cols)
+{
+    Close();
+    if (cols <= 0)
+    {
+        return false;
+    }
+
+    m_writer.open(filename, std::ios::binary | std::ios::trunc);
+    if (m_writer.good() == false)
+    {
+        return false;
+    }
+
+    //The row count is filled in by Close()
+    Header header = {};
+    std::memcpy(header.magic, FEATURE_MAGIC, sizeof(FEATURE_MAGIC));
+    header.cols = cols;
+    m_writer.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    m_cols = cols;
+    return m_writer.good();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Append a block of rows to a file opened with Create()
+//
+// PARAMETERS:
+//  features - feature matrix (one sample per row, converted to CV_32FC1)
+//  labels - label matrix (one label per row, converted to CV_32SC1)
+//
+// RETURNS:
+//  true if the rows were written
+///////////////////////////////////////////////////////////////////////////////
+bool FeatureFile::Append(const Mat &features, const Mat &labels)
+{
+    if (m_writer.is_open() == false || features.cols != m_cols || features.rows != labels.rows)
+    {
+        return false;
+    }
+
+    Mat floatFeatures;
+    Mat intLabels;
+    features.convertTo(floatFeatures, CV_32FC1);
+    labels.convertTo(intLabels, CV_32SC1);
+
+    for (int i = 0; i < floatFeatures.rows; i++)
+    {
+        m_writer.write(intLabels.ptr<char>(i), sizeof(int));
+        m_writer.write(floatFeatures.ptr<char>(i), m_cols * sizeof(float));
+    }
+    m_rows += floatFeatures.rows;
+
+    return m_writer.good();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Open a feature file for reading. The file is memory mapped, so opening
+//  does not read the rows.
+//
+// PARAMETERS:
+//  filename - path of the file to open
+//
+// RETURNS:
+//  true if the file is a valid feature file
+///////////////////////////////////////////////////////////////////////////////
+bool FeatureFile::Open(const std::string &filename)
+{
+    Close();
+    if (m_file.Open(filename) == false || m_file.GetSize() < sizeof(Header))
+    {
+        m_file.Close();
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, m_file.GetData(), sizeof(header));
+    m_rows = std::max(header.rows, 0);
+    m_cols = std::max(header.cols, 0);
+    if (std::memcmp(header.magic, FEATURE_MAGIC, sizeof(FEATURE_MAGIC)) != 0 || m_cols == 0 ||
+        m_file.GetSize() != sizeof(Header) + m_rows * GetRecordSize())
+    {
+        std::cout << "Invalid feature file " << filename << std::endl;
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Close the file. A file being written gets its final row count.
+//
+// RETURNS:
+//  true if a file being written was completed successfully
+///////////////////////////////////////////////////////////////////////////////
+bool FeatureFile::Close()
+{
+    bool result = true;
+    if (m_writer.is_open())
+    {
+        m_writer.seekp(offsetof(Header, rows));
+        m_writer.write(reinterpret_cast<const char*>(&m_rows), sizeof(m_rows));
+        result = m_writer.good();
+        m_writer.close();
+    }
+
+    m_file.Close();
+    m_rows = 0;
+    m_cols = 0;
+
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Check if a file is open for reading
+//
+// RETURNS:
+//  true if a file is open
+///////////////////////////////////////////////////////////////////////////////
+bool FeatureFile::IsOpen() const
+{
+    return m_file.IsOpen();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of rows (samples)
+//
+// RETURNS:
+//  Number of rows
+///////////////////////////////////////////////////////////////////////////////
+int FeatureFile::GetRows() const
+{
+    return m_rows;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of features per row
+//
+// RETURNS:
+//  Number of columns
+///////////////////////////////////////////////////////////////////////////////
+int FeatureFile::GetCols() const
+{
+    return m_cols;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of rows to read per block, so streaming through the file
+//  keeps a fixed amount of it in memory
+//
+// RETURNS:
+//  Rows per block
+///////////////////////////////////////////////////////////////////////////////
+int FeatureFile::GetBlockRows() const
+{
+    return static_cast<int>(std::max<size_t>(BLOCK_BYTES / std::max<size_t>(GetRecordSize(), 1), 1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get a block of rows. The features are used in place in the mapping (the
+//  Mat does not own the memory and must not be written) and the labels are
+//  copied.
+//
+// PARAMETERS:
+//  start - first row of the block
+//  count - number of rows (clipped to the end of the file)
+//  features - reference to return the features (CV_32FC1)
+//  labels - reference to return the labels (CV_32SC1)
+///////////////////////////////////////////////////////////////////////////////
+void FeatureFile::GetBlock(int start, int count, Mat &features, Mat &labels) const
+{
+    count = std::min(count, m_rows - start);
+    if (m_file.IsOpen() == false || start < 0 || count <= 0)
+    {
+        features.release();
+        labels.release();
+        return;
+    }
+
+    const size_t recordSize = GetRecordSize();
+    unsigned char *data = const_cast<unsigned char*>(m_file.GetData()) + sizeof(Header) + start * recordSize;
+    features = Mat(count, m_cols, CV_32FC1, data + sizeof(int), recordSize);
+
+    labels.create(count, 1, CV_32SC1);
+    for (int i = 0; i < count; i++)
+    {
+        std::memcpy(labels.ptr<int>(i), data + i * recordSize, sizeof(int));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Drop a block of rows from memory once it has been used. Mats returned by
+//  GetBlock() stay valid (the rows are read from the file again).
+//
+// PARAMETERS:
+//  start - first row of the block
+//  count - number of rows
+///////////////////////////////////////////////////////////////////////////////
+void FeatureFile::ReleaseBlock(int start, int count) const
+{
+    const size_t recordSize = GetRecordSize();
+    m_file.Release(sizeof(Header) + static_cast<size_t>(std::max(start, 0)) * recordSize,
+                   static_cast<size_t>(std::max(count, 0)) * recordSize);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Count the rows of each label, reading the file one block at a time
+//
+// PARAMETERS:
+//  counts - reference to return the number of rows of each label
+///////////////////////////////////////////////////////////////////////////////
+void FeatureFile::CountLabels(std::map<int, int> &counts) const
+{
+    counts.clear();
+
+    const int blockRows = GetBlockRows();
+    for (int start = 0; start < m_rows; start += blockRows)
+    {
+        Mat features;
+        Mat labels;
+        GetBlock(start, blockRows, features, labels);
+        for (int i = 0; i < labels.rows; i++)
+        {
+            counts[labels.at<int>(i, 0)]++;
+        }
+        ReleaseBlock(start, blockRows);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the size of one row in the file
+//
+// RETURNS:
+//  Label and feature bytes per row
+///////////////////////////////////////////////////////////////////////////////
+size_t FeatureFile::GetRecordSize() const
+{
+    return sizeof(int) + static_cast<size_t>(m_cols) * sizeof(float);
+}
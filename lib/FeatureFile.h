@@ -0,0 +1,94 @@
+/******************************************************************************
+
+    FILENAME:       FeatureFile.h
+
+    DESCRIPTION:    On-disk matrix of labelled feature vectors for training
+                    on more samples than fit in memory. The file is written
+                    a block at a time and read through a memory mapping, one
+                    block of rows at a time, with the pages of each block
+                    released once it has been used.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+#include "MappedFile.h"
+
+#include <fstream>
+#include <map>
+#include <string>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class FeatureFile
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    FeatureFile();
+    virtual ~FeatureFile();
+
+    FeatureFile(const FeatureFile&) = delete;
+    FeatureFile &operator=(const FeatureFile&) = delete;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    bool Create(const std::string &filename, int cols);
+    bool Append(const cv::Mat &features, const cv::Mat &labels);
+    bool Open(const std::string &filename);
+    bool Close();
+
+    bool IsOpen() const;
+    int  GetRows() const;
+    int  GetCols() const;
+    int  GetBlockRows() const;
+    void GetBlock(int start, int count, cv::Mat &features, cv::Mat &labels) const;
+    void ReleaseBlock(int start, int count) const;
+    void CountLabels(std::map<int, int> &counts) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Types
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    //File header, followed by one record per row: the CV_32SC1 label and
+    //then the CV_32FC1 features
+    struct Header
+    {
+        char magic[8];
+        int  rows;
+        int  cols;
+        int  reserved[12];
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    size_t GetRecordSize() const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    int m_rows;
+    int m_cols;
+
+    //File being written by Create()/Append()
+    std::ofstream m_writer;
+
+    //File mapped by Open()
+    MappedFile m_file;
+
+};
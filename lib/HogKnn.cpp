@@ -0,0 +1,561 @@
+/******************************************************************************
+
+    FILENAME:       HogKnn.cpp
+
+    DESCRIPTION:    k-nearest neighbour classifier over the same histogram of
+                    oriented gradients (HOG) features as HogSvm. The training
+                    features are organized in a vantage point tree that is
+                    saved as a flat index file and memory mapped at load time.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "HogKnn.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace cv;
+
+//Identifies (and versions) the index file format
+static const char INDEX_MAGIC[8] = { 'H', 'O', 'G', 'K', 'N', 'N', '1', '\0' };
+
+//Nodes with fewer points measure their distances on the calling thread
+static const int PARALLEL_BUILD_SIZE = 4096;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Default constructor
+///////////////////////////////////////////////////////////////////////////////
+HogKnn::HogKnn() :
+    m_hog(Size(28, 28), Size(4, 4), Size(2, 2), Size(4, 4), 9),
+    m_k(3),
+    m_searchBudget(0)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+HogKnn::~HogKnn()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Predict the class of an image from the labels of its nearest training
+//  images
+//
+// PARAMETERS:
+//  image - image matrix
+//
+// RETURNS:
+//  Predicted value for the given image
+///////////////////////////////////////////////////////////////////////////////
+float HogKnn::Predict(const Mat &image) const
+{
+    Mat features;
+    ExtractFeatures(image, features);
+
+    return PredictSample(features.ptr<float>(0), nullptr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Predict the class of an image and return the votes of the nearest
+//  training images. The decision value is the fraction of the neighbours
+//  voting for the predicted class.
+//
+// PARAMETERS:
+//  image - image matrix
+//  prediction - reference to return the label and votes
+//
+// RETURNS:
+//  Predicted value for the given image
+///////////////////////////////////////////////////////////////////////////////
+float HogKnn::Predict(const Mat &image, SvmModel::Prediction &prediction) const
+{
+    Mat features;
+    ExtractFeatures(image, features);
+
+    return PredictSample(features.ptr<float>(0), &prediction);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Build the vantage point tree over the features of the training images
+//
+// PARAMETERS:
+//  images - packed binary images
+//  labels - label matrix (one label per row)
+//
+// RETURNS:
+//  true if the tree was built
+///////////////////////////////////////////////////////////////////////////////
+bool HogKnn::Train(const PackedImages &images, const Mat &labels)
+{
+    if (images.IsEmpty() || labels.rows != images.GetCount())
+    {
+        return false;
+    }
+
+    Mat features;
+    ExtractFeatures(images, features);
+
+    Mat intLabels;
+    labels.convertTo(intLabels, CV_32SC1);
+
+    //Order the points so each node's subtrees are contiguous
+    std::vector<int> order(features.rows);
+    for (int i = 0; i < features.rows; i++)
+    {
+        order[i] = i;
+    }
+    std::vector<float> radii(features.rows, 0.0f);
+
+    TickMeter timer;
+    timer.start();
+    Build(0, features.rows, features, order, radii);
+    timer.stop();
+
+    m_file.reset();
+    m_points.create(features.rows, features.cols, CV_32FC1);
+    m_labels.create(features.rows, 1, CV_32SC1);
+    for (int i = 0; i < features.rows; i++)
+    {
+        features.row(order[i]).copyTo(m_points.row(i));
+        m_labels.at<int>(i) = intLabels.at<int>(order[i]);
+    }
+    m_radii = Mat(radii, true);
+
+    std::vector<int> classLabels(m_labels.ptr<int>(), m_labels.ptr<int>() + m_labels.rows);
+    std::sort(classLabels.begin(), classLabels.end());
+    classLabels.erase(std::unique(classLabels.begin(), classLabels.end()), classLabels.end());
+    m_classLabels = classLabels;
+
+    std::cout << "Built vantage point tree over " << m_points.rows << " images in "
+              << timer.getTimeSec() << " s" << std::endl;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Test the classifier using the supplied images and labels
+//
+// PARAMETERS:
+//  images - packed binary images
+//  labels - label matrix (one label per row)
+//
+// RETURNS:
+//  Percent error of classification for supplied images and labels
+///////////////////////////////////////////////////////////////////////////////
+float HogKnn::Test(const PackedImages &images, const Mat &labels) const
+{
+    Mat features;
+    ExtractFeatures(images, features);
+
+    Mat intLabels;
+    labels.convertTo(intLabels, CV_32SC1);
+
+    int errors = 0;
+    for (int i = 0; i < features.rows; i++)
+    {
+        const int result = static_cast<int>(PredictSample(features.ptr<float>(i), nullptr));
+        if (result != intLabels.at<int>(i, 0))
+        {
+            errors++;
+        }
+    }
+
+    return (100.0f * errors) / intLabels.rows;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Extract features for each image in a vector of image matrixes (the same
+//  HOG features as HogSvm)
+//
+// PARAMETERS:
+//  images - vector of image matrixes
+//  features - feature matrix (one row of features per image)
+//
+// RETURNS:
+//  true if features matrix is valid
+///////////////////////////////////////////////////////////////////////////////
+bool HogKnn::ExtractFeatures(const std::vector<Mat> &images, Mat &features) const
+{
+    for (const auto &image : images)
+    {
+        ExtractFeatures(image, features);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Extract features for each image of a packed set (each image is unpacked
+//  right before its features are computed)
+//
+// PARAMETERS:
+//  images - packed binary images
+//  features - reference to return the features (one row per image)
+//
+// RETURNS:
+//  true if features matrix is valid
+///////////////////////////////////////////////////////////////////////////////
+bool HogKnn::ExtractFeatures(const PackedImages &images, Mat &features) const
+{
+    images.ComputeHog(m_hog, features);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Load an index file. The file is memory mapped and the tree is used in
+//  place, so loading does not read the training features.
+//
+// PARAMETERS:
+//  filename - path to the index file
+//
+// RETURNS:
+//  true if the index loaded successfully
+///////////////////////////////////////////////////////////////////////////////
+bool HogKnn::Load(const std::string &filename)
+{
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (file->Open(filename) == false || file->GetSize() < sizeof(IndexHeader))
+    {
+        return false;
+    }
+
+    IndexHeader header;
+    std::memcpy(&header, file->GetData(), sizeof(header));
+
+    const size_t rows = static_cast<size_t>(std::max(header.rows, 0));
+    const size_t cols = static_cast<size_t>(std::max(header.cols, 0));
+    const size_t expectedSize = sizeof(IndexHeader) + rows * cols * sizeof(float) +
+                                rows * sizeof(int) + rows * sizeof(float);
+    if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        rows == 0 || cols != m_hog.getDescriptorSize() || file->GetSize() != expectedSize)
+    {
+        std::cout << "Invalid k-NN index file " << filename << std::endl;
+        return false;
+    }
+
+    //Wrap the mapped arrays (read only, the Mats do not own the memory)
+    unsigned char *data = const_cast<unsigned char*>(file->GetData()) + sizeof(IndexHeader);
+    m_points = Mat(header.rows, header.cols, CV_32FC1, data);
+    data += rows * cols * sizeof(float);
+    m_labels = Mat(header.rows, 1, CV_32SC1, data);
+    data += rows * sizeof(int);
+    m_radii = Mat(header.rows, 1, CV_32FC1, data);
+    m_file = file;
+
+    std::vector<int> classLabels(m_labels.ptr<int>(), m_labels.ptr<int>() + m_labels.rows);
+    std::sort(classLabels.begin(), classLabels.end());
+    classLabels.erase(std::unique(classLabels.begin(), classLabels.end()), classLabels.end());
+    m_classLabels = classLabels;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Save the tree to an index file
+//
+// PARAMETERS:
+//  filename - path to the index file
+//
+// RETURNS:
+//  true if the index saved successfully
+///////////////////////////////////////////////////////////////////////////////
+bool HogKnn::Save(const std::string &filename) const
+{
+    if (m_points.empty())
+    {
+        return false;
+    }
+
+    IndexHeader header = {};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.rows = m_points.rows;
+    header.cols = m_points.cols;
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (int i = 0; i < m_points.rows; i++)
+    {
+        file.write(m_points.ptr<char>(i), m_points.cols * sizeof(float));
+    }
+    file.write(m_labels.ptr<char>(), m_labels.rows * sizeof(int));
+    file.write(m_radii.ptr<char>(), m_radii.rows * sizeof(float));
+
+    return file.good();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the number of neighbours voting on the class
+//
+// PARAMETERS:
+//  k - number of neighbours
+///////////////////////////////////////////////////////////////////////////////
+void HogKnn::SetK(int k)
+{
+    m_k = std::max(k, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Limit the number of distances computed per search. The tree is searched
+//  nearest side first, so a limited search returns approximate neighbours
+//  and trades accuracy for latency.
+//
+// PARAMETERS:
+//  maxDistances - maximum distances per search (0 for an exact search)
+///////////////////////////////////////////////////////////////////////////////
+void HogKnn::SetSearchBudget(int maxDistances)
+{
+    m_searchBudget = std::max(maxDistances, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of training images in the tree
+//
+// RETURNS:
+//  Number of training images
+///////////////////////////////////////////////////////////////////////////////
+int HogKnn::GetSize() const
+{
+    return m_points.rows;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Extract features from a single image
+//
+// PARAMETERS:
+//  images - image matrix
+//  features - feature matrix (one row x number of features)
+//
+// RETURNS:
+//  true if features matrix is valid
+///////////////////////////////////////////////////////////////////////////////
+bool HogKnn::ExtractFeatures(const Mat &image, Mat &features) const
+{
+    //Resize input image to match HOG window size
+    Mat hogImage;
+    resize(image, hogImage, m_hog.winSize);
+
+    //Compute HOG descriptors
+    std::vector<float> descriptors(m_hog.getDescriptorSize());
+    m_hog.compute(hogImage, descriptors);
+
+    //Append row vector of HOG descriptors to end of feature matrix
+    features.push_back(Mat(descriptors).t());
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Predict the class of a feature vector by a majority vote of its k
+//  nearest neighbours. Ties go to the class reaching the winning vote count
+//  with the closer neighbours.
+//
+// PARAMETERS:
+//  sample - pointer to the sample features
+//  prediction - optional pointer to return the label and votes
+//
+// RETURNS:
+//  Predicted label
+///////////////////////////////////////////////////////////////////////////////
+float HogKnn::PredictSample(const float *sample, SvmModel::Prediction *prediction) const
+{
+    if (m_points.empty())
+    {
+        return 0;
+    }
+
+    Neighbours neighbours;
+    neighbours.reserve(m_k);
+    int budget = (m_searchBudget > 0) ? m_searchBudget : INT_MAX;
+    Search(0, m_points.rows, sample, neighbours, budget);
+    std::sort_heap(neighbours.begin(), neighbours.end());
+
+    std::vector<int> votes(m_classLabels.size(), 0);
+    int winner = 0;
+    int winnerVotes = 0;
+    for (const auto &neighbour : neighbours)
+    {
+        const int label = m_labels.at<int>(neighbour.second);
+        const int c = static_cast<int>(std::lower_bound(m_classLabels.begin(), m_classLabels.end(), label) -
+                                       m_classLabels.begin());
+        if (++votes[c] > winnerVotes)
+        {
+            winnerVotes = votes[c];
+            winner = c;
+        }
+    }
+
+    const float label = static_cast<float>(m_classLabels[winner]);
+    if (prediction != nullptr)
+    {
+        prediction->label = label;
+        prediction->decision = static_cast<float>(winnerVotes) / std::max<size_t>(neighbours.size(), 1);
+        prediction->votes = votes;
+        prediction->margins.clear();
+    }
+
+    return label;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Build the subtree over points [first, last) of the order. The vantage
+//  point is moved to first, and the remaining points are split at their
+//  median distance from it so the tree is balanced.
+//
+// PARAMETERS:
+//  first - first point of the subtree
+//  last - one past the last point of the subtree
+//  features - training features (one row per image)
+//  order - feature row of each point in tree order
+//  radii - reference to return the radius of each node
+///////////////////////////////////////////////////////////////////////////////
+void HogKnn::Build(int first, int last, const Mat &features, std::vector<int> &order, std::vector<float> &radii) const
+{
+    if (last - first < 2)
+    {
+        return;
+    }
+
+    std::swap(order[first], order[first + (last - first) / 2]);
+    const float *vantage = features.ptr<float>(order[first]);
+
+    //Distance of every other point from the vantage point
+    std::vector<std::pair<float, int>> distances(last - first - 1);
+    auto measure = [&](const Range &range)
+    {
+        for (int i = range.start; i < range.end; i++)
+        {
+            const int point = order[first + 1 + i];
+            const double d = SimdKernels::SquaredDistance(vantage, features.ptr<float>(point), features.cols);
+            distances[i] = std::make_pair(static_cast<float>(std::sqrt(d)), point);
+        }
+    };
+
+    const Range all(0, static_cast<int>(distances.size()));
+    if (all.size() >= PARALLEL_BUILD_SIZE)
+    {
+        parallel_for_(all, measure);
+    }
+    else
+    {
+        measure(all);
+    }
+
+    //Points closer than the median go inside the radius
+    const int middle = first + 1 + (last - first - 1) / 2;
+    std::nth_element(distances.begin(), distances.begin() + (middle - first - 1), distances.end());
+    for (size_t i = 0; i < distances.size(); i++)
+    {
+        order[first + 1 + i] = distances[i].second;
+    }
+    radii[first] = distances[middle - first - 1].first;
+
+    Build(first + 1, middle, features, order, radii);
+    Build(middle, last, features, order, radii);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Search the subtree over points [first, last) for the nearest neighbours
+//  of a sample. The side of the node containing the sample is searched
+//  first, and the other side only if it can hold a closer point.
+//
+// PARAMETERS:
+//  first - first point of the subtree
+//  last - one past the last point of the subtree
+//  sample - pointer to the sample features
+//  neighbours - nearest neighbours found so far
+//  budget - remaining distances the search may compute
+///////////////////////////////////////////////////////////////////////////////
+void HogKnn::Search(int first, int last, const float *sample, Neighbours &neighbours, int &budget) const
+{
+    if (first >= last || budget <= 0)
+    {
+        return;
+    }
+
+    budget--;
+    const double d = SimdKernels::SquaredDistance(sample, m_points.ptr<float>(first), m_points.cols);
+    const float distance = static_cast<float>(std::sqrt(d));
+    AddNeighbour(distance, first, neighbours);
+
+    if (last - first < 2)
+    {
+        return;
+    }
+
+    //Distance of the farthest neighbour kept so far
+    auto farthest = [&]()
+    {
+        return (static_cast<int>(neighbours.size()) < m_k) ? FLT_MAX : neighbours.front().first;
+    };
+
+    const int middle = first + 1 + (last - first - 1) / 2;
+    const float radius = m_radii.at<float>(first);
+    if (distance < radius)
+    {
+        Search(first + 1, middle, sample, neighbours, budget);
+        if (distance + farthest() >= radius)
+        {
+            Search(middle, last, sample, neighbours, budget);
+        }
+    }
+    else
+    {
+        Search(middle, last, sample, neighbours, budget);
+        if (distance - farthest() <= radius)
+        {
+            Search(first + 1, middle, sample, neighbours, budget);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Keep a point if it is one of the k nearest found so far
+//
+// PARAMETERS:
+//  distance - distance of the point from the sample
+//  point - index of the point in tree order
+//  neighbours - nearest neighbours found so far (max heap)
+///////////////////////////////////////////////////////////////////////////////
+void HogKnn::AddNeighbour(float distance, int point, Neighbours &neighbours) const
+{
+    if (static_cast<int>(neighbours.size()) < m_k)
+    {
+        neighbours.push_back(std::make_pair(distance, point));
+        std::push_heap(neighbours.begin(), neighbours.end());
+    }
+    else if (distance < neighbours.front().first)
+    {
+        std::pop_heap(neighbours.begin(), neighbours.end());
+        neighbours.back() = std::make_pair(distance, point);
+        std::push_heap(neighbours.begin(), neighbours.end());
+    }
+}
@@ -0,0 +1,113 @@
+/******************************************************************************
+
+    FILENAME:       HogKnn.h
+
+    DESCRIPTION:    k-nearest neighbour classifier over the same histogram of
+                    oriented gradients (HOG) features as HogSvm. The training
+                    features are organized in a vantage point tree that is
+                    saved as a flat index file and memory mapped at load time.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+#include "SvmModel.h"
+#include "MappedFile.h"
+#include "PackedImages.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class HogKnn
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    HogKnn();
+    virtual ~HogKnn();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    float Predict(const cv::Mat &image) const;
+    float Predict(const cv::Mat &image, SvmModel::Prediction &prediction) const;
+    bool  Train(const PackedImages &images, const cv::Mat &labels);
+    float Test(const PackedImages &images, const cv::Mat &labels) const;
+    bool  ExtractFeatures(const std::vector<cv::Mat> &images, cv::Mat &features) const;
+    bool  ExtractFeatures(const PackedImages &images, cv::Mat &features) const;
+    bool  Load(const std::string &filename);
+    bool  Save(const std::string &filename) const;
+
+    void  SetK(int k);
+    void  SetSearchBudget(int maxDistances);
+    int   GetSize() const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Types
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    //Index file header, followed by the points in tree order (rows x cols
+    //floats), their labels (rows ints) and the radius of each node (rows
+    //floats)
+    struct IndexHeader
+    {
+        char magic[8];
+        int  rows;
+        int  cols;
+        int  reserved[12];
+    };
+
+    //Nearest neighbours found so far (max heap of distance and point)
+    typedef std::vector<std::pair<float, int>> Neighbours;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    bool  ExtractFeatures(const cv::Mat &image, cv::Mat &features) const;
+    float PredictSample(const float *sample, SvmModel::Prediction *prediction) const;
+    void  Build(int first, int last, const cv::Mat &features, std::vector<int> &order, std::vector<float> &radii) const;
+    void  Search(int first, int last, const float *sample, Neighbours &neighbours, int &budget) const;
+    void  AddNeighbour(float distance, int point, Neighbours &neighbours) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    cv::HOGDescriptor m_hog;
+
+    //Number of neighbours voting on the class
+    int m_k;
+
+    //Maximum distances computed per search (0 for an exact search)
+    int m_searchBudget;
+
+    //Vantage point tree. The node covering points [first, last) has its
+    //vantage point at first, the points within its radius in
+    //[first + 1, middle) and the rest in [middle, last).
+    cv::Mat m_points;
+    cv::Mat m_labels;
+    cv::Mat m_radii;
+
+    //Sorted class labels (index of the votes of each class)
+    std::vector<int> m_classLabels;
+
+    //Index file the tree is mapped from (null for a trained tree)
+    std::shared_ptr<MappedFile> m_file;
+
+};
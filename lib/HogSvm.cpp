@@ -17,7 +17,26 @@ using namespace cv;
 //  Default constructor
 ///////////////////////////////////////////////////////////////////////////////
 HogSvm::HogSvm() :
-    m_hog(Size(28, 28), Size(4, 4), Size(2, 2), Size(4, 4), 9)
+    m_hog(Size(28, 28), Size(4, 4), Size(2, 2), Size(4, 4), 9),
+    m_asyncBatchSize(32),
+    m_asyncDelayUs(1000),
+    m_asyncThreadCount(1)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor for a model compiled into the executable (see ModelCompiler)
+//
+// PARAMETERS:
+//  model - compiled model
+///////////////////////////////////////////////////////////////////////////////
+HogSvm::HogSvm(const SvmModel::StaticModel &model) :
+    Svm(model),
+    m_hog(Size(28, 28), Size(4, 4), Size(2, 2), Size(4, 4), 9),
+    m_asyncBatchSize(32),
+    m_asyncDelayUs(1000),
+    m_asyncThreadCount(1)
 {
 
 }
@@ -27,7 +46,8 @@ HogSvm::HogSvm() :
 ///////////////////////////////////////////////////////////////////////////////
 HogSvm::~HogSvm()
 {
-    
+    //Finish queued asynchronous predictions while the model still exists
+    m_executor.reset();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -42,6 +62,12 @@ HogSvm::~HogSvm()
 ///////////////////////////////////////////////////////////////////////////////
 float HogSvm::Predict(const Mat &image) const
 {
+    if (m_cache)
+    {
+        SvmModel::Prediction prediction;
+        return PredictCached(image, prediction);
+    }
+
     //Extract features from image
     Mat features;
     ExtractFeatures(image, features);
@@ -50,6 +76,154 @@ float HogSvm::Predict(const Mat &image) const
     return Svm::Predict(features);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Use the SVM to predict the class from the supplied image and return the 
+//  votes and decision values the prediction was made from.
+//
+// PARAMETERS:
+//  image - image matrix
+//  prediction - reference to return the label and decision values
+//
+// RETURNS:
+//  Predicted value for the given image
+///////////////////////////////////////////////////////////////////////////////
+float HogSvm::Predict(const Mat &image, SvmModel::Prediction &prediction) const
+{
+    if (m_cache)
+    {
+        return PredictCached(image, prediction);
+    }
+
+    //Extract features from image
+    Mat features;
+    ExtractFeatures(image, features);
+
+    //Predict the class using the SVM model
+    return Svm::Predict(features, prediction);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Use the SVM to predict the classes of a batch of images. Cached images
+//  are returned from the cache and the rest are predicted together (see
+//  Svm::PredictBatch).
+//
+// PARAMETERS:
+//  images - vector of image matrices
+//  predictions - reference to return the prediction of each image
+///////////////////////////////////////////////////////////////////////////////
+void HogSvm::PredictBatch(const std::vector<Mat> &images, std::vector<SvmModel::Prediction> &predictions) const
+{
+    predictions.resize(images.size());
+
+    //Find the images that need to be predicted
+    const std::uint64_t modelVersion = m_modelVersion;
+    std::vector<PredictionCache::Key> keys(images.size());
+    std::vector<bool> cacheable(images.size(), false);
+    std::vector<Mat> misses;
+    std::vector<size_t> missIndex;
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        //Resize once for both the cache key and the HOG features
+        Mat hogImage;
+        resize(images[i], hogImage, m_hog.winSize);
+        if (m_cache)
+        {
+            cacheable[i] = PredictionCache::MakeKey(hogImage, keys[i]);
+            if (cacheable[i] && m_cache->Lookup(keys[i], modelVersion, predictions[i]))
+            {
+                continue;
+            }
+        }
+
+        misses.push_back(hogImage);
+        missIndex.push_back(i);
+    }
+
+    if (misses.empty())
+    {
+        return;
+    }
+
+    //Extract features from the resized images and predict them together
+    Mat features;
+    for (const Mat &hogImage : misses)
+    {
+        ComputeFeatures(hogImage, features);
+    }
+
+    std::vector<SvmModel::Prediction> missPredictions;
+    Svm::PredictBatch(features, missPredictions);
+
+    for (size_t m = 0; m < missIndex.size(); m++)
+    {
+        const size_t i = missIndex[m];
+        predictions[i] = missPredictions[m];
+        if (cacheable[i])
+        {
+            m_cache->Insert(keys[i], modelVersion, predictions[i]);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Queue an image for prediction without blocking. Requests from all
+//  threads are coalesced into batches (see SetAsyncBatching()) and predicted
+//  on the executor's worker thread.
+//
+// PARAMETERS:
+//  image - image matrix (shared, not copied, so don't modify it until the
+//          future is ready)
+//  cancel - optional token to cancel the request (e.g. set when the frame
+//           the image came from is dropped)
+//
+// RETURNS:
+//  Future returning the prediction (throws std::runtime_error if cancelled)
+///////////////////////////////////////////////////////////////////////////////
+std::future<SvmModel::Prediction> HogSvm::PredictAsync(const Mat &image, const BatchExecutor::CancelToken &cancel) const
+{
+    std::shared_ptr<BatchExecutor> executor = std::atomic_load(&m_executor);
+    if (executor == nullptr)
+    {
+        //Create the executor, keeping the one another thread created first
+        std::shared_ptr<BatchExecutor> created = std::make_shared<BatchExecutor>(
+            [this](const std::vector<Mat> &images, std::vector<SvmModel::Prediction> &predictions)
+            {
+                PredictBatch(images, predictions);
+            },
+            m_asyncBatchSize, m_asyncDelayUs, m_asyncThreadCount);
+
+        if (std::atomic_compare_exchange_strong(&m_executor, &executor, created))
+        {
+            executor = created;
+        }
+    }
+
+    return executor->Submit(image, cancel);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Configure how PredictAsync() requests are batched. Larger batches make
+//  better use of the batched kernel evaluation at the cost of latency.
+//
+// PARAMETERS:
+//  maxBatchSize - maximum number of requests predicted together
+//  maxDelayUs - longest time a request waits for others to join its batch
+//  threadCount - number of threads predicting batches
+///////////////////////////////////////////////////////////////////////////////
+void HogSvm::SetAsyncBatching(int maxBatchSize, int maxDelayUs, int threadCount)
+{
+    m_asyncBatchSize = maxBatchSize;
+    m_asyncDelayUs = maxDelayUs;
+    m_asyncThreadCount = threadCount;
+
+    //Recreated with the new settings on the next request
+    std::atomic_store(&m_executor, std::shared_ptr<BatchExecutor>());
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
 //  Train the HogSvm using the supplied features and labels.
@@ -73,6 +247,29 @@ bool HogSvm::Train(const std::vector<Mat> &images, const Mat &labels) const
     return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the HogSvm using the supplied features and labels.
+//
+// PARAMETERS:
+//  images - packed binary images
+//  labels - label matrix (one label per row)
+//
+// RETURNS:
+//  true if HogSvm trained successfully
+///////////////////////////////////////////////////////////////////////////////
+bool HogSvm::Train(const PackedImages &images, const Mat &labels) const
+{       
+    //Extract features from images
+    Mat features;
+    ExtractFeatures(images, features);
+
+    //Train the SVM using the features
+    Svm::Train(features, labels);
+
+    return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
 //  Test the current SVM model using the supplied images and labels.
@@ -94,6 +291,27 @@ float HogSvm::Test(const std::vector<Mat> &images, const Mat &labels) const
     return Svm::Test(features, labels);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Test the current SVM model using the supplied images and labels.
+//
+// PARAMETERS:
+//  images - packed binary images
+//  labels - label matrix (one label per row)
+//
+// RETURNS:
+//  Percent error of classification for supplied images and labels
+///////////////////////////////////////////////////////////////////////////////
+float HogSvm::Test(const PackedImages &images, const Mat &labels) const
+{
+    //Extract features from images
+    Mat features;
+    ExtractFeatures(images, features);
+
+    //Test the SVM using the features
+    return Svm::Test(features, labels);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
 //  Extract features for each image in a vector of image matrixes
@@ -116,6 +334,59 @@ bool HogSvm::ExtractFeatures(const std::vector<Mat> &images, Mat &features) cons
     return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Extract features for each image of a packed set. Images are unpacked one
+//  at a time right before their features are computed, in parallel.
+//
+// PARAMETERS:
+//  images - packed binary images
+//  features - feature matrix (one row of features per image)
+//
+// RETURNS:
+//  true if features matrix is valid
+///////////////////////////////////////////////////////////////////////////////
+bool HogSvm::ExtractFeatures(const PackedImages &images, Mat &features) const
+{
+    images.ComputeHog(m_hog, features);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Enable caching of predictions. Images are resized to the HOG window and
+//  the resized pixels form the cache key, so recurring (e.g. static or 
+//  printed) digits skip feature extraction and kernel evaluation, and a 
+//  cached prediction is always the one the image would get.
+//
+// PARAMETERS:
+//  capacity - maximum number of cached predictions (0 disables the cache)
+///////////////////////////////////////////////////////////////////////////////
+void HogSvm::SetCacheCapacity(size_t capacity)
+{
+    if (capacity == 0)
+    {
+        m_cache.reset();
+    }
+    else
+    {
+        m_cache = std::make_shared<PredictionCache>(capacity);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the prediction cache to read its hit rate and memory use
+//
+// RETURNS:
+//  Prediction cache (null if caching is disabled)
+///////////////////////////////////////////////////////////////////////////////
+const PredictionCache *HogSvm::GetCache() const
+{
+    return m_cache.get();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
 //  Extract features from a single image
@@ -129,9 +400,6 @@ bool HogSvm::ExtractFeatures(const std::vector<Mat> &images, Mat &features) cons
 ///////////////////////////////////////////////////////////////////////////////
 bool HogSvm::ExtractFeatures(const cv::Mat & image, cv::Mat & features) const
 {
-    //Get the number of features for the current HOG parameters
-    int numFeatures = static_cast<int>(m_hog.getDescriptorSize());
-
     //Resize input image to match HOG window size
     Mat hogImage;
     resize(image, hogImage, m_hog.winSize);
@@ -144,12 +412,67 @@ bool HogSvm::ExtractFeatures(const cv::Mat & image, cv::Mat & features) const
 //    waitKey(1);
 //#endif
 
+    ComputeFeatures(hogImage, features);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compute the HOG features of an image already resized to the HOG window
+//
+// PARAMETERS:
+//  hogImage - image matrix of the HOG window size
+//  features - feature matrix (one row of features is appended)
+///////////////////////////////////////////////////////////////////////////////
+void HogSvm::ComputeFeatures(const Mat &hogImage, Mat &features) const
+{
+    //Get the number of features for the current HOG parameters
+    int numFeatures = static_cast<int>(m_hog.getDescriptorSize());
+
     //Compute HOG descriptors
     std::vector<float> descriptors(numFeatures);
     m_hog.compute(hogImage, descriptors);
 
     //Append row vector of HOG descriptors to end of feature matrix
     features.push_back(Mat(descriptors).t());
+}
 
-    return true;
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Predict the class of an image, returning the cached prediction when the
+//  resized image has been predicted before by the current model
+//
+// PARAMETERS:
+//  image - image matrix
+//  prediction - reference to return the label and decision values
+//
+// RETURNS:
+//  Predicted value for the given image
+///////////////////////////////////////////////////////////////////////////////
+float HogSvm::PredictCached(const Mat &image, SvmModel::Prediction &prediction) const
+{
+    //Resize input image to match HOG window size and key the cache with it
+    Mat hogImage;
+    resize(image, hogImage, m_hog.winSize);
+
+    PredictionCache::Key key;
+    const bool cacheable = PredictionCache::MakeKey(hogImage, key);
+    const std::uint64_t modelVersion = m_modelVersion;
+    if (cacheable && m_cache->Lookup(key, modelVersion, prediction))
+    {
+        return prediction.label;
+    }
+
+    //Extract features from the resized image and predict the class
+    Mat features;
+    ComputeFeatures(hogImage, features);
+    const float label = Svm::Predict(features, prediction);
+
+    if (cacheable)
+    {
+        m_cache->Insert(key, modelVersion, prediction);
+    }
+
+    return label;
 }
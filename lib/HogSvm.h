@@ -17,6 +17,12 @@
 ///////////////////////////////////////////////////////////////////////////////
 #include "opencv2/opencv.hpp"
 #include "Svm.h"
+#include "PredictionCache.h"
+#include "BatchExecutor.h"
+#include "PackedImages.h"
+
+#include <future>
+#include <memory>
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -29,22 +35,39 @@ class HogSvm : public Svm
     ///////////////////////////////////////////////////////////////////////////
 public:
     HogSvm();
+    explicit HogSvm(const SvmModel::StaticModel &model);
     virtual ~HogSvm();
 
+    //The asynchronous executor calls back into the object that created it
+    HogSvm(const HogSvm&) = delete;
+    HogSvm &operator=(const HogSvm&) = delete;
+
     ///////////////////////////////////////////////////////////////////////////
     // Public Functions
     ///////////////////////////////////////////////////////////////////////////
 public:
     float Predict(const cv::Mat &image) const;
+    float Predict(const cv::Mat &image, SvmModel::Prediction &prediction) const;
+    void  PredictBatch(const std::vector<cv::Mat> &images, std::vector<SvmModel::Prediction> &predictions) const;
+    std::future<SvmModel::Prediction> PredictAsync(const cv::Mat &image, 
+                                                   const BatchExecutor::CancelToken &cancel = nullptr) const;
     bool  Train(const std::vector<cv::Mat> &images, const cv::Mat &labels) const;
+    bool  Train(const PackedImages &images, const cv::Mat &labels) const;
     float Test(const std::vector<cv::Mat> &images, const cv::Mat &labels) const;
+    float Test(const PackedImages &images, const cv::Mat &labels) const;
+    bool  ExtractFeatures(const std::vector<cv::Mat> &images, cv::Mat &features) const;
+    bool  ExtractFeatures(const PackedImages &images, cv::Mat &features) const;
+    void  SetCacheCapacity(size_t capacity);
+    const PredictionCache *GetCache() const;
+    void  SetAsyncBatching(int maxBatchSize, int maxDelayUs, int threadCount = 1);
 
     ///////////////////////////////////////////////////////////////////////////
     // Private Functions
     ///////////////////////////////////////////////////////////////////////////
 private:
-    bool ExtractFeatures(const std::vector<cv::Mat> &images, cv::Mat &features) const;
-    bool ExtractFeatures(const cv::Mat &image, cv::Mat &features) const;
+    bool  ExtractFeatures(const cv::Mat &image, cv::Mat &features) const;
+    void  ComputeFeatures(const cv::Mat &hogImage, cv::Mat &features) const;
+    float PredictCached(const cv::Mat &image, SvmModel::Prediction &prediction) const;
 
     ///////////////////////////////////////////////////////////////////////////
     // Private Variables
@@ -52,4 +75,13 @@ private:
 private:
     cv::HOGDescriptor m_hog;
 
+    //Optional cache of predictions for recurring images
+    std::shared_ptr<PredictionCache> m_cache;
+
+    //Executor batching PredictAsync() requests (created on first use)
+    int m_asyncBatchSize;
+    int m_asyncDelayUs;
+    int m_asyncThreadCount;
+    mutable std::shared_ptr<BatchExecutor> m_executor;
+
 };
\ No newline at end of file
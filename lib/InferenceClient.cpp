@@ -0,0 +1,222 @@
+/******************************************************************************
+
+    FILENAME:       InferenceClient.cpp
+
+    DESCRIPTION:    Client of the digit inference server. Sends images over a
+                    Unix domain socket to a server that has the classifier and
+                    detector models loaded once for all processes on the host,
+                    and returns the predictions.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "InferenceClient.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace cv;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Default constructor
+///////////////////////////////////////////////////////////////////////////////
+InferenceClient::InferenceClient() :
+    m_socket(-1),
+    m_nextRequestId(0)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+InferenceClient::~InferenceClient()
+{
+    Disconnect();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Connect to the inference server
+//
+// PARAMETERS:
+//  socketPath - path of the server's Unix domain socket
+//
+// RETURNS:
+//  true if connected successfully
+///////////////////////////////////////////////////////////////////////////////
+bool InferenceClient::Connect(const std::string &socketPath)
+{
+    Disconnect();
+
+    sockaddr_un address = {};
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_socket < 0)
+    {
+        return false;
+    }
+
+    if (connect(m_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        Disconnect();
+        return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Disconnect from the inference server
+///////////////////////////////////////////////////////////////////////////////
+void InferenceClient::Disconnect()
+{
+    if (m_socket >= 0)
+    {
+        close(m_socket);
+        m_socket = -1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Check if the client is connected
+//
+// RETURNS:
+//  true if connected
+///////////////////////////////////////////////////////////////////////////////
+bool InferenceClient::IsConnected() const
+{
+    return m_socket >= 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Predict an image with one of the server's models. Blocks until the
+//  server responds, so use one client per thread for concurrent requests.
+//
+// PARAMETERS:
+//  image - grayscale image (CV_8UC1, e.g. a 28x28 digit crop)
+//  model - model to predict with
+//  prediction - reference to return the label and decision value (votes
+//               and margins are not returned)
+//
+// RETURNS:
+//  true if the prediction succeeded
+///////////////////////////////////////////////////////////////////////////////
+bool InferenceClient::Predict(const Mat &image, Model model, SvmModel::Prediction &prediction)
+{
+    if (IsConnected() == false || image.type() != CV_8UC1 || image.empty() ||
+        image.rows > static_cast<int>(MAX_IMAGE_SIZE) || image.cols > static_cast<int>(MAX_IMAGE_SIZE))
+    {
+        return false;
+    }
+
+    RequestHeader header;
+    header.magic = MAGIC;
+    header.requestId = m_nextRequestId++;
+    header.model = static_cast<std::uint32_t>(model);
+    header.rows = static_cast<std::uint32_t>(image.rows);
+    header.cols = static_cast<std::uint32_t>(image.cols);
+
+    const Mat data = image.isContinuous() ? image : image.clone();
+    if (SendAll(m_socket, &header, sizeof(header)) == false ||
+        SendAll(m_socket, data.ptr<uchar>(0), data.total()) == false)
+    {
+        Disconnect();
+        return false;
+    }
+
+    Response response;
+    if (ReceiveAll(m_socket, &response, sizeof(response)) == false ||
+        response.magic != MAGIC || response.requestId != header.requestId)
+    {
+        Disconnect();
+        return false;
+    }
+
+    prediction.label = response.label;
+    prediction.decision = response.decision;
+    prediction.votes.clear();
+    prediction.margins.clear();
+
+    return response.status == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Send all of a buffer on a socket
+//
+// PARAMETERS:
+//  socket - connected socket
+//  data - data to send
+//  size - number of bytes to send
+//
+// RETURNS:
+//  true if all of the data was sent (interrupted sends are retried)
+///////////////////////////////////////////////////////////////////////////////
+bool InferenceClient::SendAll(int socket, const void *data, size_t size)
+{
+    const char *bytes = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        const ssize_t sent = send(socket, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent <= 0)
+        {
+            return false;
+        }
+        bytes += sent;
+        size -= static_cast<size_t>(sent);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Receive a buffer from a socket
+//
+// PARAMETERS:
+//  socket - connected socket
+//  data - buffer to receive into
+//  size - number of bytes to receive
+//
+// RETURNS:
+//  true if all of the data was received (interrupted receives are retried)
+///////////////////////////////////////////////////////////////////////////////
+bool InferenceClient::ReceiveAll(int socket, void *data, size_t size)
+{
+    char *bytes = static_cast<char*>(data);
+    while (size > 0)
+    {
+        const ssize_t received = recv(socket, bytes, size, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return false;
+        }
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+
+    return true;
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+
+    FILENAME:       InferenceClient.h
+
+    DESCRIPTION:    Client of the digit inference server. Sends images over a
+                    Unix domain socket to a server that has the classifier and
+                    detector models loaded once for all processes on the host,
+                    and returns the predictions.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x, POSIX sockets
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+#include "SvmModel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class InferenceClient
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Types
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    //Model a request is predicted with
+    enum Model
+    {
+        MODEL_CLASSIFIER = 0,
+        MODEL_DETECTOR = 1
+    };
+
+    //Request header, followed by rows * cols bytes of CV_8UC1 image data
+    struct RequestHeader
+    {
+        std::uint32_t magic;
+        std::uint32_t requestId;
+        std::uint32_t model;
+        std::uint32_t rows;
+        std::uint32_t cols;
+    };
+
+    //Response to each request, sent in request order
+    struct Response
+    {
+        std::uint32_t magic;
+        std::uint32_t requestId;
+        std::int32_t  status;   //0 if the prediction succeeded
+        float         label;
+        float         decision;
+    };
+
+    static const std::uint32_t MAGIC = 0x44494749; //"DIGI"
+    static const std::uint32_t MAX_IMAGE_SIZE = 4096;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    InferenceClient();
+    virtual ~InferenceClient();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    bool Connect(const std::string &socketPath);
+    void Disconnect();
+    bool IsConnected() const;
+    bool Predict(const cv::Mat &image, Model model, SvmModel::Prediction &prediction);
+
+    static bool SendAll(int socket, const void *data, size_t size);
+    static bool ReceiveAll(int socket, void *data, size_t size);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    int m_socket;
+    std::uint32_t m_nextRequestId;
+
+};
@@ -0,0 +1,212 @@
+/******************************************************************************
+
+    FILENAME:       MappedFile.cpp
+
+    DESCRIPTION:    Read-only memory mapping of a file. Pages are loaded on
+                    demand and shared with every other process mapping the
+                    same file.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Default constructor
+///////////////////////////////////////////////////////////////////////////////
+MappedFile::MappedFile() :
+    m_data(nullptr),
+    m_size(0)
+#if defined(_WIN32)
+    , m_file(INVALID_HANDLE_VALUE),
+    m_mapping(nullptr)
+#endif
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Map a file into memory (read only). Any previously mapped file is closed.
+//
+// PARAMETERS:
+//  filename - path of the file to map
+//
+// RETURNS:
+//  true if the file was mapped
+///////////////////////////////////////////////////////////////////////////////
+bool MappedFile::Open(const std::string &filename)
+{
+    Close();
+
+#if defined(_WIN32)
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size;
+    if (m_file == INVALID_HANDLE_VALUE || GetFileSizeEx(m_file, &size) == FALSE || size.QuadPart == 0)
+    {
+        Close();
+        return false;
+    }
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void *data = (m_mapping != nullptr) ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (data == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    m_data = static_cast<const unsigned char*>(data);
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    const int file = open(filename.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        close(file);
+        return false;
+    }
+
+    //The mapping stays valid after the descriptor is closed
+    void *data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    m_data = static_cast<const unsigned char*>(data);
+    m_size = static_cast<size_t>(status.st_size);
+#endif
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Unmap the file. Pointers into the mapping are no longer valid.
+//
+///////////////////////////////////////////////////////////////////////////////
+void MappedFile::Close()
+{
+#if defined(_WIN32)
+    if (m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+    }
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (m_data != nullptr)
+    {
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+    }
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Check if a file is mapped
+//
+// RETURNS:
+//  true if a file is mapped
+///////////////////////////////////////////////////////////////////////////////
+bool MappedFile::IsOpen() const
+{
+    return m_data != nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the mapped file contents
+//
+// RETURNS:
+//  Pointer to the first byte of the file (null if no file is mapped)
+///////////////////////////////////////////////////////////////////////////////
+const unsigned char *MappedFile::GetData() const
+{
+    return m_data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the size of the mapped file
+//
+// RETURNS:
+//  Size of the file in bytes (0 if no file is mapped)
+///////////////////////////////////////////////////////////////////////////////
+size_t MappedFile::GetSize() const
+{
+    return m_size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Drop the pages of a range from the process working set once it has been
+//  read. The pages stay valid and are read from the file again if needed,
+//  so streaming through a large file does not grow the resident memory.
+//
+// PARAMETERS:
+//  offset - offset of the first byte of the range
+//  size - size of the range in bytes
+///////////////////////////////////////////////////////////////////////////////
+void MappedFile::Release(size_t offset, size_t size) const
+{
+    if (m_data == nullptr || offset >= m_size)
+    {
+        return;
+    }
+    if (size > m_size - offset)
+    {
+        size = m_size - offset;
+    }
+
+#if defined(_WIN32)
+    //Unlocking pages that are not locked removes them from the working set
+    VirtualUnlock(const_cast<unsigned char*>(m_data) + offset, size);
+#else
+    //Only whole pages inside the range can be dropped
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t start = (offset + pageSize - 1) / pageSize * pageSize;
+    const size_t end = (offset + size == m_size) ? m_size : (offset + size) / pageSize * pageSize;
+    if (end > start)
+    {
+        madvise(const_cast<unsigned char*>(m_data) + start, end - start, MADV_DONTNEED);
+    }
+#endif
+}
@@ -0,0 +1,61 @@
+/******************************************************************************
+
+    FILENAME:       MappedFile.h
+
+    DESCRIPTION:    Read-only memory mapping of a file. Pages are loaded on
+                    demand and shared with every other process mapping the
+                    same file.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   None
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include <cstddef>
+#include <string>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class MappedFile
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    MappedFile();
+    virtual ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    bool Open(const std::string &filename);
+    void Close();
+    bool IsOpen() const;
+    const unsigned char *GetData() const;
+    size_t GetSize() const;
+    void Release(size_t offset, size_t size) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    const unsigned char *m_data;
+    size_t m_size;
+
+#if defined(_WIN32)
+    void *m_file;
+    void *m_mapping;
+#endif
+
+};
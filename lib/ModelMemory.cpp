@@ -0,0 +1,293 @@
+/******************************************************************************
+
+    FILENAME:       ModelMemory.cpp
+
+    DESCRIPTION:    Placement of model buffers in memory. Supports backing
+                    buffers with 2 MB huge pages to reduce TLB misses when
+                    streaming support vectors, binding buffers to a NUMA node,
+                    and pinning threads to the processors of a NUMA node.
+                    Also reports the peak memory use of the process.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "ModelMemory.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+//Memory policy from <numaif.h> (used through the system call so libnuma is
+//not required)
+static const int MPOL_PREFERRED_NODE = 1;
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Allocate memory for model buffers. Huge pages are requested explicitly
+//  first and fall back to transparent huge pages, then normal pages. The
+//  memory is placed on the requested NUMA node when it is first touched.
+//
+// PARAMETERS:
+//  size - number of bytes to allocate
+//  numaNode - preferred NUMA node (-1 for no preference)
+//  hugePages - true to back the memory with huge pages
+//
+// RETURNS:
+//  Pointer to the memory (released when the last reference goes away), or
+//  null if the allocation failed
+///////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<void> ModelMemory::Allocate(size_t size, int numaNode, bool hugePages)
+{
+    if (size == 0)
+    {
+        return nullptr;
+    }
+
+#if defined(_WIN32)
+    const DWORD node = (numaNode >= 0) ? static_cast<DWORD>(numaNode) : NUMA_NO_PREFERRED_NODE;
+    void *memory = nullptr;
+
+    //Large pages require the SeLockMemoryPrivilege so this can fail
+    const SIZE_T largePageSize = GetLargePageMinimum();
+    if (hugePages && largePageSize > 0)
+    {
+        const SIZE_T largeSize = (size + largePageSize - 1) / largePageSize * largePageSize;
+        memory = VirtualAllocExNuma(GetCurrentProcess(), nullptr, largeSize,
+                                    MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, node);
+    }
+
+    if (memory == nullptr)
+    {
+        memory = VirtualAllocExNuma(GetCurrentProcess(), nullptr, size,
+                                    MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+    }
+
+    if (memory == nullptr)
+    {
+        return nullptr;
+    }
+
+    return std::shared_ptr<void>(memory, [](void *p) { VirtualFree(p, 0, MEM_RELEASE); });
+
+#elif defined(__linux__)
+    const size_t hugePageSize = 2 * 1024 * 1024;
+    size_t mapSize = size;
+    void *memory = MAP_FAILED;
+
+    //Explicit huge pages need pages reserved in /proc/sys/vm/nr_hugepages
+    if (hugePages)
+    {
+        mapSize = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+        memory = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+
+    if (memory == MAP_FAILED)
+    {
+        memory = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        //Ask for transparent huge pages instead
+        if (hugePages)
+        {
+            madvise(memory, mapSize, MADV_HUGEPAGE);
+        }
+    }
+
+    //Prefer the requested node for the pages (placed when first written)
+    if (numaNode >= 0 && numaNode < 1024)
+    {
+        const size_t bitsPerWord = sizeof(unsigned long) * 8;
+        unsigned long nodeMask[1024 / (sizeof(unsigned long) * 8)] = {};
+        nodeMask[numaNode / bitsPerWord] = 1UL << (numaNode % bitsPerWord);
+        syscall(SYS_mbind, memory, mapSize, MPOL_PREFERRED_NODE, nodeMask, 1024, 0);
+    }
+
+    return std::shared_ptr<void>(memory, [mapSize](void *p) { munmap(p, mapSize); });
+
+#else
+    //No placement control, use aligned memory
+    const size_t alignment = 4096;
+    void *memory = std::malloc(size + alignment);
+    if (memory == nullptr)
+    {
+        return nullptr;
+    }
+
+    void *aligned = reinterpret_cast<void*>((reinterpret_cast<size_t>(memory) + alignment) & ~(alignment - 1));
+    return std::shared_ptr<void>(aligned, [memory](void*) { std::free(memory); });
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of NUMA nodes in the system
+//
+// RETURNS:
+//  Number of NUMA nodes (1 if the system is not NUMA)
+///////////////////////////////////////////////////////////////////////////////
+int ModelMemory::GetNumaNodeCount()
+{
+#if defined(_WIN32)
+    ULONG highestNode = 0;
+    if (GetNumaHighestNodeNumber(&highestNode) == FALSE)
+    {
+        return 1;
+    }
+
+    return static_cast<int>(highestNode) + 1;
+
+#elif defined(__linux__)
+    int count = 0;
+    while (access(("/sys/devices/system/node/node" + std::to_string(count)).c_str(), F_OK) == 0)
+    {
+        count++;
+    }
+
+    return (count > 0) ? count : 1;
+
+#else
+    return 1;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the NUMA node of the processor the calling thread is running on
+//
+// RETURNS:
+//  NUMA node of the current processor
+///////////////////////////////////////////////////////////////////////////////
+int ModelMemory::GetCurrentNumaNode()
+{
+#if defined(_WIN32)
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+
+    USHORT node = 0;
+    if (GetNumaProcessorNodeEx(&processor, &node) == FALSE)
+    {
+        return 0;
+    }
+
+    return static_cast<int>(node);
+
+#elif defined(__linux__)
+    unsigned int cpu = 0;
+    unsigned int node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+    {
+        return 0;
+    }
+
+    return static_cast<int>(node);
+
+#else
+    return 0;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Restrict the calling thread to the processors of a NUMA node
+//
+// PARAMETERS:
+//  numaNode - NUMA node to run on
+//
+// RETURNS:
+//  true if the thread was pinned
+///////////////////////////////////////////////////////////////////////////////
+bool ModelMemory::PinThreadToNumaNode(int numaNode)
+{
+#if defined(_WIN32)
+    GROUP_AFFINITY affinity = {};
+    if (GetNumaNodeProcessorMaskEx(static_cast<USHORT>(numaNode), &affinity) == FALSE)
+    {
+        return false;
+    }
+
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != FALSE;
+
+#elif defined(__linux__)
+    //CPU list is formatted as ranges, e.g. "0-15,32-47"
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(numaNode) + "/cpulist");
+    std::string cpuList;
+    if (!std::getline(file, cpuList))
+    {
+        return false;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+
+    std::stringstream ranges(cpuList);
+    std::string range;
+    while (std::getline(ranges, range, ','))
+    {
+        const size_t dash = range.find('-');
+        const int first = std::atoi(range.c_str());
+        const int last = (dash == std::string::npos) ? first : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+
+#else
+    return false;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the peak resident memory (working set) of the process so far
+//
+// RETURNS:
+//  Peak resident memory in bytes (0 if not supported)
+///////////////////////////////////////////////////////////////////////////////
+size_t ModelMemory::GetPeakResidentMemory()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == FALSE)
+    {
+        return 0;
+    }
+
+    return counters.PeakWorkingSetSize;
+
+#elif defined(__linux__)
+    //Maximum resident set size is reported in kilobytes
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+
+#else
+    return 0;
+#endif
+}
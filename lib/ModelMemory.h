@@ -0,0 +1,40 @@
+/******************************************************************************
+
+    FILENAME:       ModelMemory.h
+
+    DESCRIPTION:    Placement of model buffers in memory. Supports backing
+                    buffers with 2 MB huge pages to reduce TLB misses when
+                    streaming support vectors, binding buffers to a NUMA node,
+                    and pinning threads to the processors of a NUMA node.
+                    Also reports the peak memory use of the process.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   Linux (mmap/mbind) or Windows (VirtualAllocExNuma)
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include <cstddef>
+#include <memory>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class ModelMemory
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    static std::shared_ptr<void> Allocate(size_t size, int numaNode, bool hugePages);
+    static int  GetNumaNodeCount();
+    static int  GetCurrentNumaNode();
+    static bool PinThreadToNumaNode(int numaNode);
+    static size_t GetPeakResidentMemory();
+
+};
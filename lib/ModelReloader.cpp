@@ -0,0 +1,231 @@
+/******************************************************************************
+
+    FILENAME:       ModelReloader.cpp
+
+    DESCRIPTION:    Keeps a HogSvm model file loaded and reloads it in the
+                    background when the file changes or a reload is requested.
+                    The live model is an immutable reference counted handle
+                    that is swapped atomically, so users holding the previous
+                    model finish with it while new users get the new one.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "ModelReloader.h"
+
+#include <iostream>
+#include <system_error>
+
+using namespace cv;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor
+//
+// PARAMETERS:
+//  filename - model file to load and watch
+//  pollIntervalMs - time between checks of the file modification time
+//  cacheCapacity - prediction cache capacity of the model (0 for no cache)
+///////////////////////////////////////////////////////////////////////////////
+ModelReloader::ModelReloader(const std::string &filename, int pollIntervalMs, size_t cacheCapacity) :
+    m_filename(filename),
+    m_pollInterval(pollIntervalMs),
+    m_cacheCapacity(cacheCapacity),
+    m_running(false),
+    m_reloadRequested(false)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+ModelReloader::~ModelReloader()
+{
+    Stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Load the model and start watching the model file
+//
+// RETURNS:
+//  true if the model was loaded successfully
+///////////////////////////////////////////////////////////////////////////////
+bool ModelReloader::Start()
+{
+    if (LoadModel() == false)
+    {
+        return false;
+    }
+
+    StartWatching();
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Start with a model that is already loaded (e.g. compiled into the
+//  executable) and watch the model file for updates. The file doesn't need
+//  to exist, it is loaded if it is created or changed later.
+//
+// PARAMETERS:
+//  model - initial model
+//
+// RETURNS:
+//  true if the model is valid
+///////////////////////////////////////////////////////////////////////////////
+bool ModelReloader::Start(const std::shared_ptr<HogSvm> &model)
+{
+    if (model == nullptr || model->IsTrained() == false)
+    {
+        return false;
+    }
+
+    //An existing file is assumed to match the initial model
+    std::error_code error;
+    m_loadedTime = std::filesystem::last_write_time(m_filename, error);
+
+    model->SetCacheCapacity(m_cacheCapacity);
+    std::atomic_store(&m_model, std::shared_ptr<const HogSvm>(model));
+
+    StartWatching();
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Start the background thread watching the model file
+///////////////////////////////////////////////////////////////////////////////
+void ModelReloader::StartWatching()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running == false)
+    {
+        m_running = true;
+        m_thread = std::thread(&ModelReloader::WatchModel, this);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Stop watching the model file. The current model remains available.
+///////////////////////////////////////////////////////////////////////////////
+void ModelReloader::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_condition.notify_all();
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Request the model file be reloaded even if it has not changed. The
+//  reload happens in the background and does not block the caller.
+///////////////////////////////////////////////////////////////////////////////
+void ModelReloader::RequestReload()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_reloadRequested = true;
+    }
+    m_condition.notify_all();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the live model. The returned handle keeps the model alive after it is
+//  replaced, so hold it for the duration of one unit of work (e.g. a frame).
+//
+// RETURNS:
+//  Live model (null if no model has been loaded)
+///////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<const HogSvm> ModelReloader::GetModel() const
+{
+    return std::atomic_load(&m_model);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Background thread checking the model file modification time. A changed
+//  file is only loaded once its modification time has been stable for one
+//  poll interval so a file that is still being written is not loaded.
+///////////////////////////////////////////////////////////////////////////////
+void ModelReloader::WatchModel()
+{
+    std::filesystem::file_time_type pendingTime = m_loadedTime;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running)
+    {
+        m_condition.wait_for(lock, m_pollInterval, [this] { return m_running == false || m_reloadRequested; });
+        if (m_running == false)
+        {
+            break;
+        }
+
+        bool reload = m_reloadRequested;
+        m_reloadRequested = false;
+
+        std::error_code error;
+        const auto writeTime = std::filesystem::last_write_time(m_filename, error);
+        if (error.value() == 0 && writeTime != m_loadedTime)
+        {
+            reload = reload || (writeTime == pendingTime);
+            pendingTime = writeTime;
+        }
+
+        //Load without holding the lock so reload requests never block
+        if (reload)
+        {
+            lock.unlock();
+            LoadModel();
+            lock.lock();
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Load the model file into a new model and make it the live model. The
+//  current model is kept if the load fails.
+//
+// RETURNS:
+//  true if the model was loaded successfully
+///////////////////////////////////////////////////////////////////////////////
+bool ModelReloader::LoadModel()
+{
+    std::error_code error;
+    const auto writeTime = std::filesystem::last_write_time(m_filename, error);
+
+    TickMeter timer;
+    timer.start();
+
+    //OpenCV XML models are read with the fast parser when possible
+    std::shared_ptr<HogSvm> model = std::make_shared<HogSvm>();
+    if (model->LoadXml(m_filename) == false && model->Load(m_filename) == false)
+    {
+        std::cout << "Failed to reload " << m_filename << ", keeping current model" << std::endl;
+        m_loadedTime = writeTime;
+        return false;
+    }
+    model->SetCacheCapacity(m_cacheCapacity);
+
+    timer.stop();
+
+    const bool replaced = (GetModel() != nullptr);
+    std::atomic_store(&m_model, std::shared_ptr<const HogSvm>(model));
+    m_loadedTime = writeTime;
+
+    std::cout << (replaced ? "Swapped in " : "Loaded ") << m_filename
+              << " (load time " << timer.getTimeMilli() << " ms): " << model->DescribeModel() << std::endl;
+
+    return true;
+}
@@ -0,0 +1,87 @@
+/******************************************************************************
+
+    FILENAME:       ModelReloader.h
+
+    DESCRIPTION:    Keeps a HogSvm model file loaded and reloads it in the
+                    background when the file changes or a reload is requested.
+                    The live model is an immutable reference counted handle
+                    that is swapped atomically, so users holding the previous
+                    model finish with it while new users get the new one.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "HogSvm.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class ModelReloader
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    ModelReloader(const std::string &filename, int pollIntervalMs = 500, size_t cacheCapacity = 0);
+    virtual ~ModelReloader();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    bool Start();
+    bool Start(const std::shared_ptr<HogSvm> &model);
+    void Stop();
+    void RequestReload();
+
+    std::shared_ptr<const HogSvm> GetModel() const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    void StartWatching();
+    void WatchModel();
+    bool LoadModel();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    std::string m_filename;
+    std::chrono::milliseconds m_pollInterval;
+
+    //Prediction cache capacity of each loaded model
+    size_t m_cacheCapacity;
+
+    //Live model (only accessed through std::atomic_load/std::atomic_store)
+    std::shared_ptr<const HogSvm> m_model;
+
+    //Modification time of the loaded file
+    std::filesystem::file_time_type m_loadedTime;
+
+    //Background thread watching the file
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_running;
+    bool m_reloadRequested;
+
+};
@@ -0,0 +1,236 @@
+/******************************************************************************
+
+    FILENAME:       PackedImages.cpp
+
+    DESCRIPTION:    Set of binary images of the same size stored bit-packed 
+                    (1 bit per pixel, e.g. 98 bytes for a 28 x 28 MNIST image 
+                    instead of 784). Images are unpacked one at a time right 
+                    before their HOG features are computed.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "PackedImages.h"
+#include "BinaryImage.h"
+
+using namespace cv;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Default constructor
+///////////////////////////////////////////////////////////////////////////////
+PackedImages::PackedImages() :
+    m_rows(0),
+    m_cols(0),
+    m_imageBytes(0),
+    m_count(0)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+PackedImages::~PackedImages()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Remove all images and set the size of the images to be added
+//
+// PARAMETERS:
+//  rows - number of rows of each image
+//  cols - number of columns of each image
+//  capacity - number of images to reserve memory for
+///////////////////////////////////////////////////////////////////////////////
+void PackedImages::Create(int rows, int cols, int capacity)
+{
+    m_rows = rows;
+    m_cols = cols;
+    m_imageBytes = (static_cast<size_t>(rows) * cols + 7) / 8;
+    m_count = 0;
+    m_bits.clear();
+    m_bits.reserve(static_cast<size_t>(capacity) * m_imageBytes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Pack a binary image and add it to the set. If Create() wasn't called the
+//  first image sets the size of all images.
+//
+// PARAMETERS:
+//  image - 8-bit single channel binary image (pixels that are not zero are 
+//          set)
+//
+// RETURNS:
+//  true if the image was added (false if its size or type doesn't match)
+///////////////////////////////////////////////////////////////////////////////
+bool PackedImages::Add(const Mat &image)
+{
+    if (image.type() != CV_8UC1 || image.empty())
+    {
+        return false;
+    }
+
+    if (m_imageBytes == 0)
+    {
+        Create(image.rows, image.cols);
+    }
+    else if (image.rows != m_rows || image.cols != m_cols)
+    {
+        return false;
+    }
+
+    //Rows are packed without padding, so pack a continuous copy in one go
+    const Mat pixels = image.isContinuous() ? image : image.clone();
+    m_bits.resize(m_bits.size() + m_imageBytes);
+    BinaryImage::PackPixels(pixels.ptr<uchar>(), m_rows * m_cols, &m_bits[m_bits.size() - m_imageBytes]);
+    m_count++;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Unpack an image
+//
+// PARAMETERS:
+//  index - image index
+//  image - reference to return the image (255 for set pixels, 0 otherwise)
+///////////////////////////////////////////////////////////////////////////////
+void PackedImages::Unpack(int index, Mat &image) const
+{
+    CV_Assert(index >= 0 && index < m_count);
+
+    image.create(m_rows, m_cols, CV_8UC1);
+    BinaryImage::UnpackPixels(&m_bits[index * m_imageBytes], m_rows * m_cols, image.ptr<uchar>());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the packed bits of an image without unpacking it
+//
+// PARAMETERS:
+//  index - image index
+//
+// RETURNS:
+//  Pointer to the GetImageBytes() bytes of the image
+///////////////////////////////////////////////////////////////////////////////
+const unsigned char *PackedImages::GetBits(int index) const
+{
+    CV_Assert(index >= 0 && index < m_count);
+
+    return &m_bits[index * m_imageBytes];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compute the HOG features of every image in parallel. Each thread unpacks
+//  an image into its own buffer and computes its descriptors straight away,
+//  so only one 8-bit image per thread exists at a time.
+//
+// PARAMETERS:
+//  hog - HOG descriptor (images are resized to its window size if needed)
+//  features - reference to return the features (one row per image)
+///////////////////////////////////////////////////////////////////////////////
+void PackedImages::ComputeHog(const HOGDescriptor &hog, Mat &features) const
+{
+    const int numFeatures = static_cast<int>(hog.getDescriptorSize());
+    features.create(m_count, numFeatures, CV_32FC1);
+
+    parallel_for_(Range(0, m_count), [&](const Range &range)
+    {
+        Mat image;
+        Mat hogImage;
+        std::vector<float> descriptors(numFeatures);
+        for (int i = range.start; i < range.end; i++)
+        {
+            Unpack(i, image);
+            if (image.size() != hog.winSize)
+            {
+                resize(image, hogImage, hog.winSize);
+            }
+            else
+            {
+                hogImage = image;
+            }
+
+            hog.compute(hogImage, descriptors);
+            std::copy(descriptors.begin(), descriptors.end(), features.ptr<float>(i));
+        }
+    });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Check if the set has no images
+//
+// RETURNS:
+//  true if no images were added
+///////////////////////////////////////////////////////////////////////////////
+bool PackedImages::IsEmpty() const
+{
+    return m_count == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of images
+//
+// RETURNS:
+//  Number of images
+///////////////////////////////////////////////////////////////////////////////
+int PackedImages::GetCount() const
+{
+    return m_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of rows of each image
+//
+// RETURNS:
+//  Number of rows
+///////////////////////////////////////////////////////////////////////////////
+int PackedImages::GetRows() const
+{
+    return m_rows;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of columns of each image
+//
+// RETURNS:
+//  Number of columns
+///////////////////////////////////////////////////////////////////////////////
+int PackedImages::GetCols() const
+{
+    return m_cols;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the packed size of each image
+//
+// RETURNS:
+//  Bytes per image
+///////////////////////////////////////////////////////////////////////////////
+size_t PackedImages::GetImageBytes() const
+{
+    return m_imageBytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the memory holding the packed images
+//
+// RETURNS:
+//  Memory usage in bytes
+///////////////////////////////////////////////////////////////////////////////
+size_t PackedImages::GetMemoryUsage() const
+{
+    return m_bits.capacity();
+}
@@ -0,0 +1,66 @@
+/******************************************************************************
+
+    FILENAME:       PackedImages.h
+
+    DESCRIPTION:    Set of binary images of the same size stored bit-packed 
+                    (1 bit per pixel, e.g. 98 bytes for a 28 x 28 MNIST image 
+                    instead of 784). Images are unpacked one at a time right 
+                    before their HOG features are computed.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class PackedImages
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    PackedImages();
+    virtual ~PackedImages();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    void   Create(int rows, int cols, int capacity = 0);
+    bool   Add(const cv::Mat &image);
+    void   Unpack(int index, cv::Mat &image) const;
+    const unsigned char *GetBits(int index) const;
+    void   ComputeHog(const cv::HOGDescriptor &hog, cv::Mat &features) const;
+    bool   IsEmpty() const;
+    int    GetCount() const;
+    int    GetRows() const;
+    int    GetCols() const;
+    size_t GetImageBytes() const;
+    size_t GetMemoryUsage() const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    int    m_rows;
+    int    m_cols;
+    size_t m_imageBytes; //Bytes of bits per image ((rows * cols + 7) / 8)
+    int    m_count;
+
+    //Bits of each image in turn, pixels in row major order (see 
+    //BinaryImage::PackPixels())
+    std::vector<unsigned char> m_bits;
+
+};
@@ -0,0 +1,257 @@
+/******************************************************************************
+
+    FILENAME:       PolySketch.cpp
+
+    DESCRIPTION:    Randomized explicit feature map (TensorSketch) approximating
+                    a polynomial kernel (gamma * x.y + coef0)^degree, so that a
+                    linear SVM on the mapped features approximates the kernel
+                    SVM at a cost independent of the number of support vectors
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "PolySketch.h"
+
+#include <cmath>
+
+using namespace cv;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Default constructor
+///////////////////////////////////////////////////////////////////////////////
+PolySketch::PolySketch() :
+    m_inputDim(0),
+    m_outputDim(0),
+    m_degree(0),
+    m_gamma(0),
+    m_coef0(0),
+    m_seed(0)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor
+//
+// PARAMETERS:
+//  outputDim - number of mapped features
+//  degree - polynomial kernel degree
+//  gamma - polynomial kernel gamma
+//  coef0 - polynomial kernel coef0
+//  seed - seed used to generate the hash functions
+///////////////////////////////////////////////////////////////////////////////
+PolySketch::PolySketch(int outputDim, int degree, double gamma, double coef0, std::uint64_t seed) :
+    m_inputDim(0),
+    m_outputDim(outputDim),
+    m_degree(degree),
+    m_gamma(gamma),
+    m_coef0(coef0),
+    m_seed(seed)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+PolySketch::~PolySketch()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Generate the hash functions for the given number of input features. The
+//  hashes are generated from the seed so a saved map only needs its
+//  parameters to be recreated.
+//
+// PARAMETERS:
+//  inputDim - number of input features
+//
+// RETURNS:
+//  true if the map was created successfully
+///////////////////////////////////////////////////////////////////////////////
+bool PolySketch::Create(int inputDim)
+{
+    if (inputDim <= 0 || m_outputDim <= 0 || m_degree < 1 || m_gamma <= 0 || m_coef0 < 0)
+    {
+        return false;
+    }
+
+    m_inputDim = inputDim;
+
+    const int hashDim = m_inputDim + 1;
+    m_hash.resize(m_degree * hashDim);
+    m_sign.resize(m_degree * hashDim);
+
+    RNG rng(m_seed);
+    for (size_t i = 0; i < m_hash.size(); i++)
+    {
+        m_hash[i] = rng.uniform(0, m_outputDim);
+        m_sign[i] = (rng.uniform(0, 2) == 0) ? -1.0f : 1.0f;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Map a matrix of features into the sketch space
+//
+// PARAMETERS:
+//  features - feature matrix (one CV_32FC1 feature set per row)
+//  mapped - reference to return the mapped features (one row per input row)
+///////////////////////////////////////////////////////////////////////////////
+void PolySketch::Map(const Mat &features, Mat &mapped) const
+{
+    CV_Assert(features.type() == CV_32FC1 && features.cols == m_inputDim);
+
+    mapped.create(features.rows, m_outputDim, CV_32FC1);
+
+    //Rows are independent so map them in parallel
+    parallel_for_(Range(0, features.rows), [&](const Range &range)
+    {
+        for (int i = range.start; i < range.end; i++)
+        {
+            MapSample(features.ptr<float>(i), mapped.ptr<float>(i));
+        }
+    });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Write the map parameters to a file storage node
+//
+// PARAMETERS:
+//  fs - file storage opened for writing (inside a map node)
+///////////////////////////////////////////////////////////////////////////////
+void PolySketch::Write(FileStorage &fs) const
+{
+    fs << "type" << "TENSOR_SKETCH";
+    fs << "input_dim" << m_inputDim;
+    fs << "output_dim" << m_outputDim;
+    fs << "degree" << m_degree;
+    fs << "gamma" << m_gamma;
+    fs << "coef0" << m_coef0;
+
+    //Seed is stored as a string since file storage only holds 32 bit integers
+    fs << "seed" << std::to_string(m_seed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Read the map parameters from a file storage node and recreate the map
+//
+// PARAMETERS:
+//  node - file storage node written by Write()
+//
+// RETURNS:
+//  true if the map was read successfully
+///////////////////////////////////////////////////////////////////////////////
+bool PolySketch::Read(const FileNode &node)
+{
+    if (node.empty() || static_cast<std::string>(node["type"]) != "TENSOR_SKETCH")
+    {
+        return false;
+    }
+
+    m_outputDim = static_cast<int>(node["output_dim"]);
+    m_degree    = static_cast<int>(node["degree"]);
+    m_gamma     = static_cast<double>(node["gamma"]);
+    m_coef0     = static_cast<double>(node["coef0"]);
+    m_seed      = std::stoull(static_cast<std::string>(node["seed"]));
+
+    return Create(static_cast<int>(node["input_dim"]));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of input features
+//
+// RETURNS:
+//  Number of input features
+///////////////////////////////////////////////////////////////////////////////
+int PolySketch::GetInputDim() const
+{
+    return m_inputDim;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of mapped features
+//
+// RETURNS:
+//  Number of mapped features
+///////////////////////////////////////////////////////////////////////////////
+int PolySketch::GetOutputDim() const
+{
+    return m_outputDim;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Map a single sample. The sample is scaled by sqrt(gamma) and extended with
+//  a constant sqrt(coef0) feature so the kernel becomes (x'.y')^degree. One
+//  count sketch per degree is computed and the sketches are multiplied in the
+//  frequency domain (circular convolution), so the dot product of two mapped
+//  samples is an unbiased estimate of the polynomial kernel.
+//
+// PARAMETERS:
+//  sample - pointer to the input features (GetInputDim() values)
+//  mapped - pointer to return the mapped features (GetOutputDim() values)
+///////////////////////////////////////////////////////////////////////////////
+void PolySketch::MapSample(const float *sample, float *mapped) const
+{
+    const float scale = static_cast<float>(std::sqrt(m_gamma));
+    const float constant = static_cast<float>(std::sqrt(m_coef0));
+    const int hashDim = m_inputDim + 1;
+
+    Mat product;
+    for (int d = 0; d < m_degree; d++)
+    {
+        const int *hash = &m_hash[d * hashDim];
+        const float *sign = &m_sign[d * hashDim];
+
+        //Count sketch of the scaled sample (zero features add nothing)
+        Mat sketch = Mat::zeros(1, m_outputDim, CV_32FC1);
+        float *bins = sketch.ptr<float>(0);
+        for (int k = 0; k < m_inputDim; k++)
+        {
+            if (sample[k] != 0)
+            {
+                bins[hash[k]] += sign[k] * scale * sample[k];
+            }
+        }
+        bins[hash[m_inputDim]] += sign[m_inputDim] * constant;
+
+        if (m_degree == 1)
+        {
+            product = sketch;
+            break;
+        }
+
+        //Multiply the spectra of the sketches
+        Mat spectrum;
+        dft(sketch, spectrum, DFT_COMPLEX_OUTPUT);
+        if (d == 0)
+        {
+            product = spectrum;
+        }
+        else
+        {
+            mulSpectrums(product, spectrum, product, 0);
+        }
+    }
+
+    //Return to the spatial domain
+    Mat result(1, m_outputDim, CV_32FC1, mapped);
+    if (m_degree == 1)
+    {
+        product.copyTo(result);
+    }
+    else
+    {
+        dft(product, result, DFT_INVERSE | DFT_SCALE | DFT_REAL_OUTPUT);
+    }
+}
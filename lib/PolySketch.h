@@ -0,0 +1,73 @@
+/******************************************************************************
+
+    FILENAME:       PolySketch.h
+
+    DESCRIPTION:    Randomized explicit feature map (TensorSketch) approximating
+                    a polynomial kernel (gamma * x.y + coef0)^degree, so that a
+                    linear SVM on the mapped features approximates the kernel
+                    SVM at a cost independent of the number of support vectors
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+
+#include <cstdint>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class PolySketch
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    PolySketch();
+    PolySketch(int outputDim, int degree, double gamma, double coef0, std::uint64_t seed = 0x5EED);
+    virtual ~PolySketch();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    bool Create(int inputDim);
+    void Map(const cv::Mat &features, cv::Mat &mapped) const;
+    void Write(cv::FileStorage &fs) const;
+    bool Read(const cv::FileNode &node);
+
+    int  GetInputDim() const;
+    int  GetOutputDim() const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    void MapSample(const float *sample, float *mapped) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    int           m_inputDim;
+    int           m_outputDim;
+    int           m_degree;
+    double        m_gamma;
+    double        m_coef0;
+    std::uint64_t m_seed;
+
+    //Count sketch hash bucket and sign of each input feature for each degree.
+    //The last feature of each degree is the constant sqrt(coef0) term.
+    std::vector<int>   m_hash;
+    std::vector<float> m_sign;
+
+};
@@ -0,0 +1,284 @@
+/******************************************************************************
+
+    FILENAME:       PredictionCache.cpp
+
+    DESCRIPTION:    Bounded, thread safe least recently used cache of
+                    predictions keyed on the exact pixels of the 28x28 image
+                    the features are computed from.
+                    The cache is split into independently locked shards so
+                    concurrent predictions rarely contend.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "PredictionCache.h"
+
+#include <cstring>
+
+using namespace cv;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor
+//
+// PARAMETERS:
+//  capacity - maximum number of cached predictions
+///////////////////////////////////////////////////////////////////////////////
+PredictionCache::PredictionCache(size_t capacity) :
+    m_shardCapacity(std::max<size_t>(1, (capacity + SHARD_COUNT - 1) / SHARD_COUNT)),
+    m_hits(0),
+    m_misses(0)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+PredictionCache::~PredictionCache()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Create a cache key from the pixels of a 28x28 image. The key holds every
+//  pixel exactly, so a cached prediction is only returned for an image 
+//  identical to the one predicted.
+//
+// PARAMETERS:
+//  image - 28x28 CV_8UC1 image
+//  key - reference to return the key
+//
+// RETURNS:
+//  true if a key was created (false if the image can't be cached)
+///////////////////////////////////////////////////////////////////////////////
+bool PredictionCache::MakeKey(const Mat &image, Key &key)
+{
+    if (image.type() != CV_8UC1 || image.cols != KEY_WIDTH || image.rows != KEY_HEIGHT)
+    {
+        return false;
+    }
+
+    key.fill(0);
+
+    uchar *bytes = reinterpret_cast<uchar*>(key.data());
+    for (int y = 0; y < image.rows; y++)
+    {
+        std::memcpy(bytes + y * KEY_WIDTH, image.ptr<uchar>(y), KEY_WIDTH);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Look up the prediction for a key and mark it most recently used
+//
+// PARAMETERS:
+//  key - cache key from MakeKey()
+//  modelVersion - version of the model making predictions (entries made by
+//                 other versions are ignored)
+//  prediction - reference to return the cached prediction
+//
+// RETURNS:
+//  true if the prediction was found
+///////////////////////////////////////////////////////////////////////////////
+bool PredictionCache::Lookup(const Key &key, std::uint64_t modelVersion, SvmModel::Prediction &prediction)
+{
+    const std::uint64_t hash = Hash(key);
+    Shard &shard = m_shards[hash % SHARD_COUNT];
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto found = shard.index.find(hash);
+        if (found != shard.index.end() && found->second->key == key &&
+            found->second->modelVersion == modelVersion)
+        {
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+            prediction = found->second->prediction;
+            m_hits++;
+            return true;
+        }
+    }
+
+    m_misses++;
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Add a prediction to the cache, evicting the least recently used entry of
+//  its shard if the shard is full
+//
+// PARAMETERS:
+//  key - cache key from MakeKey()
+//  modelVersion - version of the model that made the prediction
+//  prediction - prediction to cache
+///////////////////////////////////////////////////////////////////////////////
+void PredictionCache::Insert(const Key &key, std::uint64_t modelVersion, const SvmModel::Prediction &prediction)
+{
+    const std::uint64_t hash = Hash(key);
+    Shard &shard = m_shards[hash % SHARD_COUNT];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    //Replace an existing entry with the same hash
+    auto found = shard.index.find(hash);
+    if (found != shard.index.end())
+    {
+        found->second->key = key;
+        found->second->modelVersion = modelVersion;
+        found->second->prediction = prediction;
+        shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+        return;
+    }
+
+    if (shard.entries.size() >= m_shardCapacity)
+    {
+        shard.index.erase(Hash(shard.entries.back().key));
+        shard.entries.pop_back();
+    }
+
+    shard.entries.push_front({ key, modelVersion, prediction });
+    shard.index[hash] = shard.entries.begin();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Remove all entries and reset the hit statistics
+///////////////////////////////////////////////////////////////////////////////
+void PredictionCache::Clear()
+{
+    for (Shard &shard : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries.clear();
+        shard.index.clear();
+    }
+
+    m_hits = 0;
+    m_misses = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the maximum number of cached predictions
+//
+// RETURNS:
+//  Cache capacity
+///////////////////////////////////////////////////////////////////////////////
+size_t PredictionCache::GetCapacity() const
+{
+    return m_shardCapacity * SHARD_COUNT;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of cached predictions
+//
+// RETURNS:
+//  Number of entries in the cache
+///////////////////////////////////////////////////////////////////////////////
+size_t PredictionCache::GetSize() const
+{
+    size_t size = 0;
+    for (const Shard &shard : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        size += shard.entries.size();
+    }
+
+    return size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of lookups that found a prediction
+//
+// RETURNS:
+//  Number of cache hits
+///////////////////////////////////////////////////////////////////////////////
+size_t PredictionCache::GetHits() const
+{
+    return m_hits;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of lookups that did not find a prediction
+//
+// RETURNS:
+//  Number of cache misses
+///////////////////////////////////////////////////////////////////////////////
+size_t PredictionCache::GetMisses() const
+{
+    return m_misses;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the fraction of lookups that found a prediction
+//
+// RETURNS:
+//  Hit rate (0 to 1)
+///////////////////////////////////////////////////////////////////////////////
+double PredictionCache::GetHitRate() const
+{
+    const size_t hits = m_hits;
+    const size_t lookups = hits + m_misses;
+
+    return (lookups > 0) ? static_cast<double>(hits) / lookups : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Estimate the memory used by the cached entries, including list and hash
+//  table nodes and the vote and margin arrays of each prediction
+//
+// RETURNS:
+//  Approximate memory use in bytes
+///////////////////////////////////////////////////////////////////////////////
+size_t PredictionCache::GetMemoryUsage() const
+{
+    size_t bytes = sizeof(*this);
+    for (const Shard &shard : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        bytes += shard.index.bucket_count() * sizeof(void*);
+        for (const Entry &entry : shard.entries)
+        {
+            bytes += sizeof(Entry) + 2 * sizeof(void*);                                            //List node
+            bytes += sizeof(std::pair<std::uint64_t, std::list<Entry>::iterator>) + sizeof(void*); //Hash node
+            bytes += entry.prediction.votes.capacity() * sizeof(int);
+            bytes += entry.prediction.margins.capacity() * sizeof(float);
+        }
+    }
+
+    return bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Hash a cache key (64 bit multiply-xorshift mixing of each word)
+//
+// PARAMETERS:
+//  key - cache key
+//
+// RETURNS:
+//  Hash of the key
+///////////////////////////////////////////////////////////////////////////////
+std::uint64_t PredictionCache::Hash(const Key &key)
+{
+    std::uint64_t hash = 0x9E3779B97F4A7C15ULL;
+    for (std::uint64_t word : key)
+    {
+        hash ^= word + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+        hash *= 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 31;
+    }
+
+    return hash;
+}
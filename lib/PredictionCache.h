@@ -0,0 +1,108 @@
+/******************************************************************************
+
+    FILENAME:       PredictionCache.h
+
+    DESCRIPTION:    Bounded, thread safe least recently used cache of
+                    predictions keyed on the exact pixels of the 28x28 image
+                    the features are computed from.
+                    The cache is split into independently locked shards so
+                    concurrent predictions rarely contend.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+#include "SvmModel.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class PredictionCache
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Types
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    //The 8-bit pixels of a 28x28 image, 8 pixels per word
+    static const int KEY_WIDTH = 28;
+    static const int KEY_HEIGHT = 28;
+    typedef std::array<std::uint64_t, (KEY_WIDTH * KEY_HEIGHT + 7) / 8> Key;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    PredictionCache(size_t capacity);
+    virtual ~PredictionCache();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    static bool MakeKey(const cv::Mat &image, Key &key);
+
+    bool   Lookup(const Key &key, std::uint64_t modelVersion, SvmModel::Prediction &prediction);
+    void   Insert(const Key &key, std::uint64_t modelVersion, const SvmModel::Prediction &prediction);
+    void   Clear();
+
+    size_t GetCapacity() const;
+    size_t GetSize() const;
+    size_t GetHits() const;
+    size_t GetMisses() const;
+    double GetHitRate() const;
+    size_t GetMemoryUsage() const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Types
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    struct Entry
+    {
+        Key key;
+        std::uint64_t modelVersion;
+        SvmModel::Prediction prediction;
+    };
+
+    //Entries of a shard in most to least recently used order, indexed by hash
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    static std::uint64_t Hash(const Key &key);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    static const int SHARD_COUNT = 16;
+
+    size_t m_shardCapacity;
+    std::array<Shard, SHARD_COUNT> m_shards;
+
+    std::atomic<size_t> m_hits;
+    std::atomic<size_t> m_misses;
+
+};
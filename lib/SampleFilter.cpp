@@ -0,0 +1,272 @@
+/******************************************************************************
+
+    FILENAME:       SampleFilter.cpp
+
+    DESCRIPTION:    Removal of duplicate training samples. Exact duplicates
+                    are found by hashing the bits of the binarized images and
+                    near duplicates by locality sensitive hashing (random
+                    hyperplanes) of their HOG features, so neither needs a
+                    comparison of every pair of samples.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "SampleFilter.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+using namespace cv;
+
+//Most samples compared or stored per hash bucket, which bounds the time
+//spent on large groups of similar samples
+static const size_t MAX_BUCKET_SAMPLES = 256;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor
+///////////////////////////////////////////////////////////////////////////////
+SampleFilter::SampleFilter() :
+    m_tables(8),
+    m_bits(16),
+    m_nearDistance(0.05f)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+SampleFilter::~SampleFilter()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Remove the samples whose binarized image and label are the same as an
+//  earlier sample's
+//
+// PARAMETERS:
+//  images - packed binary images
+//  labels - label of each image
+//  keep - flag of each sample to keep (one per image); the flags of the
+//         duplicates of an earlier kept sample are cleared
+//
+// RETURNS:
+//  true if the samples were checked
+///////////////////////////////////////////////////////////////////////////////
+bool SampleFilter::RemoveExactDuplicates(const PackedImages &images, const Mat &labels,
+                                         std::vector<bool> &keep) const
+{
+    const int count = images.GetCount();
+    if (labels.rows != count || static_cast<int>(keep.size()) != count)
+    {
+        return false;
+    }
+
+    Mat intLabels;
+    labels.convertTo(intLabels, CV_32SC1);
+
+    //Kept samples by the hash of their bits (collisions are compared)
+    const size_t imageBytes = images.GetImageBytes();
+    std::unordered_map<uint64_t, std::vector<int>> kept;
+    for (int i = 0; i < count; i++)
+    {
+        if (keep[i] == false)
+        {
+            continue;
+        }
+
+        std::vector<int> &bucket = kept[Hash(images.GetBits(i), imageBytes)];
+        for (int j : bucket)
+        {
+            if (intLabels.at<int>(i, 0) == intLabels.at<int>(j, 0) &&
+                std::memcmp(images.GetBits(i), images.GetBits(j), imageBytes) == 0)
+            {
+                keep[i] = false;
+                break;
+            }
+        }
+
+        if (keep[i])
+        {
+            bucket.push_back(i);
+        }
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Remove the samples within the near duplicate distance of an earlier
+//  sample with the same label. Each table hashes the samples by the side of
+//  random hyperplanes (through the mean sample) they are on, so close
+//  samples are likely to share a bucket in at least one table; only samples
+//  sharing a bucket are compared.
+//
+// PARAMETERS:
+//  features - feature matrix (one sample per row)
+//  labels - label of each sample
+//  keep - flag of each sample to keep (one per row); the flags of the near
+//         duplicates of an earlier kept sample are cleared
+//
+// RETURNS:
+//  true if the samples were checked
+///////////////////////////////////////////////////////////////////////////////
+bool SampleFilter::RemoveNearDuplicates(const Mat &features, const Mat &labels, std::vector<bool> &keep) const
+{
+    if (labels.rows != features.rows || static_cast<int>(keep.size()) != features.rows)
+    {
+        return false;
+    }
+
+    Mat samples;
+    Mat intLabels;
+    features.convertTo(samples, CV_32FC1);
+    labels.convertTo(intLabels, CV_32SC1);
+
+    const int rows = samples.rows;
+    const int cols = samples.cols;
+
+    Mat mean;
+    reduce(samples, mean, 0, REDUCE_AVG, CV_32FC1);
+
+    Mat planes(m_tables * m_bits, cols, CV_32FC1);
+    RNG rng(0);
+    rng.fill(planes, RNG::NORMAL, 0, 1);
+
+    //Signature of each sample in each table, and its norm
+    std::vector<uint32_t> signatures(static_cast<size_t>(rows) * m_tables);
+    std::vector<float> norms(rows);
+    parallel_for_(Range(0, rows), [&](const Range &range)
+    {
+        std::vector<float> centered(cols);
+        for (int i = range.start; i < range.end; i++)
+        {
+            const float *sample = samples.ptr<float>(i);
+            for (int k = 0; k < cols; k++)
+            {
+                centered[k] = sample[k] - mean.at<float>(0, k);
+            }
+
+            for (int t = 0; t < m_tables; t++)
+            {
+                uint32_t signature = 0;
+                for (int b = 0; b < m_bits; b++)
+                {
+                    if (SimdKernels::DotProduct(planes.ptr<float>(t * m_bits + b), centered.data(), cols) > 0)
+                    {
+                        signature |= 1u << b;
+                    }
+                }
+                signatures[static_cast<size_t>(i) * m_tables + t] = signature;
+            }
+
+            norms[i] = static_cast<float>(std::sqrt(SimdKernels::DotProduct(sample, sample, cols)));
+        }
+    });
+
+    //Kept samples by table and signature
+    std::unordered_map<uint64_t, std::vector<int>> buckets;
+    for (int i = 0; i < rows; i++)
+    {
+        if (keep[i] == false)
+        {
+            continue;
+        }
+
+        for (int t = 0; t < m_tables && keep[i]; t++)
+        {
+            const uint64_t key = (static_cast<uint64_t>(t) << 32) | signatures[static_cast<size_t>(i) * m_tables + t];
+            auto bucket = buckets.find(key);
+            if (bucket == buckets.end())
+            {
+                continue;
+            }
+
+            for (int j : bucket->second)
+            {
+                const double maxDistance = 0.5 * m_nearDistance * (norms[i] + norms[j]);
+                if (intLabels.at<int>(i, 0) == intLabels.at<int>(j, 0) &&
+                    SimdKernels::SquaredDistance(samples.ptr<float>(i), samples.ptr<float>(j), cols) <=
+                    maxDistance * maxDistance)
+                {
+                    keep[i] = false;
+                    break;
+                }
+            }
+        }
+
+        if (keep[i])
+        {
+            for (int t = 0; t < m_tables; t++)
+            {
+                std::vector<int> &bucket = buckets[(static_cast<uint64_t>(t) << 32) |
+                                                   signatures[static_cast<size_t>(i) * m_tables + t]];
+                if (bucket.size() < MAX_BUCKET_SAMPLES)
+                {
+                    bucket.push_back(i);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the locality sensitive hashing parameters. More tables find more of
+//  the near duplicates, more bits per table compare fewer samples.
+//
+// PARAMETERS:
+//  tables - number of hash tables (default 8)
+//  bits - hyperplanes per table, from 1 to 32 (default 16)
+///////////////////////////////////////////////////////////////////////////////
+void SampleFilter::SetHashTables(int tables, int bits)
+{
+    m_tables = std::max(tables, 1);
+    m_bits = std::min(std::max(bits, 1), 32);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the largest distance between near duplicates
+//
+// PARAMETERS:
+//  distance - distance relative to the mean norm of the two samples
+//             (default 0.05)
+///////////////////////////////////////////////////////////////////////////////
+void SampleFilter::SetNearDistance(float distance)
+{
+    m_nearDistance = std::max(distance, 0.0f);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Hash a block of memory (64 bit FNV-1a)
+//
+// PARAMETERS:
+//  data - data to hash
+//  size - number of bytes
+//
+// RETURNS:
+//  Hash of the data
+///////////////////////////////////////////////////////////////////////////////
+uint64_t SampleFilter::Hash(const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+
+    FILENAME:       SampleFilter.h
+
+    DESCRIPTION:    Removal of duplicate training samples. Exact duplicates
+                    are found by hashing the bits of the binarized images and
+                    near duplicates by locality sensitive hashing (random
+                    hyperplanes) of their HOG features, so neither needs a
+                    comparison of every pair of samples.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+#include "PackedImages.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class SampleFilter
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    SampleFilter();
+    virtual ~SampleFilter();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    bool RemoveExactDuplicates(const PackedImages &images, const cv::Mat &labels, std::vector<bool> &keep) const;
+    bool RemoveNearDuplicates(const cv::Mat &features, const cv::Mat &labels, std::vector<bool> &keep) const;
+
+    void SetHashTables(int tables, int bits);
+    void SetNearDistance(float distance);
+
+    static uint64_t Hash(const void *data, size_t size);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    //Number of hash tables and hyperplanes (signature bits) per table
+    int m_tables;
+    int m_bits;
+
+    //Largest distance between near duplicates, relative to their mean norm
+    float m_nearDistance;
+
+};
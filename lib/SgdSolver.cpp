@@ -0,0 +1,246 @@
+/******************************************************************************
+
+    FILENAME:       SgdSolver.cpp
+
+    DESCRIPTION:    Out-of-core training of a one-vs-one linear SVM. The
+                    samples are streamed from a feature file a block at a
+                    time and every pair of classes takes stochastic gradient
+                    steps (Pegasos) on the block's samples of its classes, so
+                    memory only holds one block and the weight vectors.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "SgdSolver.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <random>
+
+using namespace cv;
+
+//Weight scale below which the scale is folded into the weights
+static const double MIN_SCALE = 1e-9;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor
+//
+// PARAMETERS:
+//  kernel - kernel function (must be linear)
+//  c - SVM regularization parameter C
+///////////////////////////////////////////////////////////////////////////////
+SgdSolver::SgdSolver(const SvmKernel &kernel, double c) :
+    m_kernel(kernel),
+    m_c(c),
+    m_epochs(5)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+SgdSolver::~SgdSolver()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the number of passes over the feature file
+//
+// PARAMETERS:
+//  epochs - number of epochs (default 5)
+///////////////////////////////////////////////////////////////////////////////
+void SgdSolver::SetEpochs(int epochs)
+{
+    m_epochs = std::max(epochs, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the one-vs-one decision functions from a feature file. Each epoch
+//  visits the blocks in a random order and the samples of each block in a
+//  random order; the pairs are updated in parallel. The weights are 
+//  averaged over the second half of the epochs, which is much less noisy
+//  than the last weights.
+//
+// PARAMETERS:
+//  file - open feature file
+//  model - reference to return the trained model (one weight vector per
+//          pair)
+//
+// RETURNS:
+//  true if the model was trained
+///////////////////////////////////////////////////////////////////////////////
+bool SgdSolver::Solve(const FeatureFile &file, SvmModel &model)
+{
+    if (file.IsOpen() == false || m_c <= 0 || m_kernel.GetType() != ml::SVM::LINEAR)
+    {
+        return false;
+    }
+
+    std::map<int, int> labelCounts;
+    file.CountLabels(labelCounts);
+    std::vector<int> classLabels;
+    std::vector<int> classCounts;
+    for (const auto &count : labelCounts)
+    {
+        classLabels.push_back(count.first);
+        classCounts.push_back(count.second);
+    }
+
+    const int classCount = static_cast<int>(classLabels.size());
+    if (classCount < 2)
+    {
+        return false;
+    }
+
+    const int cols = file.GetCols();
+    std::vector<Pair> pairs;
+    for (int i = 0; i < classCount; i++)
+    {
+        for (int j = i + 1; j < classCount; j++)
+        {
+            Pair pair;
+            pair.first = i;
+            pair.second = j;
+            pair.lambda = 1.0 / (m_c * (classCounts[i] + classCounts[j]));
+            pair.step = 0;
+            pair.scale = 1;
+            pair.weights.assign(cols + 1, 0.0f);
+            pair.sum.assign(cols + 1, 0.0);
+            pair.averaged = 0;
+            pairs.push_back(pair);
+        }
+    }
+
+    const int blockRows = file.GetBlockRows();
+    std::vector<int> blocks;
+    for (int start = 0; start < file.GetRows(); start += blockRows)
+    {
+        blocks.push_back(start);
+    }
+
+    std::mt19937 rng(0);
+    for (int epoch = 0; epoch < m_epochs; epoch++)
+    {
+        const bool average = (epoch >= m_epochs / 2);
+        std::shuffle(blocks.begin(), blocks.end(), rng);
+        for (int start : blocks)
+        {
+            Mat features;
+            Mat labels;
+            file.GetBlock(start, blockRows, features, labels);
+
+            std::vector<int> classIndex(labels.rows);
+            for (int i = 0; i < labels.rows; i++)
+            {
+                classIndex[i] = static_cast<int>(std::lower_bound(classLabels.begin(), classLabels.end(),
+                                                                  labels.at<int>(i, 0)) - classLabels.begin());
+            }
+
+            std::vector<int> order(labels.rows);
+            std::iota(order.begin(), order.end(), 0);
+            std::shuffle(order.begin(), order.end(), rng);
+
+            parallel_for_(Range(0, static_cast<int>(pairs.size())), [&](const Range &range)
+            {
+                for (int p = range.start; p < range.end; p++)
+                {
+                    for (int i : order)
+                    {
+                        if (classIndex[i] == pairs[p].first)
+                        {
+                            Step(pairs[p], features.ptr<float>(i), cols, 1.0, average);
+                        }
+                        else if (classIndex[i] == pairs[p].second)
+                        {
+                            Step(pairs[p], features.ptr<float>(i), cols, -1.0, average);
+                        }
+                    }
+                }
+            });
+
+            file.ReleaseBlock(start, blockRows);
+        }
+    }
+
+    //Each decision function is its weight vector with a coefficient of 1,
+    //as in a linear OpenCV model
+    const int pairCount = static_cast<int>(pairs.size());
+    Mat supportVectors(pairCount, cols, CV_32FC1);
+    std::vector<SvmModel::DecisionFunction> decisionFunctions(pairCount);
+    std::vector<double> alpha(pairCount, 1.0);
+    std::vector<int> index(pairCount);
+    for (int p = 0; p < pairCount; p++)
+    {
+        const double scale = 1.0 / std::max<long long>(pairs[p].averaged, 1);
+        float *weights = supportVectors.ptr<float>(p);
+        for (int k = 0; k < cols; k++)
+        {
+            weights[k] = static_cast<float>(scale * pairs[p].sum[k]);
+        }
+
+        decisionFunctions[p].rho = -scale * pairs[p].sum[cols];
+        decisionFunctions[p].offset = p;
+        decisionFunctions[p].count = 1;
+        index[p] = p;
+    }
+
+    return model.Create(m_kernel, supportVectors, decisionFunctions, alpha, index, classLabels);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Take a gradient step on a pair's regularized hinge loss for one sample.
+//  The weights shrink by scaling, so only margin violations touch the
+//  weight vector.
+//
+// PARAMETERS:
+//  pair - class pair
+//  sample - sample features
+//  cols - number of features
+//  y - +1 or -1 label of the sample in the pair
+//  average - true to add the new weights to the average
+///////////////////////////////////////////////////////////////////////////////
+void SgdSolver::Step(Pair &pair, const float *sample, int cols, double y, bool average) const
+{
+    pair.step++;
+    const double eta = 1.0 / (pair.lambda * pair.step);
+
+    //Shrink by (1 - eta * lambda)
+    pair.scale *= 1.0 - 1.0 / pair.step;
+    if (pair.scale < MIN_SCALE)
+    {
+        for (float &weight : pair.weights)
+        {
+            weight = static_cast<float>(weight * pair.scale);
+        }
+        pair.scale = 1;
+    }
+
+    float *weights = pair.weights.data();
+    const double margin = y * pair.scale * (SimdKernels::DotProduct(weights, sample, cols) + weights[cols]);
+    if (margin < 1)
+    {
+        const float update = static_cast<float>(eta * y / pair.scale);
+        for (int k = 0; k < cols; k++)
+        {
+            weights[k] += update * sample[k];
+        }
+        weights[cols] += update;
+    }
+
+    if (average)
+    {
+        for (int k = 0; k <= cols; k++)
+        {
+            pair.sum[k] += pair.scale * weights[k];
+        }
+        pair.averaged++;
+    }
+}
@@ -0,0 +1,81 @@
+/******************************************************************************
+
+    FILENAME:       SgdSolver.h
+
+    DESCRIPTION:    Out-of-core training of a one-vs-one linear SVM. The
+                    samples are streamed from a feature file a block at a
+                    time and every pair of classes takes stochastic gradient
+                    steps (Pegasos) on the block's samples of its classes, so
+                    memory only holds one block and the weight vectors.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+#include "FeatureFile.h"
+#include "SvmKernel.h"
+#include "SvmModel.h"
+
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class SgdSolver
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    SgdSolver(const SvmKernel &kernel, double c);
+    virtual ~SgdSolver();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    void SetEpochs(int epochs);
+    bool Solve(const FeatureFile &file, SvmModel &model);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Types
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    //Binary problem of one pair of classes. The weights are scale * weights,
+    //with the bias as the weight of a constant last feature. The model uses
+    //the average of the weights over the second half of the epochs.
+    struct Pair
+    {
+        int                 first;    //Class index labelled +1
+        int                 second;   //Class index labelled -1
+        double              lambda;   //Regularization (1 / (C * sample count))
+        long long           step;     //Gradient steps taken
+        double              scale;
+        std::vector<float>  weights;
+        std::vector<double> sum;      //Sum of the averaged weights
+        long long           averaged; //Number of weights summed
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    void Step(Pair &pair, const float *sample, int cols, double y, bool average) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    SvmKernel m_kernel;
+    double    m_c;
+    int       m_epochs;
+
+};
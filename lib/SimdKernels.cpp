@@ -0,0 +1,587 @@
+/******************************************************************************
+
+    FILENAME:       SimdKernels.cpp
+
+    DESCRIPTION:    Hot inner loops of prediction (support vector dot products
+                    and distances, sparse gathers and product quantization
+                    table lookups) built for several instruction sets. The
+                    best instruction set supported by the CPU is selected once
+                    at startup, so one binary runs well on SSE4.2, AVX2 and
+                    AVX-512 machines. HOG extraction and image preprocessing
+                    use OpenCV's own runtime dispatch.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "SimdKernels.h"
+#include "opencv2/opencv.hpp"
+
+#include <atomic>
+
+//Each variant is compiled for its instruction set with a target attribute
+//so the rest of the binary keeps the baseline instruction set
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET_SSE42  __attribute__((target("sse4.2")))
+#define SIMD_TARGET_AVX2   __attribute__((target("avx2,fma")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#else
+#define SIMD_TARGET_SSE42
+#define SIMD_TARGET_AVX2
+#define SIMD_TARGET_AVX512
+#endif
+#endif
+
+using namespace cv;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Scalar kernels (all CPUs)
+///////////////////////////////////////////////////////////////////////////////
+static double DotProductScalar(const float *a, const float *b, int count)
+{
+    double s = 0;
+    int k = 0;
+    for (; k <= count - 4; k += 4)
+    {
+        s += a[k] * b[k] + a[k + 1] * b[k + 1] +
+             a[k + 2] * b[k + 2] + a[k + 3] * b[k + 3];
+    }
+    for (; k < count; k++)
+    {
+        s += a[k] * b[k];
+    }
+
+    return s;
+}
+
+static double SquaredDistanceScalar(const float *a, const float *b, int count)
+{
+    double s = 0;
+    for (int k = 0; k < count; k++)
+    {
+        const double d = a[k] - b[k];
+        s += d * d;
+    }
+
+    return s;
+}
+
+static double SparseDotProductScalar(const float *values, const int *columns, int count, const float *sample)
+{
+    double s = 0;
+    for (int k = 0; k < count; k++)
+    {
+        s += values[k] * sample[columns[k]];
+    }
+
+    return s;
+}
+
+static float LookupSumScalar(const float *table, const unsigned char *codes, int count, int stride)
+{
+    float s = 0;
+    for (int m = 0; m < count; m++)
+    {
+        s += table[m * stride + codes[m]];
+    }
+
+    return s;
+}
+
+#if defined(SIMD_X86)
+///////////////////////////////////////////////////////////////////////////////
+// SSE4.2 kernels. Products are formed in single precision and accumulated
+// in double precision like the scalar kernels.
+///////////////////////////////////////////////////////////////////////////////
+SIMD_TARGET_SSE42 static double DotProductSse42(const float *a, const float *b, int count)
+{
+    __m128d sum0 = _mm_setzero_pd();
+    __m128d sum1 = _mm_setzero_pd();
+
+    int k = 0;
+    for (; k <= count - 4; k += 4)
+    {
+        const __m128 p = _mm_mul_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k));
+        sum0 = _mm_add_pd(sum0, _mm_cvtps_pd(p));
+        sum1 = _mm_add_pd(sum1, _mm_cvtps_pd(_mm_movehl_ps(p, p)));
+    }
+
+    sum0 = _mm_add_pd(sum0, sum1);
+    double s = _mm_cvtsd_f64(_mm_hadd_pd(sum0, sum0));
+    for (; k < count; k++)
+    {
+        s += a[k] * b[k];
+    }
+
+    return s;
+}
+
+SIMD_TARGET_SSE42 static double SquaredDistanceSse42(const float *a, const float *b, int count)
+{
+    __m128d sum0 = _mm_setzero_pd();
+    __m128d sum1 = _mm_setzero_pd();
+
+    int k = 0;
+    for (; k <= count - 4; k += 4)
+    {
+        const __m128 a4 = _mm_loadu_ps(a + k);
+        const __m128 b4 = _mm_loadu_ps(b + k);
+        const __m128d d0 = _mm_sub_pd(_mm_cvtps_pd(a4), _mm_cvtps_pd(b4));
+        const __m128d d1 = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(a4, a4)), _mm_cvtps_pd(_mm_movehl_ps(b4, b4)));
+        sum0 = _mm_add_pd(sum0, _mm_mul_pd(d0, d0));
+        sum1 = _mm_add_pd(sum1, _mm_mul_pd(d1, d1));
+    }
+
+    sum0 = _mm_add_pd(sum0, sum1);
+    double s = _mm_cvtsd_f64(_mm_hadd_pd(sum0, sum0));
+    for (; k < count; k++)
+    {
+        const double d = a[k] - b[k];
+        s += d * d;
+    }
+
+    return s;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX2 + FMA kernels
+///////////////////////////////////////////////////////////////////////////////
+SIMD_TARGET_AVX2 static double HorizontalSumAvx2(__m256d sum)
+{
+    const __m128d sum2 = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+    return _mm_cvtsd_f64(_mm_hadd_pd(sum2, sum2));
+}
+
+SIMD_TARGET_AVX2 static double DotProductAvx2(const float *a, const float *b, int count)
+{
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+
+    int k = 0;
+    for (; k <= count - 8; k += 8)
+    {
+        const __m256 p = _mm256_mul_ps(_mm256_loadu_ps(a + k), _mm256_loadu_ps(b + k));
+        sum0 = _mm256_add_pd(sum0, _mm256_cvtps_pd(_mm256_castps256_ps128(p)));
+        sum1 = _mm256_add_pd(sum1, _mm256_cvtps_pd(_mm256_extractf128_ps(p, 1)));
+    }
+
+    double s = HorizontalSumAvx2(_mm256_add_pd(sum0, sum1));
+    for (; k < count; k++)
+    {
+        s += a[k] * b[k];
+    }
+
+    return s;
+}
+
+SIMD_TARGET_AVX2 static double SquaredDistanceAvx2(const float *a, const float *b, int count)
+{
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+
+    int k = 0;
+    for (; k <= count - 8; k += 8)
+    {
+        const __m256 a8 = _mm256_loadu_ps(a + k);
+        const __m256 b8 = _mm256_loadu_ps(b + k);
+        const __m256d d0 = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(a8)),
+                                         _mm256_cvtps_pd(_mm256_castps256_ps128(b8)));
+        const __m256d d1 = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(a8, 1)),
+                                         _mm256_cvtps_pd(_mm256_extractf128_ps(b8, 1)));
+        sum0 = _mm256_fmadd_pd(d0, d0, sum0);
+        sum1 = _mm256_fmadd_pd(d1, d1, sum1);
+    }
+
+    double s = HorizontalSumAvx2(_mm256_add_pd(sum0, sum1));
+    for (; k < count; k++)
+    {
+        const double d = a[k] - b[k];
+        s += d * d;
+    }
+
+    return s;
+}
+
+SIMD_TARGET_AVX2 static double SparseDotProductAvx2(const float *values, const int *columns, int count, const float *sample)
+{
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+
+    //Gather the sample features for 8 non-zero values at a time
+    int k = 0;
+    for (; k <= count - 8; k += 8)
+    {
+        const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(columns + k));
+        const __m256 p = _mm256_mul_ps(_mm256_loadu_ps(values + k), _mm256_i32gather_ps(sample, index, 4));
+        sum0 = _mm256_add_pd(sum0, _mm256_cvtps_pd(_mm256_castps256_ps128(p)));
+        sum1 = _mm256_add_pd(sum1, _mm256_cvtps_pd(_mm256_extractf128_ps(p, 1)));
+    }
+
+    double s = HorizontalSumAvx2(_mm256_add_pd(sum0, sum1));
+    for (; k < count; k++)
+    {
+        s += values[k] * sample[columns[k]];
+    }
+
+    return s;
+}
+
+SIMD_TARGET_AVX2 static float LookupSumAvx2(const float *table, const unsigned char *codes, int count, int stride)
+{
+    //Table offset of each of 8 consecutive subspaces
+    const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+    __m256 sum = _mm256_setzero_ps();
+
+    int m = 0;
+    for (; m <= count - 8; m += 8)
+    {
+        const __m256i code = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(codes + m)));
+        const __m256i index = _mm256_add_epi32(code, offsets);
+        sum = _mm256_add_ps(sum, _mm256_i32gather_ps(table + m * stride, index, 4));
+    }
+
+    float partial[8];
+    _mm256_storeu_ps(partial, sum);
+    float s = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        s += partial[i];
+    }
+    for (; m < count; m++)
+    {
+        s += table[m * stride + codes[m]];
+    }
+
+    return s;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX-512 kernels
+///////////////////////////////////////////////////////////////////////////////
+SIMD_TARGET_AVX512 static double DotProductAvx512(const float *a, const float *b, int count)
+{
+    __m512d sum0 = _mm512_setzero_pd();
+    __m512d sum1 = _mm512_setzero_pd();
+
+    int k = 0;
+    for (; k <= count - 16; k += 16)
+    {
+        const __m512 p = _mm512_mul_ps(_mm512_loadu_ps(a + k), _mm512_loadu_ps(b + k));
+        const __m256 high = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(p), 1));
+        sum0 = _mm512_add_pd(sum0, _mm512_cvtps_pd(_mm512_castps512_ps256(p)));
+        sum1 = _mm512_add_pd(sum1, _mm512_cvtps_pd(high));
+    }
+
+    double s = _mm512_reduce_add_pd(_mm512_add_pd(sum0, sum1));
+    for (; k < count; k++)
+    {
+        s += a[k] * b[k];
+    }
+
+    return s;
+}
+
+SIMD_TARGET_AVX512 static double SquaredDistanceAvx512(const float *a, const float *b, int count)
+{
+    __m512d sum = _mm512_setzero_pd();
+
+    int k = 0;
+    for (; k <= count - 8; k += 8)
+    {
+        const __m512d d = _mm512_sub_pd(_mm512_cvtps_pd(_mm256_loadu_ps(a + k)),
+                                        _mm512_cvtps_pd(_mm256_loadu_ps(b + k)));
+        sum = _mm512_fmadd_pd(d, d, sum);
+    }
+
+    double s = _mm512_reduce_add_pd(sum);
+    for (; k < count; k++)
+    {
+        const double d = a[k] - b[k];
+        s += d * d;
+    }
+
+    return s;
+}
+
+SIMD_TARGET_AVX512 static double SparseDotProductAvx512(const float *values, const int *columns, int count, const float *sample)
+{
+    __m512d sum0 = _mm512_setzero_pd();
+    __m512d sum1 = _mm512_setzero_pd();
+
+    //Gather the sample features for 16 non-zero values at a time
+    int k = 0;
+    for (; k <= count - 16; k += 16)
+    {
+        const __m512i index = _mm512_loadu_si512(columns + k);
+        const __m512 p = _mm512_mul_ps(_mm512_loadu_ps(values + k), _mm512_i32gather_ps(index, sample, 4));
+        const __m256 high = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(p), 1));
+        sum0 = _mm512_add_pd(sum0, _mm512_cvtps_pd(_mm512_castps512_ps256(p)));
+        sum1 = _mm512_add_pd(sum1, _mm512_cvtps_pd(high));
+    }
+
+    double s = _mm512_reduce_add_pd(_mm512_add_pd(sum0, sum1));
+    for (; k < count; k++)
+    {
+        s += values[k] * sample[columns[k]];
+    }
+
+    return s;
+}
+
+SIMD_TARGET_AVX512 static float LookupSumAvx512(const float *table, const unsigned char *codes, int count, int stride)
+{
+    //Table offset of each of 16 consecutive subspaces
+    const __m512i offsets = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                               _mm512_set1_epi32(stride));
+    __m512 sum = _mm512_setzero_ps();
+
+    int m = 0;
+    for (; m <= count - 16; m += 16)
+    {
+        const __m512i code = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + m)));
+        const __m512i index = _mm512_add_epi32(code, offsets);
+        sum = _mm512_add_ps(sum, _mm512_i32gather_ps(index, table + m * stride, 4));
+    }
+
+    float s = _mm512_reduce_add_ps(sum);
+    for (; m < count; m++)
+    {
+        s += table[m * stride + codes[m]];
+    }
+
+    return s;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Kernel tables
+///////////////////////////////////////////////////////////////////////////////
+struct KernelTable
+{
+    double (*dotProduct)(const float *a, const float *b, int count);
+    double (*squaredDistance)(const float *a, const float *b, int count);
+    double (*sparseDotProduct)(const float *values, const int *columns, int count, const float *sample);
+    float  (*lookupSum)(const float *table, const unsigned char *codes, int count, int stride);
+};
+
+static const KernelTable s_kernels[SimdKernels::ISA_COUNT] =
+{
+    { DotProductScalar, SquaredDistanceScalar, SparseDotProductScalar, LookupSumScalar },
+#if defined(SIMD_X86)
+    { DotProductSse42, SquaredDistanceSse42, SparseDotProductScalar, LookupSumScalar },
+    { DotProductAvx2, SquaredDistanceAvx2, SparseDotProductAvx2, LookupSumAvx2 },
+    { DotProductAvx512, SquaredDistanceAvx512, SparseDotProductAvx512, LookupSumAvx512 },
+#else
+    { DotProductScalar, SquaredDistanceScalar, SparseDotProductScalar, LookupSumScalar },
+    { DotProductScalar, SquaredDistanceScalar, SparseDotProductScalar, LookupSumScalar },
+    { DotProductScalar, SquaredDistanceScalar, SparseDotProductScalar, LookupSumScalar },
+#endif
+};
+
+//Selected instruction set (-1 until the first kernel call or SetIsa())
+static std::atomic<int> s_isa(-1);
+
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the instruction set the kernels are using. The best supported
+//  instruction set is selected on first use unless SetIsa() was called.
+//
+// RETURNS:
+//  Current instruction set
+///////////////////////////////////////////////////////////////////////////////
+SimdKernels::Isa SimdKernels::GetIsa()
+{
+    int isa = s_isa.load(std::memory_order_relaxed);
+    if (isa < 0)
+    {
+        isa = GetBestIsa();
+        s_isa.store(isa, std::memory_order_relaxed);
+    }
+
+    return static_cast<Isa>(isa);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the best instruction set supported by the CPU and operating system
+//  (detected once with CPUID through OpenCV)
+//
+// RETURNS:
+//  Best supported instruction set
+///////////////////////////////////////////////////////////////////////////////
+SimdKernels::Isa SimdKernels::GetBestIsa()
+{
+    static const Isa bestIsa = []()
+    {
+#if defined(SIMD_X86)
+        const bool avx2 = checkHardwareSupport(CPU_AVX2) && checkHardwareSupport(CPU_FMA3);
+        if (avx2 && checkHardwareSupport(CPU_AVX_512F))
+        {
+            return ISA_AVX512;
+        }
+        if (avx2)
+        {
+            return ISA_AVX2;
+        }
+        if (checkHardwareSupport(CPU_SSE4_2))
+        {
+            return ISA_SSE42;
+        }
+#endif
+        return ISA_SCALAR;
+    }();
+
+    return bestIsa;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Force the kernels to use an instruction set (for testing and
+//  benchmarking). Only this file's kernels follow the exact instruction 
+//  set: OpenCV (HOG extraction and preprocessing) can't be capped at a 
+//  level at run time, so ISA_SCALAR turns its optimized code paths off and
+//  any other instruction set turns them on at OpenCV's own best level.
+//
+// PARAMETERS:
+//  isa - instruction set to use
+//
+// RETURNS:
+//  true if the instruction set is supported by the CPU
+///////////////////////////////////////////////////////////////////////////////
+bool SimdKernels::SetIsa(Isa isa)
+{
+    if (isa < ISA_SCALAR || isa > GetBestIsa())
+    {
+        return false;
+    }
+
+    s_isa.store(isa, std::memory_order_relaxed);
+    setUseOptimized(isa != ISA_SCALAR);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Parse an instruction set name (scalar, sse4.2, avx2 or avx512)
+//
+// PARAMETERS:
+//  name - instruction set name
+//  isa - reference to return the instruction set
+//
+// RETURNS:
+//  true if the name is valid
+///////////////////////////////////////////////////////////////////////////////
+bool SimdKernels::ParseIsa(const std::string &name, Isa &isa)
+{
+    for (int i = 0; i < ISA_COUNT; i++)
+    {
+        if (name == GetIsaName(static_cast<Isa>(i)))
+        {
+            isa = static_cast<Isa>(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the name of an instruction set
+//
+// PARAMETERS:
+//  isa - instruction set
+//
+// RETURNS:
+//  Instruction set name
+///////////////////////////////////////////////////////////////////////////////
+const char *SimdKernels::GetIsaName(Isa isa)
+{
+    switch (isa)
+    {
+    case ISA_SSE42:
+        return "sse4.2";
+    case ISA_AVX2:
+        return "avx2";
+    case ISA_AVX512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compute the dot product of two vectors
+//
+// PARAMETERS:
+//  a - first vector
+//  b - second vector
+//  count - number of elements
+//
+// RETURNS:
+//  Dot product (accumulated in double precision)
+///////////////////////////////////////////////////////////////////////////////
+double SimdKernels::DotProduct(const float *a, const float *b, int count)
+{
+    return s_kernels[GetIsa()].dotProduct(a, b, count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compute the squared Euclidean distance between two vectors
+//
+// PARAMETERS:
+//  a - first vector
+//  b - second vector
+//  count - number of elements
+//
+// RETURNS:
+//  Squared distance (accumulated in double precision)
+///////////////////////////////////////////////////////////////////////////////
+double SimdKernels::SquaredDistance(const float *a, const float *b, int count)
+{
+    return s_kernels[GetIsa()].squaredDistance(a, b, count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compute the dot product of a sparse vector and a dense sample
+//
+// PARAMETERS:
+//  values - non-zero values of the sparse vector
+//  columns - column of each non-zero value
+//  count - number of non-zero values
+//  sample - dense sample
+//
+// RETURNS:
+//  Dot product (accumulated in double precision)
+///////////////////////////////////////////////////////////////////////////////
+double SimdKernels::SparseDotProduct(const float *values, const int *columns, int count, const float *sample)
+{
+    return s_kernels[GetIsa()].sparseDotProduct(values, columns, count, sample);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Sum one table entry per subspace, table[m * stride + codes[m]], as used
+//  by product quantized dot products
+//
+// PARAMETERS:
+//  table - lookup table (count * stride entries)
+//  codes - code of each subspace
+//  count - number of subspaces
+//  stride - table entries per subspace
+//
+// RETURNS:
+//  Sum of the table entries
+///////////////////////////////////////////////////////////////////////////////
+float SimdKernels::LookupSum(const float *table, const unsigned char *codes, int count, int stride)
+{
+    return s_kernels[GetIsa()].lookupSum(table, codes, count, stride);
+}
@@ -0,0 +1,60 @@
+/******************************************************************************
+
+    FILENAME:       SimdKernels.h
+
+    DESCRIPTION:    Hot inner loops of prediction (support vector dot products
+                    and distances, sparse gathers and product quantization
+                    table lookups) built for several instruction sets. The
+                    best instruction set supported by the CPU is selected once
+                    at startup, so one binary runs well on SSE4.2, AVX2 and
+                    AVX-512 machines. HOG extraction and image preprocessing
+                    use OpenCV's own runtime dispatch.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include <string>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class SimdKernels
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Types
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    //Instruction set levels, each including the ones before it
+    enum Isa
+    {
+        ISA_SCALAR,
+        ISA_SSE42,
+        ISA_AVX2,       //AVX2 + FMA
+        ISA_AVX512,     //AVX-512F
+        ISA_COUNT
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    static Isa  GetIsa();
+    static Isa  GetBestIsa();
+    static bool SetIsa(Isa isa);
+    static bool ParseIsa(const std::string &name, Isa &isa);
+    static const char *GetIsaName(Isa isa);
+
+    static double DotProduct(const float *a, const float *b, int count);
+    static double SquaredDistance(const float *a, const float *b, int count);
+    static double SparseDotProduct(const float *values, const int *columns, int count, const float *sample);
+    static float  LookupSum(const float *table, const unsigned char *codes, int count, int stride);
+
+};
@@ -0,0 +1,1081 @@
+/******************************************************************************
+
+    FILENAME:       SmoSolver.cpp
+
+    DESCRIPTION:    Sequential minimal optimization (SMO) training of a
+                    one-vs-one C-SVC. The working pair of each iteration is
+                    chosen with second order information, samples stuck at a
+                    bound are shrunk out of the active set, and kernel rows
+                    are computed in parallel (with the SIMD kernels) into an
+                    LRU cache of a configurable size. Feature files too large
+                    for memory are trained in chunks of the samples
+                    violating the margin of the current solution.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "SmoSolver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <random>
+
+using namespace cv;
+
+//Bound status of an alpha
+enum
+{
+    LOWER_BOUND,
+    UPPER_BOUND,
+    FREE
+};
+
+//Floor of the curvature along the working pair direction
+static const double TAU = 1e-12;
+
+//Kernel rows with less work (entries x features) are computed on one thread
+static const double PARALLEL_ROW_WORK = 65536;
+
+//Iterations between shrinking the active set
+static const int SHRINK_INTERVAL = 1000;
+
+//Maximum solves of the working set when training from a feature file
+static const int MAX_CHUNK_PASSES = 20;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor
+//
+// PARAMETERS:
+//  kernel - kernel function
+//  c - SVM regularization parameter C
+//  termCriteria - stopping tolerance on the KKT violation (EPS) and maximum
+//                 number of iterations per class pair (COUNT)
+///////////////////////////////////////////////////////////////////////////////
+SmoSolver::SmoSolver(const SvmKernel &kernel, double c, const TermCriteria &termCriteria) :
+    m_kernel(kernel),
+    m_c(c),
+    m_eps(((termCriteria.type & TermCriteria::EPS) != 0) ? termCriteria.epsilon : 1e-3),
+    m_maxIterations(((termCriteria.type & TermCriteria::COUNT) != 0) ? termCriteria.maxCount :
+                    std::numeric_limits<int>::max()),
+    m_cacheBytes(256 << 20),
+    m_shrinking(true),
+    m_unshrink(false),
+    m_maxRows(0),
+    m_epoch(0)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+SmoSolver::~SmoSolver()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the memory of the kernel row cache. At least two rows are always
+//  cached.
+//
+// PARAMETERS:
+//  megabytes - cache size in megabytes (default 256)
+///////////////////////////////////////////////////////////////////////////////
+void SmoSolver::SetCacheSize(int megabytes)
+{
+    m_cacheBytes = static_cast<size_t>(std::max(megabytes, 0)) << 20;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Enable or disable shrinking of the samples at a bound
+//
+// PARAMETERS:
+//  shrinking - true to shrink (default)
+///////////////////////////////////////////////////////////////////////////////
+void SmoSolver::SetShrinking(bool shrinking)
+{
+    m_shrinking = shrinking;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the one-vs-one decision functions. The pairs are solved one after
+//  another, each using all threads to compute its kernel rows.
+//
+// PARAMETERS:
+//  features - feature matrix (one CV_32FC1 sample per row)
+//  labels - label matrix (one CV_32SC1 label per row)
+//  classLabels - sorted class labels
+//  model - reference to return the trained model
+//
+// RETURNS:
+//  true if the model was trained
+///////////////////////////////////////////////////////////////////////////////
+bool SmoSolver::Solve(const Mat &features, const Mat &labels, const std::vector<int> &classLabels,
+                      SvmModel &model)
+{
+    const int classCount = static_cast<int>(classLabels.size());
+    if (m_c <= 0 || m_kernel.IsSupported() == false || classCount < 2 ||
+        features.type() != CV_32FC1 || labels.type() != CV_32SC1 || features.rows != labels.rows)
+    {
+        return false;
+    }
+
+    SolvePairs(features, labels, nullptr, classLabels);
+    return BuildModel(features, classLabels, model);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the one-vs-one decision functions on a subset of the rows of a 
+//  feature matrix. The rows are used in place, so several solvers can train
+//  on different subsets of one matrix (e.g. cross-validation folds) without
+//  copying it; only the support vectors are copied into the model.
+//
+// PARAMETERS:
+//  features - feature matrix (one CV_32FC1 sample per row)
+//  labels - label matrix (one CV_32SC1 label per row)
+//  rows - rows of the samples to train on
+//  classLabels - sorted class labels of the samples in rows
+//  model - reference to return the trained model
+//
+// RETURNS:
+//  true if the model was trained
+///////////////////////////////////////////////////////////////////////////////
+bool SmoSolver::Solve(const Mat &features, const Mat &labels, const std::vector<int> &rows,
+                      const std::vector<int> &classLabels, SvmModel &model)
+{
+    const int classCount = static_cast<int>(classLabels.size());
+    if (m_c <= 0 || m_kernel.IsSupported() == false || classCount < 2 ||
+        features.type() != CV_32FC1 || labels.type() != CV_32SC1 || features.rows != labels.rows)
+    {
+        return false;
+    }
+
+    for (int row : rows)
+    {
+        if (row < 0 || row >= features.rows || 
+            std::binary_search(classLabels.begin(), classLabels.end(), labels.at<int>(row, 0)) == false)
+        {
+            return false;
+        }
+    }
+
+    SolvePairs(features, labels, &rows, classLabels);
+    return BuildModel(features, classLabels, model);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the one-vs-one decision functions from a feature file too large to
+//  hold in memory. A working set, starting with an even spread of the
+//  samples, is solved in memory; the file is then streamed a block at a
+//  time and a chunk of the samples violating the margin is added to the
+//  support vectors for the next solve, until no sample violates it.
+//  Memory holds the support vectors, one chunk of new samples and one block
+//  of the file.
+//
+// PARAMETERS:
+//  file - open feature file
+//  chunkSize - maximum number of samples added to the working set per pass
+//  model - reference to return the trained model
+//
+// RETURNS:
+//  true if the model was trained
+///////////////////////////////////////////////////////////////////////////////
+bool SmoSolver::Solve(const FeatureFile &file, int chunkSize, SvmModel &model)
+{
+    if (file.IsOpen() == false || chunkSize <= 0 || m_c <= 0 || m_kernel.IsSupported() == false)
+    {
+        return false;
+    }
+
+    std::map<int, int> labelCounts;
+    file.CountLabels(labelCounts);
+    std::vector<int> classLabels;
+    for (const auto &count : labelCounts)
+    {
+        classLabels.push_back(count.first);
+    }
+
+    if (classLabels.size() < 2)
+    {
+        return false;
+    }
+
+    //Start with an even spread of the samples
+    const int rows = file.GetRows();
+    const int initialCount = std::min(chunkSize, rows);
+    std::vector<int> added;
+    for (int k = 0; k < initialCount; k++)
+    {
+        added.push_back(static_cast<int>(static_cast<long long>(k) * rows / initialCount));
+    }
+
+    Mat workingSet(0, file.GetCols(), CV_32FC1);
+    Mat workingLabels(0, 1, CV_32SC1);
+    std::vector<int> workingRows;
+    for (int pass = 0; pass < MAX_CHUNK_PASSES && added.empty() == false; pass++)
+    {
+        for (int row : added)
+        {
+            Mat features;
+            Mat labels;
+            file.GetBlock(row, 1, features, labels);
+            workingSet.push_back(features);
+            workingLabels.push_back(labels);
+            workingRows.push_back(row);
+            file.ReleaseBlock(row, 1);
+        }
+
+        SolvePairs(workingSet, workingLabels, nullptr, classLabels);
+        KeepSupportVectors(workingSet, workingLabels, workingRows);
+        FindViolators(file, workingSet, workingRows, classLabels, chunkSize, added);
+    }
+
+    return BuildModel(workingSet, classLabels, model);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Solve the binary problem of each pair in decision function order,
+//  keeping the samples with a nonzero alpha as the pair's support vectors
+//
+// PARAMETERS:
+//  features - feature matrix (one CV_32FC1 sample per row)
+//  labels - label matrix (one CV_32SC1 label per row)
+//  rows - rows to train on (null for all rows)
+//  classLabels - sorted class labels
+///////////////////////////////////////////////////////////////////////////////
+void SmoSolver::SolvePairs(const Mat &features, const Mat &labels, const std::vector<int> *rows,
+                           const std::vector<int> &classLabels)
+{
+    const int classCount = static_cast<int>(classLabels.size());
+    m_features = features;
+
+    std::vector<std::vector<int>> classSamples(classCount);
+    const int count = rows ? static_cast<int>(rows->size()) : features.rows;
+    for (int k = 0; k < count; k++)
+    {
+        const int i = rows ? (*rows)[k] : k;
+        const int label = labels.at<int>(i, 0);
+        const int classIndex = static_cast<int>(std::lower_bound(classLabels.begin(), classLabels.end(), label) -
+                                                classLabels.begin());
+        classSamples[classIndex].push_back(i);
+    }
+
+    m_pairSvs.clear();
+    m_pairCoefs.clear();
+    m_pairRho.clear();
+    for (int i = 0; i < classCount; i++)
+    {
+        for (int j = i + 1; j < classCount; j++)
+        {
+            std::vector<int> samples = classSamples[i];
+            samples.insert(samples.end(), classSamples[j].begin(), classSamples[j].end());
+            std::vector<signed char> y(samples.size(), -1);
+            std::fill(y.begin(), y.begin() + classSamples[i].size(), 1);
+
+            std::vector<double> alpha;
+            double rho = 0;
+            SolvePair(samples, y, alpha, rho);
+
+            m_pairSvs.emplace_back();
+            m_pairCoefs.emplace_back();
+            m_pairRho.push_back(rho);
+            for (size_t k = 0; k < samples.size(); k++)
+            {
+                if (alpha[k] > 0)
+                {
+                    m_pairSvs.back().push_back(samples[k]);
+                    m_pairCoefs.back().push_back(alpha[k] * y[k]);
+                }
+            }
+        }
+    }
+
+    m_features.release();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Create the model from the support vectors of the pairs
+//
+// PARAMETERS:
+//  features - feature matrix the pairs were solved on
+//  classLabels - sorted class labels
+//  model - reference to return the model
+//
+// RETURNS:
+//  true if the model was created
+///////////////////////////////////////////////////////////////////////////////
+bool SmoSolver::BuildModel(const Mat &features, const std::vector<int> &classLabels, SvmModel &model) const
+{
+    //Gather the distinct support vectors of all pairs
+    std::map<int, int> svIndex;
+    for (const std::vector<int> &svs : m_pairSvs)
+    {
+        for (int sample : svs)
+        {
+            svIndex.emplace(sample, 0);
+        }
+    }
+
+    Mat supportVectors(static_cast<int>(svIndex.size()), features.cols, CV_32FC1);
+    int row = 0;
+    for (auto &sv : svIndex)
+    {
+        sv.second = row;
+        features.row(sv.first).copyTo(supportVectors.row(row));
+        row++;
+    }
+
+    std::vector<SvmModel::DecisionFunction> decisionFunctions;
+    std::vector<double> alpha;
+    std::vector<int> index;
+    for (size_t p = 0; p < m_pairSvs.size(); p++)
+    {
+        SvmModel::DecisionFunction df;
+        df.rho = m_pairRho[p];
+        df.offset = static_cast<int>(alpha.size());
+        df.count = static_cast<int>(m_pairSvs[p].size());
+        for (size_t k = 0; k < m_pairSvs[p].size(); k++)
+        {
+            alpha.push_back(m_pairCoefs[p][k]);
+            index.push_back(svIndex.at(m_pairSvs[p][k]));
+        }
+
+        decisionFunctions.push_back(df);
+    }
+
+    return model.Create(m_kernel, supportVectors, decisionFunctions, alpha, index, classLabels);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Drop the samples of the working set that are not support vectors of any
+//  pair
+//
+// PARAMETERS:
+//  features - working set features, compacted in place
+//  labels - working set labels, compacted in place
+//  rows - feature file row of each working set sample, compacted in place
+///////////////////////////////////////////////////////////////////////////////
+void SmoSolver::KeepSupportVectors(Mat &features, Mat &labels, std::vector<int> &rows)
+{
+    std::vector<int> newIndex(features.rows, -1);
+    for (const std::vector<int> &svs : m_pairSvs)
+    {
+        for (int sample : svs)
+        {
+            newIndex[sample] = 0;
+        }
+    }
+
+    Mat keptFeatures(0, features.cols, CV_32FC1);
+    Mat keptLabels(0, 1, CV_32SC1);
+    std::vector<int> keptRows;
+    for (int i = 0; i < features.rows; i++)
+    {
+        if (newIndex[i] == 0)
+        {
+            newIndex[i] = keptFeatures.rows;
+            keptFeatures.push_back(features.row(i));
+            keptLabels.push_back(labels.row(i));
+            keptRows.push_back(rows[i]);
+        }
+    }
+
+    for (std::vector<int> &svs : m_pairSvs)
+    {
+        for (int &sample : svs)
+        {
+            sample = newIndex[sample];
+        }
+    }
+
+    features = keptFeatures;
+    labels = keptLabels;
+    rows = keptRows;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Stream the feature file and pick samples outside the working set that 
+//  violate the margin of a pair of their class
+//
+// PARAMETERS:
+//  file - open feature file
+//  workingSet - support vectors of the pairs
+//  workingRows - feature file row of each support vector
+//  classLabels - sorted class labels
+//  maxCount - maximum number of samples to return
+//  violators - reference to return the sorted rows of the samples found
+///////////////////////////////////////////////////////////////////////////////
+void SmoSolver::FindViolators(const FeatureFile &file, const Mat &workingSet, const std::vector<int> &workingRows,
+                              const std::vector<int> &classLabels, int maxCount, std::vector<int> &violators) const
+{
+    const int classCount = static_cast<int>(classLabels.size());
+    std::vector<int> sortedRows = workingRows;
+    std::sort(sortedRows.begin(), sortedRows.end());
+
+    //Uniform sample of the violators (reservoir sampling). Taking only the
+    //largest violations would fill the chunk with outliers.
+    std::mt19937 rng(static_cast<unsigned int>(workingRows.size()));
+    long long violatorCount = 0;
+    violators.clear();
+
+    const int blockRows = file.GetBlockRows();
+    for (int start = 0; start < file.GetRows(); start += blockRows)
+    {
+        Mat features;
+        Mat labels;
+        file.GetBlock(start, blockRows, features, labels);
+
+        //Margin violation, 1 - y * f, of the worst pair of each sample's class
+        std::vector<double> violation(features.rows, 0);
+        parallel_for_(Range(0, features.rows), [&](const Range &range)
+        {
+            std::vector<double> kernel(workingSet.rows);
+            for (int s = range.start; s < range.end; s++)
+            {
+                const float *sample = features.ptr<float>(s);
+                for (int k = 0; k < workingSet.rows; k++)
+                {
+                    kernel[k] = m_kernel.Evaluate(workingSet.ptr<float>(k), sample, features.cols);
+                }
+
+                const int c = static_cast<int>(std::lower_bound(classLabels.begin(), classLabels.end(),
+                                                                labels.at<int>(s, 0)) - classLabels.begin());
+                int p = 0;
+                for (int i = 0; i < classCount; i++)
+                {
+                    for (int j = i + 1; j < classCount; j++, p++)
+                    {
+                        if (i != c && j != c)
+                        {
+                            continue;
+                        }
+
+                        double f = -m_pairRho[p];
+                        for (size_t k = 0; k < m_pairSvs[p].size(); k++)
+                        {
+                            f += m_pairCoefs[p][k] * kernel[m_pairSvs[p][k]];
+                        }
+                        const double y = (i == c) ? 1.0 : -1.0;
+                        violation[s] = std::max(violation[s], 1 - y * f);
+                    }
+                }
+            }
+        });
+
+        for (int s = 0; s < features.rows; s++)
+        {
+            const int row = start + s;
+            if (violation[s] <= m_eps || std::binary_search(sortedRows.begin(), sortedRows.end(), row))
+            {
+                continue;
+            }
+
+            violatorCount++;
+            if (static_cast<int>(violators.size()) < maxCount)
+            {
+                violators.push_back(row);
+            }
+            else
+            {
+                const long long k = std::uniform_int_distribution<long long>(0, violatorCount - 1)(rng);
+                if (k < maxCount)
+                {
+                    violators[static_cast<size_t>(k)] = row;
+                }
+            }
+        }
+
+        file.ReleaseBlock(start, blockRows);
+    }
+
+    std::sort(violators.begin(), violators.end());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Solve the dual of a binary C-SVC, min 0.5 a'Qa - sum(a) subject to
+//  y'a = 0 and 0 <= a <= C, by updating two alphas per iteration
+//
+// PARAMETERS:
+//  samples - feature row of each sample of the pair
+//  y - +1 or -1 label of each sample
+//  alpha - reference to return the alpha of each sample
+//  rho - reference to return the bias (decision value is sum(a y K) - rho)
+///////////////////////////////////////////////////////////////////////////////
+void SmoSolver::SolvePair(const std::vector<int> &samples, const std::vector<signed char> &y,
+                          std::vector<double> &alpha, double &rho)
+{
+    const int count = static_cast<int>(samples.size());
+    m_samples = samples;
+    m_y = y;
+    m_alpha.assign(count, 0);
+    m_gradient.assign(count, -1);
+    m_gradientBar.assign(count, 0);
+    m_status.assign(count, LOWER_BOUND);
+    m_diagonal.resize(count);
+    m_active.resize(count);
+    m_unshrink = false;
+    for (int i = 0; i < count; i++)
+    {
+        const float *x = m_features.ptr<float>(samples[i]);
+        m_diagonal[i] = m_kernel.Evaluate(x, x, m_features.cols);
+        m_active[i] = i;
+    }
+
+    //Size the cache for rows of this pair
+    const size_t rowBytes = std::max<size_t>(count, 1) * sizeof(float);
+    m_maxRows = std::max<size_t>(std::min<size_t>(m_cacheBytes / rowBytes, count), 2);
+    m_rows.clear();
+    m_rows.reserve(m_maxRows);
+    m_lru.clear();
+    m_rowOf.assign(count, -1);
+    m_epoch = 0;
+
+    int counter = std::min(count, SHRINK_INTERVAL) + 1;
+    for (int iteration = 0; iteration < m_maxIterations; iteration++)
+    {
+        //Periodically drop the samples likely to stay at their bound
+        if (--counter == 0)
+        {
+            counter = std::min(count, SHRINK_INTERVAL);
+            if (m_shrinking)
+            {
+                Shrink();
+            }
+        }
+
+        int i = 0;
+        int j = 0;
+        if (SelectWorkingSet(i, j) == false)
+        {
+            //Optimal on the active set, so check the shrunk samples too
+            ReconstructGradient();
+            if (SelectWorkingSet(i, j) == false)
+            {
+                break;
+            }
+            counter = 1;
+        }
+
+        const float *rowI = GetRow(i, false);
+        const float *rowJ = GetRow(j, false);
+        const double oldAlphaI = m_alpha[i];
+        const double oldAlphaJ = m_alpha[j];
+
+        //Minimize along the direction keeping y'a constant, then clip the
+        //pair to the box
+        if (m_y[i] != m_y[j])
+        {
+            const double quad = std::max(m_diagonal[i] + m_diagonal[j] + 2 * rowI[j], TAU);
+            const double delta = (-m_gradient[i] - m_gradient[j]) / quad;
+            const double diff = m_alpha[i] - m_alpha[j];
+            m_alpha[i] += delta;
+            m_alpha[j] += delta;
+
+            if (diff > 0)
+            {
+                if (m_alpha[j] < 0)
+                {
+                    m_alpha[j] = 0;
+                    m_alpha[i] = diff;
+                }
+            }
+            else if (m_alpha[i] < 0)
+            {
+                m_alpha[i] = 0;
+                m_alpha[j] = -diff;
+            }
+
+            if (diff > 0)
+            {
+                if (m_alpha[i] > m_c)
+                {
+                    m_alpha[i] = m_c;
+                    m_alpha[j] = m_c - diff;
+                }
+            }
+            else if (m_alpha[j] > m_c)
+            {
+                m_alpha[j] = m_c;
+                m_alpha[i] = m_c + diff;
+            }
+        }
+        else
+        {
+            const double quad = std::max(m_diagonal[i] + m_diagonal[j] - 2 * rowI[j], TAU);
+            const double delta = (m_gradient[i] - m_gradient[j]) / quad;
+            const double sum = m_alpha[i] + m_alpha[j];
+            m_alpha[i] -= delta;
+            m_alpha[j] += delta;
+
+            if (sum > m_c)
+            {
+                if (m_alpha[i] > m_c)
+                {
+                    m_alpha[i] = m_c;
+                    m_alpha[j] = sum - m_c;
+                }
+                if (m_alpha[j] > m_c)
+                {
+                    m_alpha[j] = m_c;
+                    m_alpha[i] = sum - m_c;
+                }
+            }
+            else
+            {
+                if (m_alpha[j] < 0)
+                {
+                    m_alpha[j] = 0;
+                    m_alpha[i] = sum;
+                }
+                if (m_alpha[i] < 0)
+                {
+                    m_alpha[i] = 0;
+                    m_alpha[j] = sum;
+                }
+            }
+        }
+
+        //Update the gradient of the active samples
+        const double deltaI = m_alpha[i] - oldAlphaI;
+        const double deltaJ = m_alpha[j] - oldAlphaJ;
+        for (int k : m_active)
+        {
+            m_gradient[k] += rowI[k] * deltaI + rowJ[k] * deltaJ;
+        }
+
+        //Keep the gradient part of the alphas at C for reconstruction
+        const bool wasUpperI = IsUpperBound(i);
+        const bool wasUpperJ = IsUpperBound(j);
+        UpdateStatus(i);
+        UpdateStatus(j);
+        const int pair[2] = { i, j };
+        const bool wasUpper[2] = { wasUpperI, wasUpperJ };
+        for (int p = 0; p < 2; p++)
+        {
+            if (wasUpper[p] != IsUpperBound(pair[p]))
+            {
+                const float *row = GetRow(pair[p], true);
+                const double scale = wasUpper[p] ? -m_c : m_c;
+                for (int k = 0; k < count; k++)
+                {
+                    m_gradientBar[k] += scale * row[k];
+                }
+            }
+        }
+    }
+
+    if (static_cast<int>(m_active.size()) < count)
+    {
+        ReconstructGradient();
+    }
+
+    rho = CalculateRho();
+    alpha = m_alpha;
+
+    m_rows.clear();
+    m_lru.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Select the working pair: i is the active sample violating the optimality
+//  conditions the most, and j is the sample giving the largest decrease of
+//  the objective with i (second order working set selection)
+//
+// PARAMETERS:
+//  outI - reference to return the first sample
+//  outJ - reference to return the second sample
+//
+// RETURNS:
+//  true if a pair was selected, false if the active set is optimal
+///////////////////////////////////////////////////////////////////////////////
+bool SmoSolver::SelectWorkingSet(int &outI, int &outJ)
+{
+    //Largest -y*grad over the alphas that can move up
+    double gmax = -std::numeric_limits<double>::infinity();
+    int gmaxIndex = -1;
+    for (int t : m_active)
+    {
+        if (m_y[t] == 1)
+        {
+            if (IsUpperBound(t) == false && -m_gradient[t] >= gmax)
+            {
+                gmax = -m_gradient[t];
+                gmaxIndex = t;
+            }
+        }
+        else if (IsLowerBound(t) == false && m_gradient[t] >= gmax)
+        {
+            gmax = m_gradient[t];
+            gmaxIndex = t;
+        }
+    }
+
+    if (gmaxIndex < 0)
+    {
+        return false;
+    }
+
+    const int i = gmaxIndex;
+    const float *rowI = GetRow(i, false);
+
+    //Smallest objective change over the alphas that can move down
+    double gmax2 = -std::numeric_limits<double>::infinity();
+    double minObjective = std::numeric_limits<double>::infinity();
+    int gminIndex = -1;
+    for (int j : m_active)
+    {
+        double gradDiff = 0;
+        double quad = 0;
+        if (m_y[j] == 1)
+        {
+            if (IsLowerBound(j))
+            {
+                continue;
+            }
+            gmax2 = std::max(gmax2, m_gradient[j]);
+            gradDiff = gmax + m_gradient[j];
+            quad = m_diagonal[i] + m_diagonal[j] - 2.0 * m_y[i] * rowI[j];
+        }
+        else
+        {
+            if (IsUpperBound(j))
+            {
+                continue;
+            }
+            gmax2 = std::max(gmax2, -m_gradient[j]);
+            gradDiff = gmax - m_gradient[j];
+            quad = m_diagonal[i] + m_diagonal[j] + 2.0 * m_y[i] * rowI[j];
+        }
+
+        if (gradDiff > 0)
+        {
+            const double objective = -(gradDiff * gradDiff) / std::max(quad, TAU);
+            if (objective <= minObjective)
+            {
+                gminIndex = j;
+                minObjective = objective;
+            }
+        }
+    }
+
+    if (gmax + gmax2 < m_eps || gminIndex < 0)
+    {
+        return false;
+    }
+
+    outI = i;
+    outJ = gminIndex;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Remove the samples at a bound whose gradient shows they will stay there
+//  from the active set. Once the violation is close to the tolerance the
+//  gradient is reconstructed and all samples are reconsidered once.
+///////////////////////////////////////////////////////////////////////////////
+void SmoSolver::Shrink()
+{
+    double gmax1 = -std::numeric_limits<double>::infinity();
+    double gmax2 = -std::numeric_limits<double>::infinity();
+    for (int i : m_active)
+    {
+        const double g = m_y[i] * m_gradient[i];
+        if (m_y[i] == 1)
+        {
+            if (IsUpperBound(i) == false)
+            {
+                gmax1 = std::max(gmax1, -g);
+            }
+            if (IsLowerBound(i) == false)
+            {
+                gmax2 = std::max(gmax2, g);
+            }
+        }
+        else
+        {
+            if (IsUpperBound(i) == false)
+            {
+                gmax2 = std::max(gmax2, g);
+            }
+            if (IsLowerBound(i) == false)
+            {
+                gmax1 = std::max(gmax1, -g);
+            }
+        }
+    }
+
+    if (m_unshrink == false && gmax1 + gmax2 <= m_eps * 10)
+    {
+        m_unshrink = true;
+        ReconstructGradient();
+    }
+
+    //In terms of y*grad: an alpha at C stays there if moving it would
+    //increase the objective by more than the largest violation
+    auto shrunk = [&](int i)
+    {
+        const double g = m_y[i] * m_gradient[i];
+        if (IsUpperBound(i))
+        {
+            return (m_y[i] == 1) ? (-g > gmax1) : (g > gmax2);
+        }
+        if (IsLowerBound(i))
+        {
+            return (m_y[i] == 1) ? (g > gmax2) : (-g > gmax1);
+        }
+        return false;
+    };
+
+    m_active.erase(std::remove_if(m_active.begin(), m_active.end(), shrunk), m_active.end());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Recompute the gradient of the shrunk samples and make all samples active
+//  again. Only the free alphas need kernel rows; the alphas at C are
+//  covered by the saved gradient part.
+///////////////////////////////////////////////////////////////////////////////
+void SmoSolver::ReconstructGradient()
+{
+    const int count = static_cast<int>(m_samples.size());
+    if (static_cast<int>(m_active.size()) == count)
+    {
+        return;
+    }
+
+    std::vector<char> isActive(count, 0);
+    for (int i : m_active)
+    {
+        isActive[i] = 1;
+    }
+
+    std::vector<int> inactive;
+    for (int j = 0; j < count; j++)
+    {
+        if (isActive[j] == 0)
+        {
+            inactive.push_back(j);
+            m_gradient[j] = m_gradientBar[j] - 1;
+        }
+    }
+
+    for (int i : m_active)
+    {
+        if (m_status[i] == FREE)
+        {
+            const float *row = GetRow(i, true);
+            for (int j : inactive)
+            {
+                m_gradient[j] += m_alpha[i] * row[j];
+            }
+        }
+    }
+
+    //Rows computed for the old active set are now partial
+    m_active.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        m_active[i] = i;
+    }
+    m_epoch++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compute the bias from the free alphas, or from the bounds on it given by
+//  the alphas at a bound when none are free
+//
+// RETURNS:
+//  Bias rho of the decision function
+///////////////////////////////////////////////////////////////////////////////
+double SmoSolver::CalculateRho() const
+{
+    double upper = std::numeric_limits<double>::infinity();
+    double lower = -std::numeric_limits<double>::infinity();
+    double freeSum = 0;
+    int freeCount = 0;
+    for (int i : m_active)
+    {
+        const double g = m_y[i] * m_gradient[i];
+        if (IsUpperBound(i))
+        {
+            if (m_y[i] == -1)
+            {
+                upper = std::min(upper, g);
+            }
+            else
+            {
+                lower = std::max(lower, g);
+            }
+        }
+        else if (IsLowerBound(i))
+        {
+            if (m_y[i] == 1)
+            {
+                upper = std::min(upper, g);
+            }
+            else
+            {
+                lower = std::max(lower, g);
+            }
+        }
+        else
+        {
+            freeSum += g;
+            freeCount++;
+        }
+    }
+
+    if (freeCount > 0)
+    {
+        return freeSum / freeCount;
+    }
+
+    //A pair with samples of one class only (possible in a small working
+    //set) has a bound on one side
+    if (std::isinf(upper) || std::isinf(lower))
+    {
+        return std::isinf(upper) ? lower : upper;
+    }
+
+    return (upper + lower) / 2;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get a row of Q from the cache, computing it if it is missing or does not
+//  hold the entries needed. The least recently used row is replaced when
+//  the cache is full.
+//
+// PARAMETERS:
+//  i - problem index of the row
+//  complete - true if the entries of the shrunk samples are needed
+//
+// RETURNS:
+//  Row values, valid until two more rows are requested
+///////////////////////////////////////////////////////////////////////////////
+const float *SmoSolver::GetRow(int i, bool complete)
+{
+    int r = m_rowOf[i];
+    if (r >= 0)
+    {
+        CacheRow &row = m_rows[r];
+        m_lru.splice(m_lru.begin(), m_lru, row.lru);
+        if (row.complete || (complete == false && row.epoch == m_epoch))
+        {
+            return row.values.data();
+        }
+    }
+    else if (m_rows.size() < m_maxRows)
+    {
+        r = static_cast<int>(m_rows.size());
+        m_rows.emplace_back();
+        m_rows[r].lru = m_lru.insert(m_lru.begin(), r);
+    }
+    else
+    {
+        r = m_lru.back();
+        m_lru.splice(m_lru.begin(), m_lru, m_rows[r].lru);
+        m_rowOf[m_rows[r].sample] = -1;
+    }
+
+    m_rows[r].sample = i;
+    m_rowOf[i] = r;
+    ComputeRow(i, m_rows[r], complete);
+    return m_rows[r].values.data();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compute a row of Q in parallel, either for the active samples or for all
+//  samples
+//
+// PARAMETERS:
+//  i - problem index of the row
+//  row - cache row to fill
+//  complete - true to compute the entries of the shrunk samples too
+///////////////////////////////////////////////////////////////////////////////
+void SmoSolver::ComputeRow(int i, CacheRow &row, bool complete)
+{
+    const int count = static_cast<int>(m_samples.size());
+    const bool all = complete || static_cast<int>(m_active.size()) == count;
+    const int entries = all ? count : static_cast<int>(m_active.size());
+    const float *x = m_features.ptr<float>(m_samples[i]);
+    row.values.resize(count);
+    float *values = row.values.data();
+
+    auto compute = [&](const Range &range)
+    {
+        for (int e = range.start; e < range.end; e++)
+        {
+            const int j = all ? e : m_active[e];
+            const double kernel = m_kernel.Evaluate(x, m_features.ptr<float>(m_samples[j]), m_features.cols);
+            values[j] = static_cast<float>(m_y[i] * m_y[j] * kernel);
+        }
+    };
+
+    if (static_cast<double>(entries) * m_features.cols >= PARALLEL_ROW_WORK)
+    {
+        parallel_for_(Range(0, entries), compute);
+    }
+    else
+    {
+        compute(Range(0, entries));
+    }
+
+    row.complete = all;
+    row.epoch = m_epoch;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Check if an alpha is at C
+///////////////////////////////////////////////////////////////////////////////
+bool SmoSolver::IsUpperBound(int i) const
+{
+    return m_status[i] == UPPER_BOUND;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Check if an alpha is at 0
+///////////////////////////////////////////////////////////////////////////////
+bool SmoSolver::IsLowerBound(int i) const
+{
+    return m_status[i] == LOWER_BOUND;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Update the bound status of an alpha after it changed
+///////////////////////////////////////////////////////////////////////////////
+void SmoSolver::UpdateStatus(int i)
+{
+    if (m_alpha[i] >= m_c)
+    {
+        m_status[i] = UPPER_BOUND;
+    }
+    else if (m_alpha[i] <= 0)
+    {
+        m_status[i] = LOWER_BOUND;
+    }
+    else
+    {
+        m_status[i] = FREE;
+    }
+}
@@ -0,0 +1,131 @@
+/******************************************************************************
+
+    FILENAME:       SmoSolver.h
+
+    DESCRIPTION:    Sequential minimal optimization (SMO) training of a
+                    one-vs-one C-SVC. The working pair of each iteration is
+                    chosen with second order information, samples stuck at a
+                    bound are shrunk out of the active set, and kernel rows
+                    are computed in parallel (with the SIMD kernels) into an
+                    LRU cache of a configurable size. Feature files too large
+                    for memory are trained in chunks of the samples
+                    violating the margin of the current solution.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+#include "SvmKernel.h"
+#include "SvmModel.h"
+#include "FeatureFile.h"
+
+#include <list>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class SmoSolver
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    SmoSolver(const SvmKernel &kernel, double c, const cv::TermCriteria &termCriteria);
+    virtual ~SmoSolver();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    void SetCacheSize(int megabytes);
+    void SetShrinking(bool shrinking);
+    bool Solve(const cv::Mat &features, const cv::Mat &labels, const std::vector<int> &classLabels,
+               SvmModel &model);
+    bool Solve(const cv::Mat &features, const cv::Mat &labels, const std::vector<int> &rows,
+               const std::vector<int> &classLabels, SvmModel &model);
+    bool Solve(const FeatureFile &file, int chunkSize, SvmModel &model);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Types
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    //Row of Q (Q[i][j] = y[i] * y[j] * K(i,j)) held by the cache. Rows
+    //computed while samples were shrunk only hold the active entries and
+    //stay valid until the active set grows again.
+    struct CacheRow
+    {
+        int                      sample;   //Problem index of the row
+        bool                     complete; //All entries were computed
+        int                      epoch;    //Active set epoch of a partial row
+        std::vector<float>       values;
+        std::list<int>::iterator lru;
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    void         SolvePairs(const cv::Mat &features, const cv::Mat &labels, const std::vector<int> *rows,
+                            const std::vector<int> &classLabels);
+    bool         BuildModel(const cv::Mat &features, const std::vector<int> &classLabels, SvmModel &model) const;
+    void         KeepSupportVectors(cv::Mat &features, cv::Mat &labels, std::vector<int> &rows);
+    void         FindViolators(const FeatureFile &file, const cv::Mat &workingSet, const std::vector<int> &workingRows,
+                               const std::vector<int> &classLabels, int maxCount, std::vector<int> &violators) const;
+    void         SolvePair(const std::vector<int> &samples, const std::vector<signed char> &y,
+                           std::vector<double> &alpha, double &rho);
+    bool         SelectWorkingSet(int &outI, int &outJ);
+    void         Shrink();
+    void         ReconstructGradient();
+    double       CalculateRho() const;
+    const float *GetRow(int i, bool complete);
+    void         ComputeRow(int i, CacheRow &row, bool complete);
+    bool         IsUpperBound(int i) const;
+    bool         IsLowerBound(int i) const;
+    void         UpdateStatus(int i);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    SvmKernel m_kernel;
+    double    m_c;
+    double    m_eps;
+    int       m_maxIterations;
+    size_t    m_cacheBytes;
+    bool      m_shrinking;
+
+    //Support vectors (feature rows), coefficients (alpha * y) and bias of
+    //each pair solved by SolvePairs()
+    std::vector<std::vector<int>>    m_pairSvs;
+    std::vector<std::vector<double>> m_pairCoefs;
+    std::vector<double>              m_pairRho;
+
+    //Binary problem of the current class pair
+    cv::Mat                  m_features;    //One CV_32FC1 sample per row
+    std::vector<int>         m_samples;     //Feature row of each problem index
+    std::vector<signed char> m_y;           //+1 for the first class, -1 for the second
+    std::vector<double>      m_alpha;
+    std::vector<double>      m_gradient;    //Gradient of the dual objective
+    std::vector<double>      m_gradientBar; //Gradient part of the alphas at C
+    std::vector<signed char> m_status;      //Bound status of each alpha
+    std::vector<double>      m_diagonal;    //Kernel of each sample with itself
+    std::vector<int>         m_active;      //Problem indices not shrunk
+    bool                     m_unshrink;
+
+    //LRU cache of the Q rows of the current pair, filled by all threads
+    std::vector<CacheRow> m_rows;
+    size_t                m_maxRows;
+    std::vector<int>      m_rowOf; //Cache row of each problem index (-1 if none)
+    std::list<int>        m_lru;   //Cache rows, most recently used first
+    int                   m_epoch; //Incremented when the active set grows
+
+};
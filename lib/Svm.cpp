@@ -9,290 +9,1738 @@
 
 ******************************************************************************/
 #include "Svm.h"
+#include "ModelMemory.h"
+#include "SampleFilter.h"
 
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
+#include <iostream>
+#include <map>
+#include <random>
+#include <unordered_map>
 
 using namespace cv;
 using namespace ml;
 
+//Search ranges of C and gamma for TrainAuto() and TrainHalving()
+static const ParamGrid C_GRID(10, 20, 1.1);
+static const ParamGrid GAMMA_GRID(0.5, 2, 1.1);
+
+//Fraction of the samples TrainHalving() holds out to rank configurations
+static const double HALVING_VALIDATION_FRACTION = 0.2;
+
+//Smallest TrainHalving() subset, in samples per class
+static const int MIN_HALVING_CLASS_SAMPLES = 20;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the sorted list of distinct labels in a label matrix
+//
+// PARAMETERS:
+//  labels - label matrix (one CV_32SC1 label per row)
+//
+// RETURNS:
+//  Sorted vector of class labels
+///////////////////////////////////////////////////////////////////////////////
+static std::vector<int> GetClassLabels(const Mat &labels)
+{
+    std::vector<int> classLabels;
+    for (int i = 0; i < labels.rows; i++)
+    {
+        classLabels.push_back(labels.at<int>(i, 0));
+    }
+
+    std::sort(classLabels.begin(), classLabels.end());
+    classLabels.erase(std::unique(classLabels.begin(), classLabels.end()), classLabels.end());
+
+    return classLabels;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get a matrix in the type required by the SVM. A matrix that already has
+//  the type is shared, not copied, so large training matrices are never 
+//  duplicated; other types are converted into a new matrix.
+//
+// PARAMETERS:
+//  matrix - input matrix
+//  type - required type (CV_32FC1 features or CV_32SC1 labels)
+//  view - reference to return the matrix in the required type
+///////////////////////////////////////////////////////////////////////////////
+static void ViewAs(const Mat &matrix, int type, Mat &view)
+{
+    if (matrix.type() == type)
+    {
+        view = matrix;
+    }
+    else
+    {
+        matrix.convertTo(view, type);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the values of a parameter grid in the order OpenCV's trainAuto()
+//  visits them: from the minimum, multiplying by the step while below the
+//  maximum
+//
+// PARAMETERS:
+//  grid - parameter grid
+//
+// RETURNS:
+//  Grid values
+///////////////////////////////////////////////////////////////////////////////
+static std::vector<double> GetGridValues(const ParamGrid &grid)
+{
+    std::vector<double> values;
+    if (grid.logStep <= 1 || grid.minVal <= 0)
+    {
+        values.push_back(grid.minVal);
+        return values;
+    }
+
+    for (double value = grid.minVal; value < grid.maxVal; value *= grid.logStep)
+    {
+        values.push_back(value);
+    }
+
+    return values;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Order the samples so that every prefix of the order is a stratified 
+//  random subset. The samples of each class are shuffled and spread evenly
+//  through the order.
+//
+// PARAMETERS:
+//  labels - label matrix (one CV_32SC1 label per row)
+//
+// RETURNS:
+//  Row index of each position in the order
+///////////////////////////////////////////////////////////////////////////////
+static std::vector<int> GetStratifiedOrder(const Mat &labels)
+{
+    std::map<int, std::vector<int>> classRows;
+    for (int i = 0; i < labels.rows; i++)
+    {
+        classRows[labels.at<int>(i, 0)].push_back(i);
+    }
+
+    //Sort the samples by their relative position within their class
+    std::mt19937 rng(0);
+    std::vector<std::pair<double, int>> keys;
+    for (auto &rows : classRows)
+    {
+        std::shuffle(rows.second.begin(), rows.second.end(), rng);
+        for (size_t r = 0; r < rows.second.size(); r++)
+        {
+            keys.push_back(std::make_pair((r + 0.5) / rows.second.size(), rows.second[r]));
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<int> order;
+    for (const auto &key : keys)
+    {
+        order.push_back(key.second);
+    }
+
+    return order;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Create an untrained OpenCV SVM with the same parameters as another, so
+//  several can be trained at once
+//
+// PARAMETERS:
+//  params - SVM whose parameters are copied
+//
+// RETURNS:
+//  New SVM
+///////////////////////////////////////////////////////////////////////////////
+static Ptr<SVM> CreateSvm(const Ptr<SVM> &params)
+{
+    Ptr<SVM> svm = SVM::create();
+    svm->setType(params->getType());
+    svm->setKernel(params->getKernelType());
+    svm->setGamma(params->getGamma());
+    svm->setC(params->getC());
+    svm->setDegree(params->getDegree());
+    svm->setCoef0(params->getCoef0());
+    svm->setNu(params->getNu());
+    svm->setP(params->getP());
+    svm->setTermCriteria(params->getTermCriteria());
+
+    return svm;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train an OpenCV SVM with one (C, gamma) configuration and measure its
+//  error on validation samples
+//
+// PARAMETERS:
+//  params - SVM whose other parameters are used
+//  c - SVM regularization parameter C
+//  gamma - kernel parameter gamma
+//  trainFeatures - training features (CV_32FC1)
+//  trainLabels - training labels (CV_32SC1)
+//  validationFeatures - validation features (CV_32FC1)
+//  validationLabels - validation labels (CV_32SC1)
+//  mode - prediction mode of the inference engine
+//
+// RETURNS:
+//  Percent error on the validation samples (100 if training failed)
+///////////////////////////////////////////////////////////////////////////////
+static float GetValidationError(const Ptr<SVM> &params, double c, double gamma,
+                                const Mat &trainFeatures, const Mat &trainLabels,
+                                const Mat &validationFeatures, const Mat &validationLabels,
+                                SvmModel::PredictMode mode)
+{
+    Ptr<SVM> svm = CreateSvm(params);
+    svm->setC(c);
+    svm->setGamma(gamma);
+
+    SvmModel model;
+    if (svm->train(trainFeatures, ROW_SAMPLE, trainLabels) == false ||
+        model.Create(svm, GetClassLabels(trainLabels)) == false)
+    {
+        return 100.0f;
+    }
+
+    std::vector<SvmModel::Prediction> predictions;
+    model.PredictBatch(validationFeatures, mode, predictions);
+
+    int errors = 0;
+    for (int i = 0; i < validationLabels.rows; i++)
+    {
+        if (static_cast<int>(predictions[i].label) != validationLabels.at<int>(i, 0))
+        {
+            errors++;
+        }
+    }
+
+    return (100.0f * errors) / std::max(validationLabels.rows, 1);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Default constructor
+///////////////////////////////////////////////////////////////////////////////
+Svm::Svm() :
+    m_predictMode(SvmModel::PREDICT_VOTE),
+    m_modelVersion(0),
+    m_hugePages(false),
+    m_numaReplicas(false),
+    m_budget(0),
+    m_budgetScope(BudgetSolver::BUDGET_GLOBAL),
+    m_solver(SOLVER_OPENCV),
+    m_cacheSizeMb(256)
+{
+    //Create an SVM model
+    m_svm = SVM::create();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor for a model compiled into the executable (see ModelCompiler).
+//  The model's arrays are used in place, so there is nothing to load.
+//
+// PARAMETERS:
+//  model - compiled model
+///////////////////////////////////////////////////////////////////////////////
+Svm::Svm(const SvmModel::StaticModel &model) :
+    m_predictMode(SvmModel::PREDICT_VOTE),
+    m_modelVersion(0),
+    m_hugePages(false),
+    m_numaReplicas(false),
+    m_budget(0),
+    m_budgetScope(BudgetSolver::BUDGET_GLOBAL),
+    m_solver(SOLVER_OPENCV),
+    m_cacheSizeMb(256)
+{
+    //The OpenCV model is left untrained, predictions use the engine
+    m_svm = SVM::create();
+
+    std::shared_ptr<SvmModel> engine = std::make_shared<SvmModel>();
+    if (engine->Wrap(model))
+    {
+        SetModel(engine);
+    }
+    else
+    {
+        std::cout << "Invalid compiled SVM model" << std::endl;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+Svm::~Svm()
+{
+    
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Use the SVM to predict the class from the supplied features.
+//
+// PARAMETERS:
+//  features - feature vector (row vector)
+//
+// RETURNS:
+//  Predicted value for given features
+///////////////////////////////////////////////////////////////////////////////
+float Svm::Predict(const cv::Mat &features) const
+{
+    //Convert data to format required by SVM (in place if already CV_32FC1)
+    Mat input;
+    ViewAs(features, CV_32FC1, input);
+    MapFeatures(input, input);
+
+    //Predict the class using the SVM model
+    return PredictSample(input);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Use the SVM to predict the class from the supplied features and return 
+//  the votes and decision values the prediction was made from.
+//
+// PARAMETERS:
+//  features - feature vector (row vector)
+//  prediction - reference to return the label and decision values
+//
+// RETURNS:
+//  Predicted value for given features
+///////////////////////////////////////////////////////////////////////////////
+float Svm::Predict(const cv::Mat &features, SvmModel::Prediction &prediction) const
+{
+    //Convert data to format required by SVM (in place if already CV_32FC1)
+    Mat input;
+    ViewAs(features, CV_32FC1, input);
+    MapFeatures(input, input);
+
+    //Predict the class using the SVM model
+    return PredictSample(input, &prediction);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Use the SVM to predict the classes of a batch of feature vectors. The
+//  inference engine evaluates the whole batch at once (see
+//  SvmModel::PredictBatch), so this is faster than predicting each row.
+//
+// PARAMETERS:
+//  features - feature matrix (one feature set per row)
+//  predictions - reference to return the prediction of each row
+///////////////////////////////////////////////////////////////////////////////
+void Svm::PredictBatch(const cv::Mat &features, std::vector<SvmModel::Prediction> &predictions) const
+{
+    //Convert data to format required by SVM (in place if already CV_32FC1)
+    Mat input;
+    ViewAs(features, CV_32FC1, input);
+    MapFeatures(input, input);
+
+    if (m_model)
+    {
+        GetLocalModel()->PredictBatch(input, m_predictMode, predictions);
+        return;
+    }
+
+    //Fall back to predicting each row with the OpenCV model
+    predictions.resize(input.rows);
+    for (int i = 0; i < input.rows; i++)
+    {
+        PredictSample(input.row(i), &predictions[i]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the SVM using the supplied features and labels.
+//
+// PARAMETERS:
+//  features - feature matrix (one feature set per row, used in place if it
+//             is CV_32FC1, otherwise converted to a copy)
+//  labels - label matrix (one label per row, used in place if CV_32SC1)
+//
+// RETURNS:
+//  true if SVM trained successfully
+///////////////////////////////////////////////////////////////////////////////
+bool Svm::Train(const cv::Mat &features, const cv::Mat &labels) const
+{
+    //Convert data to format required by SVM (in place if already converted)
+    Mat svmFeatures, svmLabels;
+    ViewAs(features, CV_32FC1, svmFeatures);
+    ViewAs(labels, CV_32SC1, svmLabels);    
+
+    //Create the explicit feature map for the number of input features
+    if (m_featureMap && m_featureMap->Create(svmFeatures.cols) == false)
+    {
+        return false;
+    }
+    MapFeatures(svmFeatures, svmFeatures);
+
+    //Factors of a previous model do not apply to the new support vectors
+    m_lowRankU.release();
+    m_lowRankV.release();
+
+    //Train within the support vector budget
+    if (m_budget > 0)
+    {
+        return TrainBudget(svmFeatures, svmLabels);
+    }
+
+    if (m_solver == SOLVER_SMO)
+    {
+        return TrainSmo(svmFeatures, svmLabels);
+    }
+
+    // Train the SVM model
+    m_svm->train(svmFeatures, ROW_SAMPLE, svmLabels);    
+
+    //Build the inference engine from the trained model
+    CompileModel(GetClassLabels(svmLabels));
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the SVM from a feature file (see FeatureFile) without loading it
+//  into memory. Linear SVMs are trained with SgdSolver streaming the file
+//  each epoch, and C_SVC kernel SVMs with SmoSolver on chunks of the 
+//  samples violating the margin. The model is saved as the inference 
+//  engine, like budgeted models.
+//
+// PARAMETERS:
+//  filename - path to the feature file
+//  chunkSize - maximum samples added to the kernel working set per pass
+//
+// RETURNS:
+//  true if the SVM trained successfully
+///////////////////////////////////////////////////////////////////////////////
+bool Svm::TrainFile(const std::string &filename, int chunkSize) const
+{
+    if (m_featureMap)
+    {
+        std::cout << "Training from a feature file does not support a feature map" << std::endl;
+        return false;
+    }
+
+    FeatureFile file;
+    if (file.Open(filename) == false)
+    {
+        return false;
+    }
+
+    //Factors of a previous model do not apply to the new support vectors
+    m_lowRankU.release();
+    m_lowRankV.release();
+
+    std::shared_ptr<SvmModel> model = std::make_shared<SvmModel>();
+    if (m_svm->getKernelType() == SVM::LINEAR)
+    {
+        SgdSolver solver(SvmKernel(m_svm), m_svm->getC());
+        if (solver.Solve(file, *model) == false)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        if (m_svm->getType() != SVM::C_SVC)
+        {
+            std::cout << "Kernel training from a feature file requires a C_SVC SVM" << std::endl;
+            return false;
+        }
+
+        SmoSolver solver(SvmKernel(m_svm), m_svm->getC(), m_svm->getTermCriteria());
+        solver.SetCacheSize(m_cacheSizeMb);
+        if (solver.Solve(file, chunkSize, *model) == false)
+        {
+            return false;
+        }
+    }
+
+    //Drop any previously trained OpenCV model (keeping its parameters) so the
+    //engine is used and saved
+    m_svm->clear();
+    SetModel(model);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the SVM using the supplied features and labels.
+//
+// PARAMETERS:
+//  features - feature matrix (one feature set per row, used in place if it
+//             is CV_32FC1, otherwise converted to a copy)
+//  labels - label matrix (one label per row, used in place if CV_32SC1)
+//
+// RETURNS:
+//  true if SVM trained successfully
+///////////////////////////////////////////////////////////////////////////////
+bool Svm::TrainAuto(const cv::Mat &features, const cv::Mat &labels) const
+{
+    //Convert data to format required by SVM (in place if already converted)
+    Mat svmFeatures, svmLabels;
+    ViewAs(features, CV_32FC1, svmFeatures);
+    ViewAs(labels, CV_32SC1, svmLabels);
+
+    //Create the explicit feature map for the number of input features
+    if (m_featureMap && m_featureMap->Create(svmFeatures.cols) == false)
+    {
+        return false;
+    }
+    MapFeatures(svmFeatures, svmFeatures);
+
+    //Factors of a previous model do not apply to the new support vectors
+    m_lowRankU.release();
+    m_lowRankV.release();
+
+    Ptr<TrainData> td = TrainData::create(svmFeatures, ROW_SAMPLE, svmLabels);
+
+    //TODO add member functions to set the parameters below
+    ParamGrid Cgrid = C_GRID;
+    ParamGrid gammaGrid = GAMMA_GRID;
+    ParamGrid pGrid(0, 0, 0);
+    ParamGrid nuGrid(0, 0, 0);
+    ParamGrid coeffGrid(0, 0, 0);
+    ParamGrid degreeGrid(0, 0, 0);
+    bool balanced = false;
+    int k = 10;
+
+    // Train the SVM model
+    m_svm->trainAuto(td, k, Cgrid, gammaGrid, pGrid, nuGrid, coeffGrid, degreeGrid, balanced);  
+
+    //Build the inference engine from the trained model
+    CompileModel(GetClassLabels(svmLabels));
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Search the TrainAuto() grid of C and gamma by successive halving, then
+//  train the SVM with the best configuration on all the samples. Every
+//  configuration is trained on a small stratified subset and ranked by its
+//  error on held out samples; the best 1/eta of them are trained again on a
+//  subset eta times larger, until the finalists are trained on all of the
+//  non held out samples. Each round trains its configurations in parallel.
+//
+// PARAMETERS:
+//  features - feature matrix (one feature set per row, used in place if it
+//             is CV_32FC1, otherwise converted to a copy)
+//  labels - label matrix (one label per row, used in place if CV_32SC1)
+//  eta - factor the configurations are reduced by each round (at least 2)
+//
+// RETURNS:
+//  true if SVM trained successfully
+///////////////////////////////////////////////////////////////////////////////
+bool Svm::TrainHalving(const cv::Mat &features, const cv::Mat &labels, int eta) const
+{
+    if (m_featureMap)
+    {
+        std::cout << "Successive halving does not support a feature map" << std::endl;
+        return false;
+    }
+
+    //Convert data to format required by SVM (in place if already converted)
+    Mat svmFeatures, svmLabels;
+    ViewAs(features, CV_32FC1, svmFeatures);
+    ViewAs(labels, CV_32SC1, svmLabels);
+
+    const int classCount = static_cast<int>(GetClassLabels(svmLabels).size());
+    if (eta < 2 || classCount < 2 || svmFeatures.rows != svmLabels.rows)
+    {
+        return false;
+    }
+
+    //Copy the samples once in stratified order, so every subset is a prefix
+    //of the rows and the held out samples are the last rows
+    const std::vector<int> order = GetStratifiedOrder(svmLabels);
+    Mat orderedFeatures(svmFeatures.rows, svmFeatures.cols, CV_32FC1);
+    Mat orderedLabels(svmLabels.rows, 1, CV_32SC1);
+    for (int i = 0; i < svmFeatures.rows; i++)
+    {
+        svmFeatures.row(order[i]).copyTo(orderedFeatures.row(i));
+        orderedLabels.at<int>(i, 0) = svmLabels.at<int>(order[i], 0);
+    }
+
+    const int validationRows = std::max(static_cast<int>(svmFeatures.rows * HALVING_VALIDATION_FRACTION), 1);
+    const int trainRows = svmFeatures.rows - validationRows;
+    const Mat validationFeatures = orderedFeatures.rowRange(trainRows, svmFeatures.rows);
+    const Mat validationLabels = orderedLabels.rowRange(trainRows, svmFeatures.rows);
+
+    //Every configuration of the grid (gamma does not apply to linear SVMs)
+    struct Configuration
+    {
+        double c;
+        double gamma;
+        float  error;
+    };
+
+    std::vector<double> gammaValues = GetGridValues(GAMMA_GRID);
+    if (m_svm->getKernelType() == SVM::LINEAR)
+    {
+        gammaValues.assign(1, m_svm->getGamma());
+    }
+
+    std::vector<Configuration> configurations;
+    for (double c : GetGridValues(C_GRID))
+    {
+        for (double gamma : gammaValues)
+        {
+            Configuration configuration = { c, gamma, 0.0f };
+            configurations.push_back(configuration);
+        }
+    }
+
+    //Halve until a few finalists remain, and start from the subset size that
+    //reaches all the training samples in that many rounds
+    int rounds = 0;
+    for (size_t remaining = configurations.size(); remaining / eta >= 2; remaining /= eta)
+    {
+        rounds++;
+    }
+
+    const int minRows = std::min(MIN_HALVING_CLASS_SAMPLES * classCount, trainRows);
+    for (int round = 0; round <= rounds; round++)
+    {
+        int subsetRows = trainRows;
+        for (int i = round; i < rounds; i++)
+        {
+            subsetRows /= eta;
+        }
+        subsetRows = std::max(subsetRows, minRows);
+
+        const Mat subsetFeatures = orderedFeatures.rowRange(0, subsetRows);
+        const Mat subsetLabels = orderedLabels.rowRange(0, subsetRows);
+
+        TickMeter roundTimer;
+        roundTimer.start();
+        parallel_for_(Range(0, static_cast<int>(configurations.size())), [&](const Range &range)
+        {
+            for (int i = range.start; i < range.end; i++)
+            {
+                configurations[i].error = GetValidationError(m_svm, configurations[i].c, configurations[i].gamma,
+                                                             subsetFeatures, subsetLabels,
+                                                             validationFeatures, validationLabels, m_predictMode);
+            }
+        });
+        roundTimer.stop();
+
+        std::stable_sort(configurations.begin(), configurations.end(), 
+                         [](const Configuration &a, const Configuration &b) { return a.error < b.error; });
+
+        std::cout << "Halving round " << round << ": " << configurations.size() << " configurations on "
+                  << subsetRows << " samples in " << roundTimer.getTimeSec() << " s, best C = "
+                  << configurations[0].c << ", gamma = " << configurations[0].gamma
+                  << ", validation error " << configurations[0].error << "%" << std::endl;
+
+        if (round < rounds)
+        {
+            configurations.resize(std::max<size_t>(configurations.size() / eta, 1));
+        }
+    }
+
+    //Train the best configuration on all the samples
+    m_svm->setC(configurations[0].c);
+    m_svm->setGamma(configurations[0].gamma);
+
+    return Train(svmFeatures, svmLabels);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Estimate the accuracy of the SVM parameters by k-fold cross-validation.
+//  The samples are dealt into stratified folds and the folds are trained 
+//  and tested concurrently. Every fold reads the same feature matrix in 
+//  place: it is trained by SmoSolver on the indices of its training rows
+//  (OpenCV's solver would copy them) and its test rows are predicted
+//  directly, so only each fold's support vectors are copied. C_SVC only.
+//  The SVM's own model is not changed.
+//
+// PARAMETERS:
+//  features - feature matrix (one feature set per row, used in place if it
+//             is CV_32FC1, otherwise converted to a copy)
+//  labels - label matrix (one label per row, used in place if CV_32SC1)
+//  folds - number of folds (at least 2)
+//  maxThreads - most threads used in total (0 for OpenCV's thread count).
+//               OpenCV runs the parallel regions nested in a fold serially,
+//               so this is also the number of folds run at once.
+//  result - reference to return the results of each fold and the 
+//           confusion matrix
+//
+// RETURNS:
+//  true if every fold trained successfully
+///////////////////////////////////////////////////////////////////////////////
+bool Svm::CrossValidate(const cv::Mat &features, const cv::Mat &labels, int folds, int maxThreads, 
+                        CrossValidation &result) const
+{
+    if (m_featureMap)
+    {
+        std::cout << "Cross-validation does not support a feature map" << std::endl;
+        return false;
+    }
+
+    //Convert data to format required by SVM (in place if already converted)
+    Mat svmFeatures, svmLabels;
+    ViewAs(features, CV_32FC1, svmFeatures);
+    ViewAs(labels, CV_32SC1, svmLabels);
+
+    if (m_svm->getType() != SVM::C_SVC)
+    {
+        std::cout << "Cross-validation requires a C_SVC SVM" << std::endl;
+        return false;
+    }
+
+    const std::vector<int> classLabels = GetClassLabels(svmLabels);
+    const int classCount = static_cast<int>(classLabels.size());
+    if (folds < 2 || svmFeatures.rows < folds || svmFeatures.rows != svmLabels.rows || classCount < 2)
+    {
+        return false;
+    }
+
+    //Fold of each sample, dealt in stratified order
+    const std::vector<int> order = GetStratifiedOrder(svmLabels);
+    std::vector<int> sampleFold(svmFeatures.rows);
+    for (int i = 0; i < svmFeatures.rows; i++)
+    {
+        sampleFold[order[i]] = i % folds;
+    }
+
+    result.classLabels = classLabels;
+    result.folds.assign(folds, FoldResult());
+    std::vector<Mat> confusions(folds);
+
+    const int previousThreads = getNumThreads();
+    const int threads = std::max(std::min(folds, (maxThreads > 0) ? maxThreads : previousThreads), 1);
+    setNumThreads(threads);
+
+    parallel_for_(Range(0, folds), [&](const Range &range)
+    {
+        for (int fold = range.start; fold < range.end; fold++)
+        {
+            std::vector<int> trainRows;
+            std::vector<int> testRows;
+            for (int i = 0; i < svmFeatures.rows; i++)
+            {
+                if (sampleFold[i] == fold)
+                {
+                    testRows.push_back(i);
+                }
+                else
+                {
+                    trainRows.push_back(i);
+                }
+            }
+
+            FoldResult &foldResult = result.folds[fold];
+            foldResult.trained = false;
+            foldResult.trainSamples = static_cast<int>(trainRows.size());
+            foldResult.testSamples = static_cast<int>(testRows.size());
+            foldResult.errors = 0;
+            foldResult.trainSeconds = 0;
+            foldResult.predictSeconds = 0;
+            confusions[fold] = Mat::zeros(classCount, classCount, CV_32SC1);
+
+            //Classes of the training samples (all of them unless a class has
+            //fewer samples than there are folds)
+            std::vector<int> foldClassLabels;
+            for (int row : trainRows)
+            {
+                foldClassLabels.push_back(svmLabels.at<int>(row, 0));
+            }
+            std::sort(foldClassLabels.begin(), foldClassLabels.end());
+            foldClassLabels.erase(std::unique(foldClassLabels.begin(), foldClassLabels.end()), foldClassLabels.end());
+
+            //The kernel caches of the concurrent folds share the cache size
+            TickMeter trainTimer;
+            trainTimer.start();
+            SmoSolver solver(SvmKernel(m_svm), m_svm->getC(), m_svm->getTermCriteria());
+            solver.SetCacheSize(std::max(m_cacheSizeMb / threads, 1));
+            SvmModel model;
+            if (foldClassLabels.size() < 2 || 
+                solver.Solve(svmFeatures, svmLabels, trainRows, foldClassLabels, model) == false)
+            {
+                continue;
+            }
+            trainTimer.stop();
+
+            TickMeter predictTimer;
+            predictTimer.start();
+            for (int row : testRows)
+            {
+                const int label = static_cast<int>(model.Predict(svmFeatures.ptr<float>(row), m_predictMode));
+                const int actual = svmLabels.at<int>(row, 0);
+                if (label != actual)
+                {
+                    foldResult.errors++;
+                }
+
+                const int actualIndex = static_cast<int>(std::lower_bound(classLabels.begin(), classLabels.end(), actual) - 
+                                                         classLabels.begin());
+                const int labelIndex = static_cast<int>(std::lower_bound(classLabels.begin(), classLabels.end(), label) - 
+                                                        classLabels.begin());
+                confusions[fold].at<int>(actualIndex, std::min(labelIndex, classCount - 1))++;
+            }
+            predictTimer.stop();
+
+            foldResult.trained = true;
+            foldResult.trainSeconds = trainTimer.getTimeSec();
+            foldResult.predictSeconds = predictTimer.getTimeSec();
+        }
+    }, threads);
+
+    setNumThreads(previousThreads);
+
+    bool trained = true;
+    result.confusion = Mat::zeros(classCount, classCount, CV_32SC1);
+    for (int fold = 0; fold < folds; fold++)
+    {
+        trained = trained && result.folds[fold].trained;
+        result.confusion += confusions[fold];
+    }
+
+    return trained;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Select a core set of the samples that preserves the decision boundary,
+//  as in the first layer of a cascade SVM: the samples are dealt into 
+//  stratified chunks, an SVM with this SVM's parameters is trained on each
+//  chunk in parallel, and only the support vectors of the chunks are kept.
+//  Samples that are not support vectors of their chunk are far from the
+//  boundary and rarely support vectors of the whole set.
+//
+// PARAMETERS:
+//  features - feature matrix (one feature set per row)
+//  labels - label matrix (one label per row)
+//  chunkSize - approximate samples per chunk
+//  keep - flag of each sample to keep (one per row); only the kept samples
+//         are used, and the flags of those left out of the core set are
+//         cleared
+//
+// RETURNS:
+//  true if the core set was selected
+///////////////////////////////////////////////////////////////////////////////
+bool Svm::SelectCoreSet(const cv::Mat &features, const cv::Mat &labels, int chunkSize,
+                        std::vector<bool> &keep) const
+{
+    if (m_featureMap)
+    {
+        std::cout << "Core set selection does not support a feature map" << std::endl;
+        return false;
+    }
+
+    //Convert data to format required by SVM (in place if already converted)
+    Mat svmFeatures, svmLabels;
+    ViewAs(features, CV_32FC1, svmFeatures);
+    ViewAs(labels, CV_32SC1, svmLabels);
+    if (svmFeatures.rows != svmLabels.rows || static_cast<int>(keep.size()) != svmFeatures.rows || chunkSize < 1)
+    {
+        return false;
+    }
+
+    //Deal the kept samples in stratified order, so each chunk has every
+    //class in proportion
+    std::vector<int> kept;
+    for (int row : GetStratifiedOrder(svmLabels))
+    {
+        if (keep[row])
+        {
+            kept.push_back(row);
+        }
+    }
+
+    const int chunkCount = std::max(static_cast<int>(kept.size()) / chunkSize, 1);
+    std::vector<unsigned char> support(svmFeatures.rows, 0);
+    parallel_for_(Range(0, chunkCount), [&](const Range &range)
+    {
+        for (int chunk = range.start; chunk < range.end; chunk++)
+        {
+            std::vector<int> rows;
+            for (size_t i = chunk; i < kept.size(); i += chunkCount)
+            {
+                rows.push_back(kept[i]);
+            }
+
+            Mat chunkFeatures(static_cast<int>(rows.size()), svmFeatures.cols, CV_32FC1);
+            Mat chunkLabels(static_cast<int>(rows.size()), 1, CV_32SC1);
+            for (int i = 0; i < chunkFeatures.rows; i++)
+            {
+                svmFeatures.row(rows[i]).copyTo(chunkFeatures.row(i));
+                chunkLabels.at<int>(i, 0) = svmLabels.at<int>(rows[i], 0);
+            }
+
+            //A chunk with one class has no boundary to select for
+            Ptr<SVM> svm = CreateSvm(m_svm);
+            if (GetClassLabels(chunkLabels).size() < 2 ||
+                svm->train(chunkFeatures, ROW_SAMPLE, chunkLabels) == false)
+            {
+                for (int row : rows)
+                {
+                    support[row] = 1;
+                }
+                continue;
+            }
+
+            //The support vectors are copies of chunk samples, found by hash
+            const Mat supportVectors = (svm->getKernelType() == SVM::LINEAR) ?
+                                       svm->getUncompressedSupportVectors() : svm->getSupportVectors();
+            const size_t rowBytes = svmFeatures.cols * sizeof(float);
+            std::unordered_map<uint64_t, std::vector<int>> vectors;
+            for (int v = 0; v < supportVectors.rows; v++)
+            {
+                vectors[SampleFilter::Hash(supportVectors.ptr<float>(v), rowBytes)].push_back(v);
+            }
+
+            for (int i = 0; i < chunkFeatures.rows; i++)
+            {
+                auto match = vectors.find(SampleFilter::Hash(chunkFeatures.ptr<float>(i), rowBytes));
+                if (match == vectors.end())
+                {
+                    continue;
+                }
+
+                for (int v : match->second)
+                {
+                    if (std::memcmp(chunkFeatures.ptr<float>(i), supportVectors.ptr<float>(v), rowBytes) == 0)
+                    {
+                        support[rows[i]] = 1;
+                        break;
+                    }
+                }
+            }
+        }
+    });
+
+    for (int row : kept)
+    {
+        keep[row] = (support[row] != 0);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Test the current SVM model using the supplied features and labels.
+//
+// PARAMETERS:
+//  features - feature matrix (one feature set per row, used in place if it
+//             is CV_32FC1, otherwise converted to a copy)
+//  labels - label matrix (one label per row, used in place if CV_32SC1)
+//
+// RETURNS:
+//  Percent error of classification for supplied features and labels
+///////////////////////////////////////////////////////////////////////////////
+float Svm::Test(const cv::Mat &features, const cv::Mat &labels) const
+{
+    //Convert data to format required by SVM (in place if already converted)
+    Mat svmFeatures, svmLabels;
+    ViewAs(features, CV_32FC1, svmFeatures);
+    ViewAs(labels, CV_32SC1, svmLabels);    
+    MapFeatures(svmFeatures, svmFeatures);
+
+    //Predict each example using the model and compare prediction to actual label
+    int result = 0;
+    int errors = 0;
+    for (int i = 0; i < svmFeatures.rows; i++)
+    {
+        result = static_cast<int>(PredictSample(svmFeatures.row(i)));
+        if (result != svmLabels.at<int>(i, 0))
+        {
+            errors++;
+        }
+    }
+
+    float percentError = (100.0f * errors) / svmLabels.rows;
+
+    //Display results of test
+    //std::cout << "SVM testing completed" << std::endl
+    //          << "Number of inputs: " << svmLabels.rows << std::endl
+    //          << "Number of errors: " << errors << std::endl
+    //          << "Percent error:    " << percentError << "%"
+    //          << std::endl;
+
+    return percentError;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Load an SVM model file
+//
+// PARAMETERS:
+//  filename - path to SVM model file
+//
+// RETURNS:
+//  true if model loaded successfully
+///////////////////////////////////////////////////////////////////////////////
+bool Svm::Load(const std::string &filename)
+{
+    //Check if the SVM model file exists 
+    if (std::experimental::filesystem::exists(filename) == false)
+    {
+        return false;
+    }
+
+    FileStorage fs(filename, FileStorage::READ);
+
+    //Read the explicit feature map if the model was trained with one
+    m_featureMap.reset();
+    FileNode mapNode = fs["feature_map"];
+    if (mapNode.empty() == false)
+    {
+        std::shared_ptr<PolySketch> featureMap = std::make_shared<PolySketch>();
+        if (featureMap->Read(mapNode) == false)
+        {
+            return false;
+        }
+        m_featureMap = featureMap;
+    }
+
+    //Compressed models are saved as an inference engine without an OpenCV 
+    //model since they no longer have the full support vectors
+    FileNode modelNode = fs["svm_model"];
+    if (modelNode.empty() == false)
+    {
+        std::shared_ptr<SvmModel> model = std::make_shared<SvmModel>();
+        if (model->Read(modelNode) == false)
+        {
+            SetModel(nullptr);
+            return false;
+        }
+
+        m_svm = SVM::create();
+        m_lowRankU.release();
+        m_lowRankV.release();
+        SetModel(model);
+
+        return true;
+    }
+
+    //Load the SVM model
+    FileNode node = fs.getFirstTopLevelNode();
+    m_svm = Algorithm::read<SVM>(node);
+    if (m_svm.empty())
+    {
+        m_svm = SVM::create();
+        SetModel(nullptr);
+        return false;
+    }
+
+    //Read the class labels needed by the inference engine
+    Mat labelMat;
+    node["class_labels"] >> labelMat;
+    labelMat.convertTo(labelMat, CV_32SC1);
+
+    std::vector<int> classLabels;
+    for (size_t i = 0; i < labelMat.total(); i++)
+    {
+        classLabels.push_back(labelMat.at<int>(static_cast<int>(i)));
+    }
+
+    //Read the low rank support vector factors if the model has them
+    FileNode lowRankNode = fs["low_rank"];
+    lowRankNode["u"] >> m_lowRankU;
+    lowRankNode["v"] >> m_lowRankV;
+
+    //Build the inference engine from the loaded model
+    CompileModel(classLabels);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Load an OpenCV XML SVM model file with the fast parser (see 
+//  SvmXmlParser). Only the inference engine is created, so the model can be
+//  used for prediction but is saved as an engine model (see Save()). Files
+//  with a feature map or low rank factors, and files in other formats, are
+//  not supported and need Load().
+//
+// PARAMETERS:
+//  filename - path to SVM model file
+//
+// RETURNS:
+//  true if model loaded successfully
+///////////////////////////////////////////////////////////////////////////////
+bool Svm::LoadXml(const std::string &filename)
+{
+    SvmXmlParser parser;
+    if (parser.Open(filename) == false)
+    {
+        return false;
+    }
+
+    //Extension nodes are saved after the OpenCV model
+    const SvmXmlParser::Element trailer = parser.GetTrailer();
+    if (parser.Find(trailer, "feature_map").data() != nullptr ||
+        parser.Find(trailer, "low_rank").data() != nullptr)
+    {
+        return false;
+    }
+
+    std::shared_ptr<SvmModel> model = std::make_shared<SvmModel>();
+    if (model->ReadXml(parser) == false)
+    {
+        return false;
+    }
+
+    m_svm = SVM::create();
+    m_featureMap.reset();
+    m_lowRankU.release();
+    m_lowRankV.release();
+    SetModel(model);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Save the current SVM model to a file
+//
+// PARAMETERS:
+//  filename - path for SVM model file
+//
+// RETURNS:
+//  true if model saved successfully
+///////////////////////////////////////////////////////////////////////////////
+bool Svm::Save(const std::string &filename) const
+{
+    //Validate filename
+    if (filename.empty())
+    {
+        return false;
+    }
+
+    FileStorage fs(filename, FileStorage::WRITE);
+    if (m_model && (m_model->GetLayout() == SvmModel::LAYOUT_PRODUCT_QUANTIZED || m_svm->isTrained() == false))
+    {
+        //Quantized and compiled models don't have the support vectors needed by OpenCV
+        fs << "svm_model" << "{";
+        m_model->Write(fs);
+        fs << "}";
+    }
+    else
+    {
+        //Save the model in the same layout as cv::ml::SVM::save so the file 
+        //can still be loaded by OpenCV
+        fs << m_svm->getDefaultName() << "{";
+        m_svm->write(fs);
+        fs << "}";
+
+        if (m_lowRankU.empty() == false)
+        {
+            fs << "low_rank" << "{" << "u" << m_lowRankU << "v" << m_lowRankV << "}";
+        }
+    }
+
+    if (m_featureMap)
+    {
+        fs << "feature_map" << "{";
+        m_featureMap->Write(fs);
+        fs << "}";
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Write the model as C++ source to compile into an executable (see 
+//  SvmModel::WriteSource). Models with a feature map are not supported.
+//
+// PARAMETERS:
+//  source - stream to write the source to
+//  binary - stream to write the model buffers to
+//  name - name of the SvmModel::StaticModel variable
+//  binaryFilename - path of the binary file as seen by the assembler
+//
+// RETURNS:
+//  true if the source and binary were written
+///////////////////////////////////////////////////////////////////////////////
+bool Svm::WriteSource(std::ostream &source, std::ostream &binary, const std::string &name,
+                      const std::string &binaryFilename) const
+{
+    if (m_model == nullptr || m_featureMap)
+    {
+        return false;
+    }
+
+    return m_model->WriteSource(source, binary, name, binaryFilename);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the SVM type
+//
+// PARAMETERS:
+//  type - SVM type
+///////////////////////////////////////////////////////////////////////////////
+void Svm::SetType(cv::ml::SVM::Types type) const
+{
+    m_svm->setType(type);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the SVM kernel type
+//
+// PARAMETERS:
+//  kernel - SVM kernel type
+///////////////////////////////////////////////////////////////////////////////
+void Svm::SetKernel(cv::ml::SVM::KernelTypes kernel) const
+{
+    m_svm->setKernel(kernel);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the SVM termination criteria
+//
+// PARAMETERS:
+//  termCriteria - SVM termination criteria
+///////////////////////////////////////////////////////////////////////////////
+void Svm::SetTermCriteria(cv::TermCriteria termCriteria) const
+{
+    m_svm->setTermCriteria(termCriteria);    
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the SVM gamma parameter
+//
+// PARAMETERS:
+//  gamma - SVM gamma parameter
+///////////////////////////////////////////////////////////////////////////////
+void Svm::SetGamma(double gamma) const
+{
+    m_svm->setGamma(gamma);    
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the SVM C parameter
+//
+// PARAMETERS:
+//  c - SVM c parameter
+///////////////////////////////////////////////////////////////////////////////
+void Svm::SetC(double c) const
+{    
+    m_svm->setC(c);
+}
 
 ///////////////////////////////////////////////////////////////////////////////
-//  Default constructor
+// DESCRIPTION:
+//  Set the SVM degree parameter
+//
+// PARAMETERS:
+//  degree - SVM degree parameter
 ///////////////////////////////////////////////////////////////////////////////
-Svm::Svm()
+void Svm::SetDegree(double degree) const
 {
-    //Create an SVM model
-    m_svm = SVM::create();
+    m_svm->setDegree(degree);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-//  Destructor
+// DESCRIPTION:
+//  Set the SVM nu parameter
+//
+// PARAMETERS:
+//  nu - SVM nu parameter
 ///////////////////////////////////////////////////////////////////////////////
-Svm::~Svm()
+void Svm::SetNu(double nu) const
 {
-    
+    m_svm->setNu(nu);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Use the SVM to predict the class from the supplied features.
+//  Set the SVM P parameter
 //
 // PARAMETERS:
-//  features - feature vector (row vector)
-//
-// RETURNS:
-//  Predicted value for given features
+//  p - SVM P parameter
 ///////////////////////////////////////////////////////////////////////////////
-float Svm::Predict(const cv::Mat &features) const
+void Svm::SetP(double p) const
 {
-    //Convert data to format required by SVM
-    Mat input;
-    features.convertTo(input, CV_32FC1);
+    m_svm->setP(p);
+}
 
-    //Predict the class using the SVM model
-    return m_svm->predict(input);
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Set the method used to combine the one-vs-one decision functions of a 
+//  multi-class model during prediction
+//
+// PARAMETERS:
+//  mode - prediction mode (max-wins voting or decision DAG)
+///////////////////////////////////////////////////////////////////////////////
+void Svm::SetPredictMode(SvmModel::PredictMode mode)
+{
+    m_predictMode = mode;
+    m_modelVersion++;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Train the SVM using the supplied features and labels.
+//  Predict the class of a single sample. Uses the inference engine when one 
+//  has been built and falls back to the OpenCV model otherwise.
 //
 // PARAMETERS:
-//  features - feature matrix (one feature set per row)
-//  labels - label matrix (one label per row)
+//  sample - feature vector (CV_32FC1 row vector)
+//  prediction - optional pointer to return the label and decision values
 //
 // RETURNS:
-//  true if SVM trained successfully
+//  Predicted value for given sample
 ///////////////////////////////////////////////////////////////////////////////
-bool Svm::Train(const cv::Mat &features, const cv::Mat &labels) const
+float Svm::PredictSample(const cv::Mat &sample, SvmModel::Prediction *prediction) const
 {
-    //Convert data to format required by SVM
-    Mat svmFeatures, svmLabels;
-    features.convertTo(svmFeatures, CV_32FC1);
-    labels.convertTo(svmLabels, CV_32SC1);    
+    if (m_model && sample.isContinuous())
+    {
+        CV_Assert(sample.type() == CV_32FC1 && sample.cols == GetLocalModel()->GetVarCount());
+        return GetLocalModel()->Predict(sample.ptr<float>(0), m_predictMode, prediction);
+    }
 
-    // Train the SVM model
-    m_svm->train(svmFeatures, ROW_SAMPLE, svmLabels);    
+    //Decision values are not available from the OpenCV model
+    float label = m_svm->predict(sample);
+    if (prediction != nullptr)
+    {
+        prediction->label = label;
+        prediction->decision = 0.0f;
+        prediction->votes.clear();
+        prediction->margins.clear();
+    }
 
-    return true;
+    return label;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Train the SVM using the supplied features and labels.
-//
-// PARAMETERS:
-//  features - feature matrix (one feature set per row)
-//  labels - label matrix (one label per row)
+//  Get the inference engine to predict with on the calling thread (the 
+//  replica on the thread's NUMA node when replicas are enabled)
 //
 // RETURNS:
-//  true if SVM trained successfully
+//  Inference engine (null if the OpenCV model should be used)
 ///////////////////////////////////////////////////////////////////////////////
-bool Svm::TrainAuto(const cv::Mat &features, const cv::Mat &labels) const
+const SvmModel *Svm::GetLocalModel() const
 {
-    //Convert data to format required by SVM
-    Mat svmFeatures, svmLabels;
-    features.convertTo(svmFeatures, CV_32FC1);
-    labels.convertTo(svmLabels, CV_32SC1);
+    if (m_replicas.empty() == false)
+    {
+        const int node = ModelMemory::GetCurrentNumaNode();
+        return m_replicas[std::min(node, static_cast<int>(m_replicas.size()) - 1)].get();
+    }
 
-    Ptr<TrainData> td = TrainData::create(svmFeatures, ROW_SAMPLE, svmLabels);
+    return m_model.get();
+}
 
-    //TODO add member functions to set the parameters below
-    ParamGrid Cgrid(10, 20, 1.1);
-    ParamGrid gammaGrid(0.5, 2, 1.1);
-    ParamGrid pGrid(0, 0, 0);
-    ParamGrid nuGrid(0, 0, 0);
-    ParamGrid coeffGrid(0, 0, 0);
-    ParamGrid degreeGrid(0, 0, 0);
-    bool balanced = false;
-    int k = 10;
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Build the inference engine from the current OpenCV model. Models not 
+//  supported by the engine (regression, one class, custom kernels) are 
+//  predicted with the OpenCV model.
+//
+// PARAMETERS:
+//  classLabels - sorted class labels of the model
+///////////////////////////////////////////////////////////////////////////////
+void Svm::CompileModel(const std::vector<int> &classLabels) const
+{
+    std::shared_ptr<SvmModel> model = std::make_shared<SvmModel>();
+    if (model->Create(m_svm, classLabels) == true)
+    {
+        //Replace the support vectors with their low rank factors
+        if (m_lowRankU.empty() == false && model->SetLowRank(m_lowRankU, m_lowRankV) == false)
+        {
+            m_lowRankU.release();
+            m_lowRankV.release();
+        }
 
-    // Train the SVM model
-    m_svm->trainAuto(td, k, Cgrid, gammaGrid, pGrid, nuGrid, coeffGrid, degreeGrid, balanced);  
 
-    return true;
+        SetModel(model);
+    }
+    else
+    {
+        SetModel(nullptr);
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Test the current SVM model using the supplied features and labels.
+//  Approximate the currently configured polynomial kernel with an explicit 
+//  feature map. The SVM is switched to a linear kernel and is trained on and
+//  predicts from the mapped features, so prediction cost no longer depends 
+//  on the number of support vectors.
 //
 // PARAMETERS:
-//  features - feature matrix (one item per row)
-//  labels - label matrix (one label per row)
+//  dimension - number of mapped features (0 to disable the feature map)
 //
 // RETURNS:
-//  Percent error of classification for supplied features and labels
+//  true if the feature map was set
 ///////////////////////////////////////////////////////////////////////////////
-float Svm::Test(const cv::Mat &features, const cv::Mat &labels) const
+bool Svm::SetFeatureMap(int dimension)
 {
-    //Convert data to format required by SVM
-    Mat svmFeatures, svmLabels;
-    features.convertTo(svmFeatures, CV_32FC1);
-    labels.convertTo(svmLabels, CV_32SC1);    
+    if (dimension <= 0)
+    {
+        m_featureMap.reset();
+        return true;
+    }
 
-    //Predict each example using the model and compare prediction to actual label
-    int result = 0;
-    int errors = 0;
-    for (int i = 0; i < svmFeatures.rows; i++)
+    //Only the polynomial kernel can be approximated
+    if (m_svm->getKernelType() != SVM::POLY)
     {
-        result = static_cast<int>(m_svm->predict(svmFeatures.row(i)));
-        if (result != svmLabels.at<int>(i, 0))
-        {
-            errors++;
-        }
+        return false;
     }
 
-    float percentError = (100.0f * errors) / svmLabels.rows;
+    m_featureMap = std::make_shared<PolySketch>(dimension, cvRound(m_svm->getDegree()), 
+                                                m_svm->getGamma(), m_svm->getCoef0());
+    m_svm->setKernel(SVM::LINEAR);
+    return true;
+}
 
-    //Display results of test
-    //std::cout << "SVM testing completed" << std::endl
-    //          << "Number of inputs: " << svmLabels.rows << std::endl
-    //          << "Number of errors: " << errors << std::endl
-    //          << "Percent error:    " << percentError << "%"
-    //          << std::endl;
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Cap the number of support vectors found by Train(), so the prediction 
+//  cost of the trained model is known in advance. Budgeted models are 
+//  trained with BudgetSolver instead of cv::ml::SVM (C_SVC with the 
+//  configured kernel, C and gamma) and are saved as the inference engine.
+//
+// PARAMETERS:
+//  maxSupportVectors - maximum number of support vectors (0 for no cap)
+//  scope - whether the cap applies to the model or to each class pair
+///////////////////////////////////////////////////////////////////////////////
+void Svm::SetBudget(int maxSupportVectors, BudgetSolver::Scope scope)
+{
+    m_budget = std::max(maxSupportVectors, 0);
+    m_budgetScope = scope;
+}
 
-    return percentError;
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Select the solver used by Train() when there is no support vector budget.
+//  Models trained with SmoSolver (C_SVC with the configured kernel, C and
+//  term criteria) are saved as the inference engine, like budgeted models.
+//
+// PARAMETERS:
+//  solver - cv::ml::SVM (default) or the parallel SMO solver
+//  cacheSizeMb - kernel row cache size of the SMO solver in megabytes
+///////////////////////////////////////////////////////////////////////////////
+void Svm::SetSolver(Solver solver, int cacheSizeMb)
+{
+    m_solver = solver;
+    m_cacheSizeMb = std::max(cacheSizeMb, 0);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Load an SVM model file
+//  Apply the explicit feature map (if any) to a feature matrix
 //
 // PARAMETERS:
-//  filename - path to SVM model file
+//  features - feature matrix (one CV_32FC1 feature set per row)
+//  mapped - reference to return the mapped features (may be features)
+///////////////////////////////////////////////////////////////////////////////
+void Svm::MapFeatures(const cv::Mat &features, cv::Mat &mapped) const
+{
+    if (m_featureMap)
+    {
+        Mat result;
+        m_featureMap->Map(features, result);
+        mapped = result;
+    }
+    else
+    {
+        mapped = features;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Train the inference engine within the support vector budget (see 
+//  SetBudget())
+//
+// PARAMETERS:
+//  features - feature matrix (one CV_32FC1 feature set per row)
+//  labels - label matrix (one CV_32SC1 label per row)
 //
 // RETURNS:
-//  true if model loaded successfully
+//  true if the SVM trained successfully
 ///////////////////////////////////////////////////////////////////////////////
-bool Svm::Load(const std::string &filename)
+bool Svm::TrainBudget(const cv::Mat &features, const cv::Mat &labels) const
 {
-    //Check if the SVM model file exists 
-    if (std::experimental::filesystem::exists(filename) == false)
+    if (m_svm->getType() != SVM::C_SVC)
     {
+        std::cout << "Budgeted training requires a C_SVC SVM" << std::endl;
         return false;
     }
 
-    //Load the SVM model
-    m_svm = StatModel::load<SVM>(filename);
+    BudgetSolver solver(SvmKernel(m_svm), m_svm->getC(), m_budget, m_budgetScope);
+    std::shared_ptr<SvmModel> model = std::make_shared<SvmModel>();
+    if (solver.Solve(features, labels, GetClassLabels(labels), *model) == false)
+    {
+        return false;
+    }
+
+    //Drop any previously trained OpenCV model (keeping its parameters) so the
+    //engine is used and saved
+    m_svm->clear();
+    SetModel(model);
+
     return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Save the current SVM model to a file
+//  Train the inference engine with the parallel SMO solver (see 
+//  SetSolver())
 //
 // PARAMETERS:
-//  filename - path for SVM model file
+//  features - feature matrix (one CV_32FC1 feature set per row)
+//  labels - label matrix (one CV_32SC1 label per row)
 //
 // RETURNS:
-//  true if model saved successfully
+//  true if the SVM trained successfully
 ///////////////////////////////////////////////////////////////////////////////
-bool Svm::Save(const std::string &filename) const
+bool Svm::TrainSmo(const cv::Mat &features, const cv::Mat &labels) const
 {
-    //Validate filename
-    if (filename.empty())
+    if (m_svm->getType() != SVM::C_SVC)
+    {
+        std::cout << "SMO training requires a C_SVC SVM" << std::endl;
+        return false;
+    }
+
+    SmoSolver solver(SvmKernel(m_svm), m_svm->getC(), m_svm->getTermCriteria());
+    solver.SetCacheSize(m_cacheSizeMb);
+    std::shared_ptr<SvmModel> model = std::make_shared<SvmModel>();
+    if (solver.Solve(features, labels, GetClassLabels(labels), *model) == false)
     {
         return false;
     }
 
-    //Save the model
-    m_svm->save(filename);
+    //Drop any previously trained OpenCV model (keeping its parameters) so the
+    //engine is used and saved
+    m_svm->clear();
+    SetModel(model);
+
     return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Set the SVM type
+//  Replace the support vectors used for prediction with a low rank 
+//  factorization SV ~= U * V. The factors are saved with the model. Empty 
+//  factors restore the full support vectors.
 //
 // PARAMETERS:
-//  type - SVM type
+//  u - support vectors x rank factor
+//  v - rank x features factor
+//
+// RETURNS:
+//  true if the factors were applied
 ///////////////////////////////////////////////////////////////////////////////
-void Svm::SetType(cv::ml::SVM::Types type) const
+bool Svm::SetLowRankFactors(const cv::Mat &u, const cv::Mat &v)
 {
-    m_svm->setType(type);
+    if (m_model == nullptr)
+    {
+        return false;
+    }
+
+    //Build a new engine so predictions in progress keep the current one
+    std::shared_ptr<SvmModel> model = std::make_shared<SvmModel>(*m_model);
+    if (u.empty())
+    {
+        m_lowRankU.release();
+        m_lowRankV.release();
+        CompileModel(model->GetClassLabels());
+        return true;
+    }
+
+    if (model->SetLowRank(u, v) == false)
+    {
+        return false;
+    }
+
+    m_lowRankU = u.clone();
+    m_lowRankV = v.clone();
+    SetModel(model);
+    return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Set the SVM kernel type
+//  Get the SVM gamma parameter
 //
-// PARAMETERS:
-//  kernel - SVM kernel type
+// RETURNS:
+//  SVM gamma parameter
 ///////////////////////////////////////////////////////////////////////////////
-void Svm::SetKernel(cv::ml::SVM::KernelTypes kernel) const
+double Svm::GetGamma() const
 {
-    m_svm->setKernel(kernel);
+    return m_svm->getGamma();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Set the SVM termination criteria
+//  Get the SVM C parameter
 //
-// PARAMETERS:
-//  termCriteria - SVM termination criteria
+// RETURNS:
+//  SVM C parameter
 ///////////////////////////////////////////////////////////////////////////////
-void Svm::SetTermCriteria(cv::TermCriteria termCriteria) const
+double Svm::GetC() const
 {
-    m_svm->setTermCriteria(termCriteria);    
+    return m_svm->getC();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Set the SVM gamma parameter
+//  Describe the inference engine of the model (e.g. to log after loading)
 //
-// PARAMETERS:
-//  gamma - SVM gamma parameter
+// RETURNS:
+//  Support vector count, layout, density and expected speedup, or an empty
+//  string if there is no inference engine
 ///////////////////////////////////////////////////////////////////////////////
-void Svm::SetGamma(double gamma) const
+std::string Svm::DescribeModel() const
 {
-    m_svm->setGamma(gamma);    
+    return m_model ? m_model->Describe() : std::string();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Set the SVM C parameter
+//  Check if there is a model to predict with
 //
-// PARAMETERS:
-//  c - SVM c parameter
+// RETURNS:
+//  true if the OpenCV model is trained or the inference engine is valid
 ///////////////////////////////////////////////////////////////////////////////
-void Svm::SetC(double c) const
-{    
-    m_svm->setC(c);
+bool Svm::IsTrained() const
+{
+    return m_svm->isTrained() || (m_model && m_model->IsValid());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Set the SVM degree parameter
+//  Get the support vectors of the trained model
+//
+// RETURNS:
+//  Support vector matrix (one support vector per row)
+///////////////////////////////////////////////////////////////////////////////
+cv::Mat Svm::GetSupportVectors() const
+{
+    //Models loaded without an OpenCV model only have the engine's copy
+    if (m_svm->isTrained() == false && m_model)
+    {
+        Mat supportVectors;
+        m_model->GetSupportVectors(supportVectors);
+        return supportVectors;
+    }
+
+    return m_svm->getSupportVectors();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Replace the support vectors used for prediction with product 
+//  quantization codes. Quantized models are saved without the full support 
+//  vectors so they are a fraction of the size, but can not be loaded by 
+//  OpenCV or trained further.
 //
 // PARAMETERS:
-//  degree - SVM degree parameter
+//  subspaceDim - number of features per subspace
+//  centroids - number of centroids per subspace (at most 256)
+//
+// RETURNS:
+//  true if the support vectors were quantized
 ///////////////////////////////////////////////////////////////////////////////
-void Svm::SetDegree(double degree) const
+bool Svm::QuantizeSupportVectors(int subspaceDim, int centroids)
 {
-    m_svm->setDegree(degree);
+    if (m_model == nullptr)
+    {
+        return false;
+    }
+
+    //Quantize the full support vectors when the OpenCV model still has them
+    std::shared_ptr<SvmModel> model = std::make_shared<SvmModel>();
+    if (model->Create(m_svm, m_model->GetClassLabels()) == false)
+    {
+        model = std::make_shared<SvmModel>(*m_model);
+    }
+
+    if (model->Quantize(subspaceDim, centroids) == false)
+    {
+        return false;
+    }
+
+    m_lowRankU.release();
+    m_lowRankV.release();
+    SetModel(model);
+    return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Set the SVM nu parameter
+//  Set how the support vectors used for prediction are placed in memory. 
+//  Huge pages reduce TLB misses when streaming the support vectors. NUMA 
+//  replicas keep one copy of the model on each node of a multi-socket 
+//  system and each prediction uses the copy local to the calling thread, so
+//  worker threads should be pinned to a node 
+//  (see ModelMemory::PinThreadToNumaNode).
 //
 // PARAMETERS:
-//  nu - SVM nu parameter
+//  hugePages - true to back the support vectors with huge pages
+//  numaReplicas - true to replicate the model on each NUMA node
 ///////////////////////////////////////////////////////////////////////////////
-void Svm::SetNu(double nu) const
+void Svm::SetMemoryPlacement(bool hugePages, bool numaReplicas)
 {
-    m_svm->setNu(nu);
+    m_hugePages = hugePages;
+    m_numaReplicas = numaReplicas;
+
+    //Place the current model
+    if (m_model)
+    {
+        SetModel(std::make_shared<SvmModel>(*m_model));
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // DESCRIPTION:
-//  Set the SVM P parameter
+//  Set the inference engine used for prediction, placing it in memory as 
+//  selected by SetMemoryPlacement()
 //
 // PARAMETERS:
-//  p - SVM P parameter
+//  model - inference engine (null if the OpenCV model should be used)
 ///////////////////////////////////////////////////////////////////////////////
-void Svm::SetP(double p) const
+void Svm::SetModel(const std::shared_ptr<SvmModel> &model) const
 {
-    m_svm->setP(p);
+    m_replicas.clear();
+
+    const int nodeCount = ModelMemory::GetNumaNodeCount();
+    if (model && m_numaReplicas && nodeCount > 1)
+    {
+        for (int node = 0; node < nodeCount; node++)
+        {
+            std::shared_ptr<SvmModel> replica = std::make_shared<SvmModel>(*model);
+            if (replica->Place(node, m_hugePages) == false)
+            {
+                std::cout << "Failed to place SVM model on NUMA node " << node << std::endl;
+            }
+            m_replicas.push_back(replica);
+        }
+    }
+    else if (model && m_hugePages)
+    {
+        if (model->Place(-1, true) == false)
+        {
+            std::cout << "Failed to place SVM model in huge pages" << std::endl;
+        }
+    }
+
+    m_model = model;
+    m_modelVersion++;
 }
@@ -16,6 +16,15 @@
 // Include Files
 ///////////////////////////////////////////////////////////////////////////////
 #include "opencv2/opencv.hpp"
+#include "SvmModel.h"
+#include "PolySketch.h"
+#include "BudgetSolver.h"
+#include "SmoSolver.h"
+#include "SgdSolver.h"
+#include "FeatureFile.h"
+
+#include <cstdint>
+#include <memory>
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -23,11 +32,44 @@
 ///////////////////////////////////////////////////////////////////////////////
 class Svm
 {
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Types
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    //Solver used by Train()
+    enum Solver
+    {
+        SOLVER_OPENCV, //cv::ml::SVM::train
+        SOLVER_SMO     //SmoSolver (parallel kernel rows)
+    };
+
+    //Result of one cross-validation fold
+    struct FoldResult
+    {
+        bool   trained;
+        int    trainSamples;
+        int    testSamples;
+        int    errors;
+        double trainSeconds;
+        double predictSeconds;
+    };
+
+    //Cross-validation results. The confusion matrix is summed over the 
+    //folds, with a row per true class and a column per predicted class in
+    //the order of the class labels.
+    struct CrossValidation
+    {
+        std::vector<FoldResult> folds;
+        std::vector<int>        classLabels;
+        cv::Mat                 confusion;   //CV_32SC1
+    };
+
     ///////////////////////////////////////////////////////////////////////////
     // Construction/Destruction
     ///////////////////////////////////////////////////////////////////////////
 public:
     Svm();
+    explicit Svm(const SvmModel::StaticModel &model);
     virtual ~Svm();
 
     ///////////////////////////////////////////////////////////////////////////
@@ -35,11 +77,21 @@ public:
     ///////////////////////////////////////////////////////////////////////////
 public:
     float Predict(const cv::Mat &features) const;
+    float Predict(const cv::Mat &features, SvmModel::Prediction &prediction) const;
+    void  PredictBatch(const cv::Mat &features, std::vector<SvmModel::Prediction> &predictions) const;
     bool  Train(const cv::Mat &features, const cv::Mat &labels) const;
     bool  TrainAuto(const cv::Mat &features, const cv::Mat &labels) const;
+    bool  TrainHalving(const cv::Mat &features, const cv::Mat &labels, int eta = 3) const;
+    bool  TrainFile(const std::string &filename, int chunkSize = 20000) const;
+    bool  CrossValidate(const cv::Mat &features, const cv::Mat &labels, int folds, int maxThreads, 
+                        CrossValidation &result) const;
+    bool  SelectCoreSet(const cv::Mat &features, const cv::Mat &labels, int chunkSize, std::vector<bool> &keep) const;
     float Test(const cv::Mat &features, const cv::Mat &labels) const;
     bool  Load(const std::string &filename);
+    bool  LoadXml(const std::string &filename);
     bool  Save(const std::string &filename) const;
+    bool  WriteSource(std::ostream &source, std::ostream &binary, const std::string &name,
+                      const std::string &binaryFilename) const;
     
     void  SetType(cv::ml::SVM::Types type) const;
     void  SetKernel(cv::ml::SVM::KernelTypes kernel) const;
@@ -49,12 +101,31 @@ public:
     void  SetDegree(double degree) const;
     void  SetNu(double nu) const;
     void  SetP(double p) const;
+    void  SetPredictMode(SvmModel::PredictMode mode);
+    bool  SetFeatureMap(int dimension);
+    void  SetBudget(int maxSupportVectors, BudgetSolver::Scope scope = BudgetSolver::BUDGET_GLOBAL);
+    void  SetSolver(Solver solver, int cacheSizeMb = 256);
+    bool  SetLowRankFactors(const cv::Mat &u, const cv::Mat &v);
+    bool  QuantizeSupportVectors(int subspaceDim, int centroids = 256);
+    void  SetMemoryPlacement(bool hugePages, bool numaReplicas);
+    std::string DescribeModel() const;
+    bool    IsTrained() const;
+    double  GetGamma() const;
+    double  GetC() const;
+    cv::Mat GetSupportVectors() const;
 
 
     ///////////////////////////////////////////////////////////////////////////
     // Protected Functions
     ///////////////////////////////////////////////////////////////////////////
 protected:
+    float PredictSample(const cv::Mat &sample, SvmModel::Prediction *prediction = nullptr) const;
+    void  CompileModel(const std::vector<int> &classLabels) const;
+    void  SetModel(const std::shared_ptr<SvmModel> &model) const;
+    const SvmModel *GetLocalModel() const;
+    void  MapFeatures(const cv::Mat &features, cv::Mat &mapped) const;
+    bool  TrainBudget(const cv::Mat &features, const cv::Mat &labels) const;
+    bool  TrainSmo(const cv::Mat &features, const cv::Mat &labels) const;
 
     ///////////////////////////////////////////////////////////////////////////
     // Protected Variables
@@ -62,4 +133,32 @@ protected:
 protected:
     cv::Ptr<cv::ml::SVM> m_svm;
 
+    //Inference engine built from m_svm after training or loading
+    mutable std::shared_ptr<const SvmModel> m_model;
+    SvmModel::PredictMode m_predictMode;
+
+    //Incremented whenever predictions may change (new model or predict mode)
+    mutable std::uint64_t m_modelVersion;
+
+    //Memory placement of the inference engine (one replica per NUMA node)
+    bool m_hugePages;
+    bool m_numaReplicas;
+    mutable std::vector<std::shared_ptr<const SvmModel>> m_replicas;
+
+    //Optional explicit feature map applied before the (linear) SVM
+    std::shared_ptr<PolySketch> m_featureMap;
+
+    //Optional low rank factors (U * V) replacing the support vectors
+    mutable cv::Mat m_lowRankU;
+    mutable cv::Mat m_lowRankV;
+
+    //Optional cap on the number of support vectors found by training (0 for
+    //no cap, training with cv::ml::SVM)
+    int                 m_budget;
+    BudgetSolver::Scope m_budgetScope;
+
+    //Solver used when there is no budget, and its kernel cache size in MB
+    Solver m_solver;
+    int    m_cacheSizeMb;
+
 };
\ No newline at end of file
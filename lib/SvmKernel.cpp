@@ -0,0 +1,159 @@
+/******************************************************************************
+
+    FILENAME:       SvmKernel.cpp
+
+    DESCRIPTION:    Kernel function of an SVM evaluated between two dense 
+                    feature vectors, computed the same way as cv::ml::SVM so 
+                    coefficients found by the solvers in this library can be 
+                    used with OpenCV's kernel parameters
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "SvmKernel.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace cv;
+using namespace ml;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Default constructor (linear kernel)
+///////////////////////////////////////////////////////////////////////////////
+SvmKernel::SvmKernel() :
+    m_type(SVM::LINEAR),
+    m_gamma(0),
+    m_coef0(0),
+    m_degree(0)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Constructor for the kernel configured on an OpenCV SVM
+//
+// PARAMETERS:
+//  svm - OpenCV SVM with the kernel type and parameters set
+///////////////////////////////////////////////////////////////////////////////
+SvmKernel::SvmKernel(const Ptr<SVM> &svm) :
+    m_type(svm->getKernelType()),
+    m_gamma(svm->getGamma()),
+    m_coef0(svm->getCoef0()),
+    m_degree(svm->getDegree())
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+SvmKernel::~SvmKernel()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Evaluate the kernel function between two feature vectors
+//
+// PARAMETERS:
+//  a - first feature vector
+//  b - second feature vector
+//  count - number of features
+//
+// RETURNS:
+//  Kernel value
+///////////////////////////////////////////////////////////////////////////////
+double SvmKernel::Evaluate(const float *a, const float *b, int count) const
+{
+    switch (m_type)
+    {
+    case SVM::RBF:
+        return std::exp(-m_gamma * SimdKernels::SquaredDistance(a, b, count));
+
+    case SVM::CHI2:
+    {
+        double s = 0;
+        for (int k = 0; k < count; k++)
+        {
+            const double d = a[k] - b[k];
+            const double divisor = a[k] + b[k];
+            if (divisor != 0)
+            {
+                s += d * d / divisor;
+            }
+        }
+        return std::exp(-m_gamma * s);
+    }
+
+    case SVM::INTER:
+    {
+        double s = 0;
+        for (int k = 0; k < count; k++)
+        {
+            s += std::min(a[k], b[k]);
+        }
+        return s;
+    }
+
+    default:
+        break;
+    }
+
+    //Remaining kernels are functions of the dot product
+    const double s = SimdKernels::DotProduct(a, b, count);
+
+    switch (m_type)
+    {
+    case SVM::POLY:
+        return std::pow(m_gamma * s + m_coef0, m_degree);
+
+    case SVM::SIGMOID:
+        return std::tanh(-(m_gamma * s + m_coef0));
+
+    default:
+        return s;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Check the kernel can be evaluated (custom kernels can not)
+//
+// RETURNS:
+//  true if the kernel is one of OpenCV's built in kernels
+///////////////////////////////////////////////////////////////////////////////
+bool SvmKernel::IsSupported() const
+{
+    return m_type != SVM::CUSTOM;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the kernel parameters
+//
+// RETURNS:
+//  Kernel type (cv::ml::SVM::KernelTypes), gamma, coef0 or degree
+///////////////////////////////////////////////////////////////////////////////
+int SvmKernel::GetType() const
+{
+    return m_type;
+}
+
+double SvmKernel::GetGamma() const
+{
+    return m_gamma;
+}
+
+double SvmKernel::GetCoef0() const
+{
+    return m_coef0;
+}
+
+double SvmKernel::GetDegree() const
+{
+    return m_degree;
+}
@@ -0,0 +1,57 @@
+/******************************************************************************
+
+    FILENAME:       SvmKernel.h
+
+    DESCRIPTION:    Kernel function of an SVM evaluated between two dense 
+                    feature vectors, computed the same way as cv::ml::SVM so 
+                    coefficients found by the solvers in this library can be 
+                    used with OpenCV's kernel parameters
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class SvmKernel
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    SvmKernel();
+    explicit SvmKernel(const cv::Ptr<cv::ml::SVM> &svm);
+    virtual ~SvmKernel();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    double Evaluate(const float *a, const float *b, int count) const;
+    bool   IsSupported() const;
+
+    int    GetType() const;
+    double GetGamma() const;
+    double GetCoef0() const;
+    double GetDegree() const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    int    m_type;
+    double m_gamma;
+    double m_coef0;
+    double m_degree;
+
+};
@@ -0,0 +1,1676 @@
+/******************************************************************************
+
+    FILENAME:       SvmModel.cpp
+
+    DESCRIPTION:    Inference engine for a trained SVM. The support vectors and
+                    one-vs-one decision functions of an OpenCV SVM model are
+                    copied into flat arrays so that prediction can be done
+                    without going through cv::ml::SVM::predict
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "SvmModel.h"
+#include "ModelMemory.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace cv;
+using namespace ml;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Default constructor
+///////////////////////////////////////////////////////////////////////////////
+SvmModel::SvmModel() :
+    m_kernelType(SVM::LINEAR),
+    m_gamma(0),
+    m_coef0(0),
+    m_degree(0),
+    m_varCount(0),
+    m_svCount(0),
+    m_layout(LAYOUT_DENSE),
+    m_density(1.0),
+    m_sparseSpeedup(1.0),
+    m_pqSubspaceDim(0),
+    m_pqCentroids(0)
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+SvmModel::~SvmModel()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Copy the support vectors and decision functions of a trained OpenCV SVM
+//  classifier into the model.
+//
+// PARAMETERS:
+//  svm - trained OpenCV SVM (C_SVC or NU_SVC)
+//  classLabels - sorted class labels the SVM was trained with
+//
+// RETURNS:
+//  true if the model was created successfully
+///////////////////////////////////////////////////////////////////////////////
+bool SvmModel::Create(const Ptr<SVM> &svm, const std::vector<int> &classLabels)
+{
+    //Only classification models with built in kernels are supported
+    if (svm.empty() || svm->isTrained() == false ||
+        (svm->getType() != SVM::C_SVC && svm->getType() != SVM::NU_SVC) ||
+        svm->getKernelType() == SVM::CUSTOM || classLabels.size() < 2)
+    {
+        return false;
+    }
+
+    m_kernelType = svm->getKernelType();
+    m_gamma      = svm->getGamma();
+    m_coef0      = svm->getCoef0();
+    m_degree     = svm->getDegree();
+    m_varCount   = svm->getVarCount();
+    m_classLabels = classLabels;
+
+    //Support vectors are stored compressed for linear SVMs (one per decision function)
+    svm->getSupportVectors().convertTo(m_supportVectors, CV_32FC1);
+    m_svCount = m_supportVectors.rows;
+
+    //Copy the coefficients of each one-vs-one decision function
+    const int classCount = static_cast<int>(m_classLabels.size());
+    const int dfCount = classCount * (classCount - 1) / 2;
+
+    m_decisionFunctions.clear();
+    m_alpha.clear();
+    m_index.clear();
+
+    for (int i = 0; i < dfCount; i++)
+    {
+        Mat alpha, svIndex;
+        DecisionFunction df;
+        df.rho    = svm->getDecisionFunction(i, alpha, svIndex);
+        df.offset = static_cast<int>(m_alpha.size());
+        df.count  = static_cast<int>(svIndex.total());
+
+        for (int k = 0; k < df.count; k++)
+        {
+            m_alpha.push_back(alpha.at<double>(k));
+            m_index.push_back(svIndex.at<int>(k));
+        }
+
+        m_decisionFunctions.push_back(df);
+    }
+
+    //Switch to a sparse layout if the support vectors are mostly zeros
+    ChooseLayout();
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Create the model from support vectors and one-vs-one decision functions
+//  found by a solver other than cv::ml::SVM (e.g. BudgetSolver)
+//
+// PARAMETERS:
+//  kernel - kernel function the coefficients were found with
+//  supportVectors - support vectors (one CV_32FC1 row per support vector)
+//  decisionFunctions - decision functions ordered (0,1), (0,2) ... (n-2,n-1)
+//  alpha - coefficients of all decision functions
+//  index - support vector index of each coefficient
+//  classLabels - sorted class labels
+//
+// RETURNS:
+//  true if the model was created successfully
+///////////////////////////////////////////////////////////////////////////////
+bool SvmModel::Create(const SvmKernel &kernel, const Mat &supportVectors, 
+                      const std::vector<DecisionFunction> &decisionFunctions, const std::vector<double> &alpha,
+                      const std::vector<int> &index, const std::vector<int> &classLabels)
+{
+    const size_t classCount = classLabels.size();
+    if (kernel.IsSupported() == false || supportVectors.type() != CV_32FC1 || classCount < 2 ||
+        decisionFunctions.size() != classCount * (classCount - 1) / 2 || alpha.size() != index.size())
+    {
+        return false;
+    }
+
+    for (int sv : index)
+    {
+        if (sv < 0 || sv >= supportVectors.rows)
+        {
+            return false;
+        }
+    }
+
+    m_kernelType = kernel.GetType();
+    m_gamma      = kernel.GetGamma();
+    m_coef0      = kernel.GetCoef0();
+    m_degree     = kernel.GetDegree();
+    m_varCount   = supportVectors.cols;
+    m_classLabels = classLabels;
+
+    m_supportVectors = supportVectors.clone();
+    m_svCount = m_supportVectors.rows;
+    m_placedMemory.reset();
+
+    m_decisionFunctions = decisionFunctions;
+    m_alpha = alpha;
+    m_index = index;
+
+    //Switch to a sparse layout if the support vectors are mostly zeros
+    ChooseLayout();
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Predict the class of a sample
+//
+// PARAMETERS:
+//  sample - pointer to the sample features (GetVarCount() values, checked 
+//           by the caller)
+//  mode - method used to combine the one-vs-one decision functions
+//  prediction - optional pointer to return the votes and decision values
+//
+// RETURNS:
+//  Predicted class label
+///////////////////////////////////////////////////////////////////////////////
+float SvmModel::Predict(const float *sample, PredictMode mode, Prediction *prediction) const
+{
+    if (prediction != nullptr)
+    {
+        prediction->votes.assign(m_classLabels.size(), 0);
+        prediction->margins.assign(m_classLabels.size(), 0.0f);
+    }
+
+    //Compressed layouts compute dot products from a transformed sample
+    std::vector<float> buffer;
+    sample = PrepareSample(sample, buffer);
+
+    float label = (mode == PREDICT_DAG) ? PredictDag(sample, prediction) : 
+                                          PredictVote(sample, prediction);
+
+    if (prediction != nullptr)
+    {
+        prediction->label = label;
+        prediction->decision = prediction->margins[1];
+    }
+
+    return label;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Predict the classes of a batch of samples. In voting mode the dot 
+//  products of all samples with all support vectors of the dense and low 
+//  rank layouts are computed with a single matrix multiply (gemm), which is
+//  much faster than one sample at a time. Other layouts, kernels and DAG 
+//  mode predict each sample in parallel.
+//
+// PARAMETERS:
+//  samples - sample matrix (one CV_32FC1 sample per row)
+//  mode - voting or DAG prediction
+//  predictions - reference to return the prediction of each sample
+///////////////////////////////////////////////////////////////////////////////
+void SvmModel::PredictBatch(const Mat &samples, PredictMode mode, std::vector<Prediction> &predictions) const
+{
+    CV_Assert(samples.type() == CV_32FC1 && samples.cols == m_varCount);
+
+    predictions.resize(samples.rows);
+
+    const bool dotKernel = (m_kernelType == SVM::LINEAR || m_kernelType == SVM::POLY || 
+                            m_kernelType == SVM::SIGMOID);
+    const bool batchLayout = (m_layout == LAYOUT_DENSE && (dotKernel || m_kernelType == SVM::RBF)) ||
+                             (m_layout == LAYOUT_LOW_RANK && dotKernel);
+
+    if (mode == PREDICT_DAG || batchLayout == false || samples.isContinuous() == false)
+    {
+        parallel_for_(Range(0, samples.rows), [&](const Range &range)
+        {
+            for (int i = range.start; i < range.end; i++)
+            {
+                Predict(samples.ptr<float>(i), mode, &predictions[i]);
+            }
+        });
+        return;
+    }
+
+    //Dot products of each sample (row) with each support vector (column)
+    Mat dots;
+    if (m_layout == LAYOUT_LOW_RANK)
+    {
+        Mat projected;
+        gemm(samples, m_lowRankV, 1.0, noArray(), 0.0, projected, GEMM_2_T);
+        gemm(projected, m_lowRankU, 1.0, noArray(), 0.0, dots, GEMM_2_T);
+    }
+    else
+    {
+        gemm(samples, m_supportVectors, 1.0, noArray(), 0.0, dots, GEMM_2_T);
+    }
+
+    //Squared norms for the RBF distance |x - sv|^2 = |x|^2 + |sv|^2 - 2 x.sv
+    std::vector<double> svNorms;
+    if (m_kernelType == SVM::RBF)
+    {
+        svNorms.resize(m_svCount);
+        for (int k = 0; k < m_svCount; k++)
+        {
+            svNorms[k] = m_supportVectors.row(k).dot(m_supportVectors.row(k));
+        }
+    }
+
+    //Apply the kernel function and vote for each sample
+    parallel_for_(Range(0, samples.rows), [&](const Range &range)
+    {
+        std::vector<double> kernel(m_svCount);
+        for (int i = range.start; i < range.end; i++)
+        {
+            const float *dot = dots.ptr<float>(i);
+            const double sampleNorm = svNorms.empty() ? 0 : samples.row(i).dot(samples.row(i));
+
+            for (int k = 0; k < m_svCount; k++)
+            {
+                switch (m_kernelType)
+                {
+                case SVM::RBF:
+                    kernel[k] = std::exp(-m_gamma * std::max(0.0, sampleNorm + svNorms[k] - 2.0 * dot[k]));
+                    break;
+                case SVM::POLY:
+                    kernel[k] = std::pow(m_gamma * dot[k] + m_coef0, m_degree);
+                    break;
+                case SVM::SIGMOID:
+                    kernel[k] = std::tanh(-(m_gamma * dot[k] + m_coef0));
+                    break;
+                default:
+                    kernel[k] = dot[k];
+                    break;
+                }
+            }
+
+            Prediction &prediction = predictions[i];
+            prediction.votes.assign(m_classLabels.size(), 0);
+            prediction.margins.assign(m_classLabels.size(), 0.0f);
+            prediction.label = Vote(kernel.data(), &prediction);
+            prediction.decision = prediction.margins[1];
+        }
+    });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Replace the support vectors with a low rank factorization SV ~= U * V 
+//  (e.g. a truncated SVD). Each dot product x.sv then becomes (V * x).u, so
+//  a prediction costs rank * (features + support vectors) multiply-adds 
+//  instead of features * support vectors. Only kernels of the dot product 
+//  can use the factorization.
+//
+// PARAMETERS:
+//  u - support vectors x rank factor (CV_32FC1)
+//  v - rank x features factor (CV_32FC1)
+//
+// RETURNS:
+//  true if the factorization was applied
+///////////////////////////////////////////////////////////////////////////////
+bool SvmModel::SetLowRank(const Mat &u, const Mat &v)
+{
+    const bool dotKernel = (m_kernelType == SVM::LINEAR || m_kernelType == SVM::POLY || 
+                            m_kernelType == SVM::SIGMOID);
+    if (dotKernel == false || u.rows != m_svCount || v.cols != m_varCount || u.cols != v.rows)
+    {
+        return false;
+    }
+
+    u.convertTo(m_lowRankU, CV_32FC1);
+    v.convertTo(m_lowRankV, CV_32FC1);
+
+    //The factors replace the full support vectors
+    m_supportVectors.release();
+    m_svValues.release();
+    m_svColumns.release();
+    m_svRowStart.release();
+    m_pqCodebooks.release();
+    m_pqCodes.release();
+    m_layout = LAYOUT_LOW_RANK;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Replace the support vectors with product quantization codes. The 
+//  features are split into subspaces and the support vectors of each 
+//  subspace are clustered into a codebook of centroids. Each support vector
+//  is then stored as one byte per subspace. A prediction builds a small 
+//  lookup table of sample/centroid dot products once and computes each 
+//  support vector dot product with one table lookup per subspace. Only 
+//  kernels of the dot product can use the quantization.
+//
+// PARAMETERS:
+//  subspaceDim - number of features per subspace
+//  centroids - number of centroids per subspace (at most 256)
+//
+// RETURNS:
+//  true if the support vectors were quantized
+///////////////////////////////////////////////////////////////////////////////
+bool SvmModel::Quantize(int subspaceDim, int centroids)
+{
+    const bool dotKernel = (m_kernelType == SVM::LINEAR || m_kernelType == SVM::POLY || 
+                            m_kernelType == SVM::SIGMOID);
+    if (dotKernel == false || subspaceDim < 1 || centroids < 2 || centroids > 256 || 
+        centroids > m_svCount || IsValid() == false)
+    {
+        return false;
+    }
+
+    Mat supportVectors;
+    GetSupportVectors(supportVectors);
+
+    const int subspaces = (m_varCount + subspaceDim - 1) / subspaceDim;
+    Mat codebooks = Mat::zeros(subspaces * centroids, subspaceDim, CV_32FC1);
+    Mat codes(m_svCount, subspaces, CV_8UC1);
+
+    //Subspaces are clustered independently
+    parallel_for_(Range(0, subspaces), [&](const Range &range)
+    {
+        for (int m = range.start; m < range.end; m++)
+        {
+            const int first = m * subspaceDim;
+            const int dim = std::min(subspaceDim, m_varCount - first);
+
+            Mat data = supportVectors.colRange(first, first + dim).clone();
+            Mat labels, centers;
+            kmeans(data, centroids, labels, 
+                   TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, 20, 1e-4), 
+                   1, KMEANS_PP_CENTERS, centers);
+
+            for (int c = 0; c < centroids; c++)
+            {
+                centers.row(c).copyTo(codebooks.row(m * centroids + c).colRange(0, dim));
+            }
+
+            for (int i = 0; i < m_svCount; i++)
+            {
+                codes.at<uchar>(i, m) = static_cast<uchar>(labels.at<int>(i));
+            }
+        }
+    });
+
+    m_pqSubspaceDim = subspaceDim;
+    m_pqCentroids = centroids;
+    m_pqCodebooks = codebooks;
+    m_pqCodes = codes;
+
+    //The codes replace the full support vectors
+    m_supportVectors.release();
+    m_svValues.release();
+    m_svColumns.release();
+    m_svRowStart.release();
+    m_lowRankU.release();
+    m_lowRankV.release();
+    m_layout = LAYOUT_PRODUCT_QUANTIZED;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Move the support vector buffers into memory on a NUMA node and/or backed
+//  by huge pages. Copies of the model made before this call keep using the
+//  previous memory, so one copy can be placed on each node.
+//
+// PARAMETERS:
+//  numaNode - NUMA node for the buffers (-1 for no preference)
+//  hugePages - true to back the buffers with huge pages
+//
+// RETURNS:
+//  true if the buffers were moved
+///////////////////////////////////////////////////////////////////////////////
+bool SvmModel::Place(int numaNode, bool hugePages)
+{
+    Mat *buffers[] = { &m_supportVectors, &m_svValues, &m_svColumns, &m_svRowStart,
+                       &m_lowRankU, &m_lowRankV, &m_pqCodebooks, &m_pqCodes };
+
+    //Each buffer starts on a cache line
+    const size_t alignment = 64;
+    size_t size = 0;
+    for (Mat *buffer : buffers)
+    {
+        size += (buffer->total() * buffer->elemSize() + alignment - 1) / alignment * alignment;
+    }
+
+    std::shared_ptr<void> memory = ModelMemory::Allocate(size, numaNode, hugePages);
+    if (memory == nullptr)
+    {
+        return false;
+    }
+
+    //Copy each buffer into the new memory (the copy also places the pages)
+    uchar *next = static_cast<uchar*>(memory.get());
+    for (Mat *buffer : buffers)
+    {
+        if (buffer->empty())
+        {
+            continue;
+        }
+
+        Mat placed(buffer->rows, buffer->cols, buffer->type(), next);
+        buffer->copyTo(placed);
+        *buffer = placed;
+
+        next += (placed.total() * placed.elemSize() + alignment - 1) / alignment * alignment;
+    }
+
+    m_placedMemory = memory;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Use a model compiled into the executable (see WriteSource()). The 
+//  support vector buffers are used in place without copying, so they are
+//  paged in from the executable on demand and shared by every process 
+//  running it. Only the small decision function arrays are copied.
+//
+// PARAMETERS:
+//  model - compiled model (must outlive this object)
+//
+// RETURNS:
+//  true if the model is valid
+///////////////////////////////////////////////////////////////////////////////
+bool SvmModel::Wrap(const StaticModel &model)
+{
+    const int dfCount = model.classCount * (model.classCount - 1) / 2;
+    if (model.classCount < 2 || model.classLabels == nullptr || model.decisionFunctions == nullptr ||
+        model.coefficientCount < 0 || model.alpha == nullptr || model.index == nullptr)
+    {
+        return false;
+    }
+
+    m_kernelType = model.kernelType;
+    m_gamma      = model.gamma;
+    m_coef0      = model.coef0;
+    m_degree     = model.degree;
+    m_varCount   = model.varCount;
+    m_svCount    = model.svCount;
+    m_layout     = model.layout;
+    m_density    = model.density;
+    m_classLabels.assign(model.classLabels, model.classLabels + model.classCount);
+    m_decisionFunctions.assign(model.decisionFunctions, model.decisionFunctions + dfCount);
+    m_alpha.assign(model.alpha, model.alpha + model.coefficientCount);
+    m_index.assign(model.index, model.index + model.coefficientCount);
+
+    if (m_varCount <= 0 || m_svCount < 0)
+    {
+        return false;
+    }
+
+    //Wrap the read-only buffers (never written by the engine)
+    m_supportVectors.release();
+    m_svValues.release();
+    m_svColumns.release();
+    m_svRowStart.release();
+    m_lowRankU.release();
+    m_lowRankV.release();
+    m_pqCodebooks.release();
+    m_pqCodes.release();
+    m_placedMemory.reset();
+
+    switch (m_layout)
+    {
+    case LAYOUT_SPARSE:
+        if (model.nonZeroCount < 0 || model.svRowStart == nullptr ||
+            (model.nonZeroCount > 0 && (model.svValues == nullptr || model.svColumns == nullptr)))
+        {
+            return false;
+        }
+        m_svValues   = Mat(model.nonZeroCount, 1, CV_32FC1, const_cast<float*>(model.svValues));
+        m_svColumns  = Mat(model.nonZeroCount, 1, CV_32SC1, const_cast<int*>(model.svColumns));
+        m_svRowStart = Mat(m_svCount + 1, 1, CV_32SC1, const_cast<int*>(model.svRowStart));
+        break;
+
+    case LAYOUT_LOW_RANK:
+        if (model.rank <= 0 || model.lowRankV == nullptr || (m_svCount > 0 && model.lowRankU == nullptr))
+        {
+            return false;
+        }
+        m_lowRankU = Mat(m_svCount, model.rank, CV_32FC1, const_cast<float*>(model.lowRankU));
+        m_lowRankV = Mat(model.rank, m_varCount, CV_32FC1, const_cast<float*>(model.lowRankV));
+        break;
+
+    case LAYOUT_PRODUCT_QUANTIZED:
+    {
+        if (model.pqSubspaceDim <= 0 || model.pqCentroids <= 0 || model.pqCentroids > 256 || 
+            model.pqCodebooks == nullptr || (m_svCount > 0 && model.pqCodes == nullptr))
+        {
+            return false;
+        }
+
+        //The last subspace is partial when the dimension does not divide the
+        //number of features (as in Quantize())
+        m_pqSubspaceDim = model.pqSubspaceDim;
+        m_pqCentroids   = model.pqCentroids;
+        const int subspaces = (m_varCount + m_pqSubspaceDim - 1) / m_pqSubspaceDim;
+        m_pqCodebooks = Mat(subspaces * m_pqCentroids, m_pqSubspaceDim, CV_32FC1, 
+                            const_cast<float*>(model.pqCodebooks));
+        m_pqCodes = Mat(m_svCount, subspaces, CV_8UC1, 
+                        const_cast<unsigned char*>(model.pqCodes));
+        break;
+    }
+
+    case LAYOUT_DENSE:
+        if (m_svCount > 0 && model.supportVectors == nullptr)
+        {
+            return false;
+        }
+        m_supportVectors = Mat(m_svCount, m_varCount, CV_32FC1, const_cast<float*>(model.supportVectors));
+        break;
+
+    default:
+        return false;
+    }
+
+    return IsConsistent();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Write the model to a file storage node. Unlike an OpenCV model file the 
+//  support vectors are written in the current layout, so compressed models 
+//  stay compressed on disk.
+//
+// PARAMETERS:
+//  fs - file storage opened for writing (inside a map node)
+///////////////////////////////////////////////////////////////////////////////
+void SvmModel::Write(FileStorage &fs) const
+{
+    fs << "kernel_type" << m_kernelType;
+    fs << "gamma" << m_gamma;
+    fs << "coef0" << m_coef0;
+    fs << "degree" << m_degree;
+    fs << "var_count" << m_varCount;
+    fs << "sv_count" << m_svCount;
+    fs << "class_labels" << m_classLabels;
+
+    //Decision functions
+    std::vector<double> rho;
+    std::vector<int> offset, count;
+    for (const auto &df : m_decisionFunctions)
+    {
+        rho.push_back(df.rho);
+        offset.push_back(df.offset);
+        count.push_back(df.count);
+    }
+    fs << "rho" << rho;
+    fs << "df_offset" << offset;
+    fs << "df_count" << count;
+    fs << "alpha" << m_alpha;
+    fs << "index" << m_index;
+
+    //Support vectors
+    fs << "layout" << static_cast<int>(m_layout);
+    switch (m_layout)
+    {
+    case LAYOUT_SPARSE:
+        fs << "sv_values" << m_svValues;
+        fs << "sv_columns" << m_svColumns;
+        fs << "sv_row_start" << m_svRowStart;
+        break;
+
+    case LAYOUT_LOW_RANK:
+        fs << "u" << m_lowRankU;
+        fs << "v" << m_lowRankV;
+        break;
+
+    case LAYOUT_PRODUCT_QUANTIZED:
+        fs << "subspace_dim" << m_pqSubspaceDim;
+        fs << "centroids" << m_pqCentroids;
+        fs << "codebooks" << m_pqCodebooks;
+        fs << "codes" << m_pqCodes;
+        break;
+
+    default:
+        fs << "support_vectors" << m_supportVectors;
+        break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Write the model as C++ source defining a SvmModel::StaticModel, so the
+//  model can be compiled into an executable and used with Wrap() without
+//  a file to load. The buffers are written to a separate binary file that
+//  the generated source embeds with the assembler's .incbin directive (GCC
+//  and Clang, ELF targets), so only the small descriptor is C++ source.
+//
+// PARAMETERS:
+//  source - stream to write the source to
+//  binary - stream to write the buffers to
+//  name - name of the StaticModel variable (prefix of the buffer symbols)
+//  binaryFilename - path of the binary file as seen by the assembler
+//
+// RETURNS:
+//  true if the source and binary were written
+///////////////////////////////////////////////////////////////////////////////
+bool SvmModel::WriteSource(std::ostream &source, std::ostream &binary, const std::string &name,
+                           const std::string &binaryFilename) const
+{
+    //The path is written inside a string literal inside an assembler string
+    if (IsValid() == false || binaryFilename.find_first_of("\"\\\n") != std::string::npos)
+    {
+        return false;
+    }
+
+    std::ostringstream declarations;
+    std::ostringstream assembly;
+    size_t offset = 0;
+
+    //Append a buffer to the binary file and define a symbol for its slice
+    auto embed = [&](const char *type, const std::string &symbol, const void *data, size_t bytes)
+    {
+        if (bytes == 0)
+        {
+            return std::string("nullptr");
+        }
+
+        binary.write(static_cast<const char*>(data), bytes);
+
+        declarations << "    extern const " << type << " " << symbol << "[];\n";
+
+        //Cache line aligned so buffers can be streamed with aligned loads
+        assembly << "    \"\\t.balign 64\\n\"\n"
+                 << "    \"\\t.global " << symbol << "\\n\"\n"
+                 << "    \"" << symbol << ":\\n\"\n"
+                 << "    \"\\t.incbin \\\"" << binaryFilename << "\\\", " << offset << ", " << bytes << "\\n\"\n";
+
+        offset += bytes;
+        return symbol;
+    };
+
+    auto embedMat = [&](const char *type, const char *suffix, const Mat &buffer)
+    {
+        const Mat data = buffer.isContinuous() ? buffer : buffer.clone();
+        return embed(type, name + suffix, data.data, data.total() * data.elemSize());
+    };
+
+    const std::string supportVectors = embedMat("float", "SupportVectors", m_supportVectors);
+    const std::string svValues       = embedMat("float", "SvValues", m_svValues);
+    const std::string svColumns      = embedMat("int", "SvColumns", m_svColumns);
+    const std::string svRowStart     = embedMat("int", "SvRowStart", m_svRowStart);
+    const std::string lowRankU       = embedMat("float", "LowRankU", m_lowRankU);
+    const std::string lowRankV       = embedMat("float", "LowRankV", m_lowRankV);
+    const std::string pqCodebooks    = embedMat("float", "PqCodebooks", m_pqCodebooks);
+    const std::string pqCodes        = embedMat("unsigned char", "PqCodes", m_pqCodes);
+    const std::string classLabels    = embed("int", name + "ClassLabels", m_classLabels.data(),
+                                             m_classLabels.size() * sizeof(int));
+    const std::string dfs            = embed("SvmModel::DecisionFunction", name + "DecisionFunctions",
+                                             m_decisionFunctions.data(),
+                                             m_decisionFunctions.size() * sizeof(DecisionFunction));
+    const std::string alpha          = embed("double", name + "Alpha", m_alpha.data(), m_alpha.size() * sizeof(double));
+    const std::string index          = embed("int", name + "Index", m_index.data(), m_index.size() * sizeof(int));
+
+    const char *layouts[] = { "LAYOUT_DENSE", "LAYOUT_SPARSE", "LAYOUT_LOW_RANK", "LAYOUT_PRODUCT_QUANTIZED" };
+
+    source << "#if defined(_MSC_VER) || defined(__APPLE__)\n"
+           << "#error Compiled models are embedded with .incbin and need GCC or Clang on an ELF target\n"
+           << "#endif\n\n"
+           << "//Buffers embedded from " << binaryFilename << " (" << offset << " bytes)\n"
+           << "extern \"C\"\n{\n" << declarations.str() << "}\n\n"
+           << "__asm__(\n"
+           << "    \"\\t.section .rodata\\n\"\n"
+           << assembly.str()
+           << "    \"\\t.previous\\n\");\n\n";
+
+    source << "extern const SvmModel::StaticModel " << name << " =\n{\n" << std::hexfloat
+           << "    " << m_kernelType << ", " << m_gamma << ", " << m_coef0 << ", " << m_degree << ",\n"
+           << "    " << m_varCount << ", " << m_svCount << ", " << GetClassCount() << ",\n"
+           << "    SvmModel::" << layouts[m_layout] << ", " << m_density << ",\n"
+           << std::defaultfloat
+           << "    " << supportVectors << ",\n"
+           << "    " << m_svValues.rows << ", " << svValues << ", " << svColumns << ", " << svRowStart << ",\n"
+           << "    " << m_lowRankV.rows << ", " << lowRankU << ", " << lowRankV << ",\n"
+           << "    " << m_pqSubspaceDim << ", " << m_pqCentroids << ", " << pqCodebooks << ", " << pqCodes << ",\n"
+           << "    " << classLabels << ", " << dfs << ",\n"
+           << "    " << m_alpha.size() << ", " << alpha << ", " << index << "\n"
+           << "};\n";
+
+    return source.good() && binary.good();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Read a model written by Write()
+//
+// PARAMETERS:
+//  node - file storage node written by Write()
+//
+// RETURNS:
+//  true if the model was read successfully
+///////////////////////////////////////////////////////////////////////////////
+bool SvmModel::Read(const FileNode &node)
+{
+    if (node.empty())
+    {
+        return false;
+    }
+
+    m_kernelType = static_cast<int>(node["kernel_type"]);
+    m_gamma      = static_cast<double>(node["gamma"]);
+    m_coef0      = static_cast<double>(node["coef0"]);
+    m_degree     = static_cast<double>(node["degree"]);
+    m_varCount   = static_cast<int>(node["var_count"]);
+    m_svCount    = static_cast<int>(node["sv_count"]);
+    node["class_labels"] >> m_classLabels;
+
+    std::vector<double> rho;
+    std::vector<int> offset, count;
+    node["rho"] >> rho;
+    node["df_offset"] >> offset;
+    node["df_count"] >> count;
+    node["alpha"] >> m_alpha;
+    node["index"] >> m_index;
+
+    m_decisionFunctions.clear();
+    for (size_t i = 0; i < rho.size() && i < offset.size() && i < count.size(); i++)
+    {
+        DecisionFunction df;
+        df.rho    = rho[i];
+        df.offset = offset[i];
+        df.count  = count[i];
+        m_decisionFunctions.push_back(df);
+    }
+
+    m_layout = static_cast<Layout>(static_cast<int>(node["layout"]));
+    switch (m_layout)
+    {
+    case LAYOUT_SPARSE:
+        node["sv_values"] >> m_svValues;
+        node["sv_columns"] >> m_svColumns;
+        node["sv_row_start"] >> m_svRowStart;
+        break;
+
+    case LAYOUT_LOW_RANK:
+        node["u"] >> m_lowRankU;
+        node["v"] >> m_lowRankV;
+        break;
+
+    case LAYOUT_PRODUCT_QUANTIZED:
+        m_pqSubspaceDim = static_cast<int>(node["subspace_dim"]);
+        m_pqCentroids   = static_cast<int>(node["centroids"]);
+        node["codebooks"] >> m_pqCodebooks;
+        node["codes"] >> m_pqCodes;
+        break;
+
+    default:
+        node["support_vectors"] >> m_supportVectors;
+        break;
+    }
+
+    //A malformed file must not make predictions read out of bounds
+    return IsConsistent();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Create the model directly from an OpenCV XML model file (see 
+//  SvmXmlParser) without creating an OpenCV model. The support vectors are
+//  parsed in parallel into a cache line aligned buffer.
+//
+// PARAMETERS:
+//  parser - parser with the model file open
+//
+// RETURNS:
+//  true if the model was created successfully
+///////////////////////////////////////////////////////////////////////////////
+bool SvmModel::ReadXml(const SvmXmlParser &parser)
+{
+    const SvmXmlParser::Element model = parser.GetModel();
+
+    //Only classification models with built in kernels are supported
+    std::string svmType;
+    std::string kernelName;
+    const SvmXmlParser::Element kernel = parser.Find(model, "kernel");
+    if (parser.GetText(parser.Find(model, "svmType"), svmType) == false ||
+        (svmType != "C_SVC" && svmType != "NU_SVC") ||
+        parser.GetText(parser.Find(kernel, "type"), kernelName) == false)
+    {
+        return false;
+    }
+
+    const std::pair<const char*, int> kernelTypes[] =
+    {
+        { "LINEAR", SVM::LINEAR }, { "POLY", SVM::POLY }, { "RBF", SVM::RBF },
+        { "SIGMOID", SVM::SIGMOID }, { "CHI2", SVM::CHI2 }, { "INTER", SVM::INTER }
+    };
+
+    m_kernelType = -1;
+    for (const auto &kernelType : kernelTypes)
+    {
+        if (kernelName == kernelType.first)
+        {
+            m_kernelType = kernelType.second;
+        }
+    }
+
+    //Kernel parameters are only written when the kernel uses them
+    m_gamma = 1;
+    m_coef0 = 0;
+    m_degree = 0;
+    parser.GetValue(parser.Find(kernel, "gamma"), m_gamma);
+    parser.GetValue(parser.Find(kernel, "coef0"), m_coef0);
+    parser.GetValue(parser.Find(kernel, "degree"), m_degree);
+
+    //Class labels are an OpenCV matrix
+    const SvmXmlParser::Element labels = parser.Find(model, "class_labels");
+    int labelRows = 0;
+    int labelCols = 0;
+    if (m_kernelType < 0 ||
+        parser.GetValue(parser.Find(model, "var_count"), m_varCount) == false ||
+        parser.GetValue(parser.Find(model, "sv_total"), m_svCount) == false ||
+        parser.GetValue(parser.Find(labels, "rows"), labelRows) == false ||
+        parser.GetValue(parser.Find(labels, "cols"), labelCols) == false ||
+        m_varCount <= 0 || m_svCount <= 0 || labelRows * labelCols < 2)
+    {
+        return false;
+    }
+
+    m_classLabels.resize(labelRows * labelCols);
+    if (parser.GetValues(parser.Find(labels, "data"), m_classLabels.data(), labelRows * labelCols) == false)
+    {
+        return false;
+    }
+
+    //Parse the support vectors straight into their final buffer
+    const size_t svSize = static_cast<size_t>(m_svCount) * m_varCount * sizeof(float);
+    std::shared_ptr<void> memory = ModelMemory::Allocate(svSize, -1, false);
+    if (memory == nullptr)
+    {
+        return false;
+    }
+
+    m_supportVectors = Mat(m_svCount, m_varCount, CV_32FC1, memory.get());
+    if (parser.GetRows(parser.Find(model, "support_vectors"), m_supportVectors.ptr<float>(), m_svCount, m_varCount) == false)
+    {
+        return false;
+    }
+    m_placedMemory = memory;
+
+    //Find the coefficients of each decision function
+    const int classCount = static_cast<int>(m_classLabels.size());
+    std::vector<SvmXmlParser::Element> functions;
+    parser.GetItems(parser.Find(model, "decision_functions"), functions);
+    if (static_cast<int>(functions.size()) != classCount * (classCount - 1) / 2)
+    {
+        return false;
+    }
+
+    m_decisionFunctions.clear();
+    for (const SvmXmlParser::Element &function : functions)
+    {
+        DecisionFunction df;
+        df.offset = m_decisionFunctions.empty() ? 0 : m_decisionFunctions.back().offset + m_decisionFunctions.back().count;
+        if (parser.GetValue(parser.Find(function, "sv_count"), df.count) == false ||
+            parser.GetValue(parser.Find(function, "rho"), df.rho) == false || df.count < 0)
+        {
+            return false;
+        }
+
+        m_decisionFunctions.push_back(df);
+    }
+
+    //Parse the coefficients of all decision functions in parallel
+    const size_t coefficientCount = m_decisionFunctions.back().offset + m_decisionFunctions.back().count;
+    m_alpha.resize(coefficientCount);
+    m_index.resize(coefficientCount);
+
+    std::atomic<bool> valid(true);
+    parallel_for_(Range(0, static_cast<int>(functions.size())), [&](const Range &range)
+    {
+        for (int i = range.start; i < range.end; i++)
+        {
+            const DecisionFunction &df = m_decisionFunctions[i];
+            double *alpha = m_alpha.data() + df.offset;
+            int *index = m_index.data() + df.offset;
+
+            if (parser.GetValues(parser.Find(functions[i], "alpha"), alpha, df.count) == false)
+            {
+                valid = false;
+            }
+
+            //Functions using every support vector are written without indices
+            const SvmXmlParser::Element indices = parser.Find(functions[i], "index");
+            if (indices.data() == nullptr && df.count == m_svCount)
+            {
+                for (int k = 0; k < df.count; k++)
+                {
+                    index[k] = k;
+                }
+            }
+            else if (parser.GetValues(indices, index, df.count) == false)
+            {
+                valid = false;
+            }
+        }
+    });
+
+    if (valid == false ||
+        std::any_of(m_index.begin(), m_index.end(), [&](int i) { return i < 0 || i >= m_svCount; }))
+    {
+        return false;
+    }
+
+    //Switch to a sparse layout if the support vectors are mostly zeros
+    ChooseLayout();
+    if (m_layout != LAYOUT_DENSE)
+    {
+        m_placedMemory.reset();
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the current support vector layout
+//
+// RETURNS:
+//  Support vector layout
+///////////////////////////////////////////////////////////////////////////////
+SvmModel::Layout SvmModel::GetLayout() const
+{
+    return m_layout;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the memory used by the support vectors in the current layout
+//
+// RETURNS:
+//  Size of the support vector data in bytes
+///////////////////////////////////////////////////////////////////////////////
+size_t SvmModel::GetMemoryUsage() const
+{
+    switch (m_layout)
+    {
+    case LAYOUT_SPARSE:
+        return (m_svValues.total() + m_svColumns.total() + m_svRowStart.total()) * sizeof(float);
+
+    case LAYOUT_LOW_RANK:
+        return (m_lowRankU.total() + m_lowRankV.total()) * sizeof(float);
+
+    case LAYOUT_PRODUCT_QUANTIZED:
+        return m_pqCodebooks.total() * sizeof(float) + m_pqCodes.total();
+
+    default:
+        return m_supportVectors.total() * sizeof(float);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the support vectors as a dense matrix. Compressed layouts return 
+//  their approximation of the support vectors.
+//
+// PARAMETERS:
+//  supportVectors - reference to return the support vectors (one per row)
+///////////////////////////////////////////////////////////////////////////////
+void SvmModel::GetSupportVectors(Mat &supportVectors) const
+{
+    switch (m_layout)
+    {
+    case LAYOUT_SPARSE:
+        supportVectors = Mat::zeros(m_svCount, m_varCount, CV_32FC1);
+        for (int i = 0; i < m_svCount; i++)
+        {
+            float *vec = supportVectors.ptr<float>(i);
+            for (int k = m_svRowStart.at<int>(i); k < m_svRowStart.at<int>(i + 1); k++)
+            {
+                vec[m_svColumns.at<int>(k)] = m_svValues.at<float>(k);
+            }
+        }
+        break;
+
+    case LAYOUT_LOW_RANK:
+        supportVectors = m_lowRankU * m_lowRankV;
+        break;
+
+    case LAYOUT_PRODUCT_QUANTIZED:
+        supportVectors = Mat::zeros(m_svCount, m_varCount, CV_32FC1);
+        for (int i = 0; i < m_svCount; i++)
+        {
+            float *vec = supportVectors.ptr<float>(i);
+            for (int m = 0; m < m_pqCodes.cols; m++)
+            {
+                const int first = m * m_pqSubspaceDim;
+                const int dim = std::min(m_pqSubspaceDim, m_varCount - first);
+                const float *centroid = m_pqCodebooks.ptr<float>(m * m_pqCentroids + m_pqCodes.at<uchar>(i, m));
+                std::copy(centroid, centroid + dim, vec + first);
+            }
+        }
+        break;
+
+    default:
+        supportVectors = m_supportVectors.clone();
+        break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Check if the model has been created
+//
+// RETURNS:
+//  true if the model can be used for prediction
+///////////////////////////////////////////////////////////////////////////////
+bool SvmModel::IsValid() const
+{
+    return m_decisionFunctions.empty() == false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Check the decision functions and support vector buffers of a model that
+//  was read or wrapped are consistent, so prediction stays in bounds: the
+//  kernel is known (and a dot product kernel unless the layout is dense, 
+//  as distance based kernels need the dense support vectors), the 
+//  coefficients index existing support vectors and the buffers of the 
+//  layout have the sizes of the support vector and feature counts.
+//
+// RETURNS:
+//  true if the model is consistent
+///////////////////////////////////////////////////////////////////////////////
+bool SvmModel::IsConsistent() const
+{
+    const bool dotKernel = (m_kernelType == SVM::LINEAR || m_kernelType == SVM::POLY || 
+                            m_kernelType == SVM::SIGMOID);
+    const bool distanceKernel = (m_kernelType == SVM::RBF || m_kernelType == SVM::CHI2 || 
+                                 m_kernelType == SVM::INTER);
+    if ((dotKernel == false && distanceKernel == false) || (distanceKernel && m_layout != LAYOUT_DENSE))
+    {
+        return false;
+    }
+
+    const int classCount = GetClassCount();
+    if (classCount < 2 || m_varCount <= 0 || m_svCount < 0 ||
+        static_cast<int>(m_decisionFunctions.size()) != classCount * (classCount - 1) / 2 ||
+        m_alpha.size() != m_index.size())
+    {
+        return false;
+    }
+
+    for (const DecisionFunction &df : m_decisionFunctions)
+    {
+        if (df.offset < 0 || df.count < 0 || static_cast<size_t>(df.offset) + df.count > m_alpha.size())
+        {
+            return false;
+        }
+    }
+
+    for (int sv : m_index)
+    {
+        if (sv < 0 || sv >= m_svCount)
+        {
+            return false;
+        }
+    }
+
+    switch (m_layout)
+    {
+    case LAYOUT_DENSE:
+        return m_supportVectors.type() == CV_32FC1 && m_supportVectors.rows == m_svCount && 
+               m_supportVectors.cols == m_varCount;
+
+    case LAYOUT_SPARSE:
+    {
+        const size_t nonZeroCount = m_svValues.total();
+        if (m_svValues.type() != CV_32FC1 || m_svColumns.type() != CV_32SC1 || m_svRowStart.type() != CV_32SC1 ||
+            m_svValues.isContinuous() == false || m_svColumns.isContinuous() == false || 
+            m_svRowStart.isContinuous() == false || m_svColumns.total() != nonZeroCount ||
+            m_svRowStart.total() != static_cast<size_t>(m_svCount) + 1)
+        {
+            return false;
+        }
+
+        //Row starts run from 0 to the number of values without decreasing
+        const int *rowStart = m_svRowStart.ptr<int>();
+        for (int i = 0; i < m_svCount; i++)
+        {
+            if (rowStart[i] > rowStart[i + 1])
+            {
+                return false;
+            }
+        }
+        if (rowStart[0] != 0 || static_cast<size_t>(rowStart[m_svCount]) != nonZeroCount)
+        {
+            return false;
+        }
+
+        const int *columns = m_svColumns.ptr<int>();
+        for (size_t k = 0; k < nonZeroCount; k++)
+        {
+            if (columns[k] < 0 || columns[k] >= m_varCount)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    case LAYOUT_LOW_RANK:
+        return m_lowRankU.type() == CV_32FC1 && m_lowRankV.type() == CV_32FC1 &&
+               m_lowRankU.rows == m_svCount && m_lowRankU.cols > 0 &&
+               m_lowRankV.rows == m_lowRankU.cols && m_lowRankV.cols == m_varCount;
+
+    case LAYOUT_PRODUCT_QUANTIZED:
+    {
+        if (m_pqSubspaceDim <= 0 || m_pqCentroids <= 0 || m_pqCentroids > 256)
+        {
+            return false;
+        }
+
+        const int subspaces = (m_varCount + m_pqSubspaceDim - 1) / m_pqSubspaceDim;
+        if (m_pqCodebooks.type() != CV_32FC1 || m_pqCodebooks.rows != subspaces * m_pqCentroids ||
+            m_pqCodebooks.cols != m_pqSubspaceDim || m_pqCodes.type() != CV_8UC1 ||
+            m_pqCodes.rows != m_svCount || m_pqCodes.cols != subspaces)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < m_pqCodes.rows; i++)
+        {
+            const unsigned char *codes = m_pqCodes.ptr<unsigned char>(i);
+            for (int m = 0; m < subspaces; m++)
+            {
+                if (codes[m] >= m_pqCentroids)
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of features per sample
+//
+// RETURNS:
+//  Number of features per sample
+///////////////////////////////////////////////////////////////////////////////
+int SvmModel::GetVarCount() const
+{
+    return m_varCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of classes
+//
+// RETURNS:
+//  Number of classes
+///////////////////////////////////////////////////////////////////////////////
+int SvmModel::GetClassCount() const
+{
+    return static_cast<int>(m_classLabels.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the class labels
+//
+// RETURNS:
+//  Label of each class
+///////////////////////////////////////////////////////////////////////////////
+const std::vector<int>& SvmModel::GetClassLabels() const
+{
+    return m_classLabels;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the number of support vectors
+//
+// RETURNS:
+//  Number of support vectors
+///////////////////////////////////////////////////////////////////////////////
+int SvmModel::GetSupportVectorCount() const
+{
+    return m_svCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get a one line description of the model for logging
+//
+// RETURNS:
+//  Description of the model size and support vector layout
+///////////////////////////////////////////////////////////////////////////////
+std::string SvmModel::Describe() const
+{
+    std::ostringstream description;
+    description << m_svCount << " support vectors x " << m_varCount << " features, "
+                << GetClassCount() << " classes, ";
+
+    if (m_layout == LAYOUT_LOW_RANK)
+    {
+        description << "low rank layout (rank " << m_lowRankV.rows << ", "
+                    << GetMemoryUsage() / 1024 << " KB)";
+        return description.str();
+    }
+
+    if (m_layout == LAYOUT_PRODUCT_QUANTIZED)
+    {
+        description << "product quantized layout (" << m_pqCodes.cols << " subspaces x " 
+                    << m_pqCentroids << " centroids, " << GetMemoryUsage() / 1024 << " KB)";
+        return description.str();
+    }
+
+    description
+                << (m_layout == LAYOUT_SPARSE ? "sparse" : "dense") << " layout ("
+                << static_cast<int>(m_density * 100 + 0.5) << "% non-zero, "
+                << "expected sparse speedup " << std::setprecision(2) << m_sparseSpeedup << "x)";
+
+    return description.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Predict the class of a sample by evaluating every one-vs-one decision
+//  function and taking the class with the most votes. Matches the result of
+//  cv::ml::SVM::predict.
+//
+// PARAMETERS:
+//  sample - pointer to the sample features
+//  prediction - optional pointer to return the votes and decision values
+//
+// RETURNS:
+//  Predicted class label
+///////////////////////////////////////////////////////////////////////////////
+float SvmModel::PredictVote(const float *sample, Prediction *prediction) const
+{
+    //Every support vector is used by at least one decision function so
+    //compute all of the kernel values up front
+    std::vector<double> kernel(m_svCount);
+    for (int k = 0; k < m_svCount; k++)
+    {
+        kernel[k] = Kernel(sample, k);
+    }
+
+    return Vote(kernel.data(), prediction);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Evaluate every one-vs-one decision function from precomputed kernel 
+//  values and take the class with the most votes
+//
+// PARAMETERS:
+//  kernel - kernel value of the sample with each support vector
+//  prediction - optional pointer to return the votes and decision values
+//
+// RETURNS:
+//  Predicted class label
+///////////////////////////////////////////////////////////////////////////////
+float SvmModel::Vote(const double *kernel, Prediction *prediction) const
+{
+    //Evaluate each pair of classes and vote for the winner
+    const int classCount = GetClassCount();
+    std::vector<int> votes(classCount, 0);
+
+    int dfi = 0;
+    for (int i = 0; i < classCount; i++)
+    {
+        for (int j = i + 1; j < classCount; j++, dfi++)
+        {
+            const DecisionFunction &df = m_decisionFunctions[dfi];
+            const double *alpha = &m_alpha[df.offset];
+            const int *index = &m_index[df.offset];
+
+            double sum = -df.rho;
+            for (int k = 0; k < df.count; k++)
+            {
+                sum += alpha[k] * kernel[index[k]];
+            }
+
+            votes[sum > 0 ? i : j]++;
+            AddDecision(i, j, sum, prediction);
+        }
+    }
+
+    //Class with the most votes wins, ties go to the lowest class
+    int best = 0;
+    for (int i = 1; i < classCount; i++)
+    {
+        if (votes[i] > votes[best])
+        {
+            best = i;
+        }
+    }
+
+    return static_cast<float>(m_classLabels[best]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Predict the class of a sample by traversing a decision DAG. The first and
+//  last remaining candidate classes are compared and the loser is removed
+//  until one class remains, so only class count - 1 decision functions are
+//  evaluated. Kernel values are computed lazily so only the support vectors
+//  of the visited decision functions are touched.
+//
+// PARAMETERS:
+//  sample - pointer to the sample features
+//  prediction - optional pointer to return the votes and decision values
+//
+// RETURNS:
+//  Predicted class label
+///////////////////////////////////////////////////////////////////////////////
+float SvmModel::PredictDag(const float *sample, Prediction *prediction) const
+{
+    //Kernel values shared between decision functions are only computed once
+    std::vector<double> kernel(m_svCount);
+    std::vector<uchar> computed(m_svCount, 0);
+
+    int first = 0;
+    int last = GetClassCount() - 1;
+    while (first < last)
+    {
+        const DecisionFunction &df = m_decisionFunctions[DecisionIndex(first, last)];
+        const double *alpha = &m_alpha[df.offset];
+        const int *index = &m_index[df.offset];
+
+        double sum = -df.rho;
+        for (int k = 0; k < df.count; k++)
+        {
+            const int sv = index[k];
+            if (computed[sv] == 0)
+            {
+                kernel[sv] = Kernel(sample, sv);
+                computed[sv] = 1;
+            }
+
+            sum += alpha[k] * kernel[sv];
+        }
+
+        AddDecision(first, last, sum, prediction);
+
+        //Remove the losing class from the candidates
+        if (sum > 0)
+        {
+            last--;
+        }
+        else
+        {
+            first++;
+        }
+    }
+
+    return static_cast<float>(m_classLabels[first]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Measure the sparsity of the support vectors and switch to a compressed 
+//  sparse row layout when the sparse dot product is expected to be faster. 
+//  HOG descriptors of binary digits are mostly zeros since empty cells have 
+//  no gradients. Only kernels of the dot product use the sparse layout.
+///////////////////////////////////////////////////////////////////////////////
+void SvmModel::ChooseLayout()
+{
+    //Relative cost of a sparse multiply-add (index load and gather) compared 
+    //with a dense one, and the speedup required to change layout
+    const double sparseCost = 1.5;
+    const double minSpeedup = 1.25;
+
+    const int nonZero = countNonZero(m_supportVectors);
+    m_density = (m_supportVectors.total() > 0) ? 
+                static_cast<double>(nonZero) / m_supportVectors.total() : 1.0;
+    m_sparseSpeedup = 1.0 / (sparseCost * std::max(m_density, 1e-6));
+
+    const bool dotKernel = (m_kernelType == SVM::LINEAR || m_kernelType == SVM::POLY || 
+                            m_kernelType == SVM::SIGMOID);
+    if (dotKernel == false || m_sparseSpeedup < minSpeedup)
+    {
+        m_layout = LAYOUT_DENSE;
+        return;
+    }
+
+    //Build the compressed sparse rows and release the dense copy
+    m_svValues.create(nonZero, 1, CV_32FC1);
+    m_svColumns.create(nonZero, 1, CV_32SC1);
+    m_svRowStart.create(m_svCount + 1, 1, CV_32SC1);
+
+    float *values = m_svValues.ptr<float>();
+    int *columns = m_svColumns.ptr<int>();
+    int *rowStart = m_svRowStart.ptr<int>();
+
+    int count = 0;
+    for (int i = 0; i < m_svCount; i++)
+    {
+        rowStart[i] = count;
+
+        const float *vec = m_supportVectors.ptr<float>(i);
+        for (int k = 0; k < m_varCount; k++)
+        {
+            if (vec[k] != 0)
+            {
+                values[count] = vec[k];
+                columns[count] = k;
+                count++;
+            }
+        }
+    }
+    rowStart[m_svCount] = count;
+
+    m_supportVectors.release();
+    m_layout = LAYOUT_SPARSE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Record the result of a pairwise decision function in a prediction
+//
+// PARAMETERS:
+//  i - first class of the pair
+//  j - second class of the pair
+//  sum - decision value (positive in favour of class i)
+//  prediction - optional pointer to the prediction to update
+///////////////////////////////////////////////////////////////////////////////
+void SvmModel::AddDecision(int i, int j, double sum, Prediction *prediction) const
+{
+    if (prediction != nullptr)
+    {
+        prediction->votes[sum > 0 ? i : j]++;
+        prediction->margins[i] += static_cast<float>(sum);
+        prediction->margins[j] -= static_cast<float>(sum);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Evaluate the kernel function between a sample and a support vector. The
+//  kernels are computed the same way as cv::ml::SVM so the trained
+//  coefficients remain valid.
+//
+// PARAMETERS:
+//  sample - pointer to the sample features
+//  sv - index of the support vector
+//
+// RETURNS:
+//  Kernel value
+///////////////////////////////////////////////////////////////////////////////
+double SvmModel::Kernel(const float *sample, int sv) const
+{
+    //Distance based kernels always use the dense layout
+    const float *vec = (m_layout == LAYOUT_DENSE) ? m_supportVectors.ptr<float>(sv) : nullptr;
+
+    switch (m_kernelType)
+    {
+    case SVM::RBF:
+        return std::exp(-m_gamma * SimdKernels::SquaredDistance(sample, vec, m_varCount));
+
+    case SVM::CHI2:
+    {
+        double s = 0;
+        for (int k = 0; k < m_varCount; k++)
+        {
+            const double d = sample[k] - vec[k];
+            const double divisor = sample[k] + vec[k];
+            if (divisor != 0)
+            {
+                s += d * d / divisor;
+            }
+        }
+        return std::exp(-m_gamma * s);
+    }
+
+    case SVM::INTER:
+    {
+        double s = 0;
+        for (int k = 0; k < m_varCount; k++)
+        {
+            s += std::min(sample[k], vec[k]);
+        }
+        return s;
+    }
+
+    default:
+        break;
+    }
+
+    //Remaining kernels are functions of the dot product
+    const double s = DotProduct(sample, sv);
+
+    switch (m_kernelType)
+    {
+    case SVM::POLY:
+        return std::pow(m_gamma * s + m_coef0, m_degree);
+
+    case SVM::SIGMOID:
+        return std::tanh(-(m_gamma * s + m_coef0));
+
+    default:
+        return s;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Compute the dot product of a sample and a support vector in the current 
+//  support vector layout
+//
+// PARAMETERS:
+//  sample - pointer to the sample features
+//  sv - index of the support vector
+//
+// RETURNS:
+//  Dot product
+///////////////////////////////////////////////////////////////////////////////
+double SvmModel::DotProduct(const float *sample, int sv) const
+{
+    if (m_layout == LAYOUT_PRODUCT_QUANTIZED)
+    {
+        //Sample is the lookup table built by PrepareSample()
+        return SimdKernels::LookupSum(sample, m_pqCodes.ptr<uchar>(sv), m_pqCodes.cols, m_pqCentroids);
+    }
+
+    if (m_layout == LAYOUT_LOW_RANK)
+    {
+        //Sample has already been projected by PrepareSample()
+        return SimdKernels::DotProduct(sample, m_lowRankU.ptr<float>(sv), m_lowRankU.cols);
+    }
+
+    if (m_layout == LAYOUT_SPARSE)
+    {
+        const int *rowStart = m_svRowStart.ptr<int>();
+        const int start = rowStart[sv];
+        const int count = rowStart[sv + 1] - start;
+        const float *values = m_svValues.ptr<float>() + start;
+        const int *columns = m_svColumns.ptr<int>() + start;
+
+        return SimdKernels::SparseDotProduct(values, columns, count, sample);
+    }
+
+    return SimdKernels::DotProduct(sample, m_supportVectors.ptr<float>(sv), m_varCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Transform a sample into the form DotProduct() expects for the current 
+//  support vector layout. Low rank models project the sample onto the rows 
+//  of the V factor. Product quantized models build a lookup table of the dot 
+//  products of each sample subspace with every centroid of that subspace.
+//
+// PARAMETERS:
+//  sample - pointer to the sample features
+//  buffer - storage for the transformed sample
+//
+// RETURNS:
+//  Pointer to the transformed sample (sample itself for other layouts)
+///////////////////////////////////////////////////////////////////////////////
+const float* SvmModel::PrepareSample(const float *sample, std::vector<float> &buffer) const
+{
+    if (m_layout == LAYOUT_LOW_RANK)
+    {
+        buffer.resize(m_lowRankV.rows);
+        for (int r = 0; r < m_lowRankV.rows; r++)
+        {
+            buffer[r] = static_cast<float>(SimdKernels::DotProduct(sample, m_lowRankV.ptr<float>(r), m_varCount));
+        }
+
+        return buffer.data();
+    }
+
+    if (m_layout == LAYOUT_PRODUCT_QUANTIZED)
+    {
+        buffer.resize(m_pqCodebooks.rows);
+        for (int m = 0; m < m_pqCodes.cols; m++)
+        {
+            //Last subspace may be shorter than the codebook (padded with zeros)
+            const int first = m * m_pqSubspaceDim;
+            const int dim = std::min(m_pqSubspaceDim, m_varCount - first);
+
+            for (int c = 0; c < m_pqCentroids; c++)
+            {
+                const int row = m * m_pqCentroids + c;
+                buffer[row] = static_cast<float>(SimdKernels::DotProduct(sample + first, m_pqCodebooks.ptr<float>(row), dim));
+            }
+        }
+
+        return buffer.data();
+    }
+
+    return sample;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the index of the decision function separating two classes
+//
+// PARAMETERS:
+//  i - first class (i < j)
+//  j - second class
+//
+// RETURNS:
+//  Index into the decision function array
+///////////////////////////////////////////////////////////////////////////////
+int SvmModel::DecisionIndex(int i, int j) const
+{
+    const int classCount = GetClassCount();
+    return i * (2 * classCount - i - 1) / 2 + (j - i - 1);
+}
@@ -0,0 +1,195 @@
+/******************************************************************************
+
+    FILENAME:       SvmModel.h
+
+    DESCRIPTION:    Inference engine for a trained SVM. The support vectors and
+                    one-vs-one decision functions of an OpenCV SVM model are
+                    copied into flat arrays so that prediction can be done
+                    without going through cv::ml::SVM::predict
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "opencv2/opencv.hpp"
+#include "SvmKernel.h"
+#include "SvmXmlParser.h"
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class SvmModel
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Types
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    //Method used to combine the one-vs-one decision functions
+    enum PredictMode
+    {
+        PREDICT_VOTE,   //Evaluate all class pairs and take the max-wins vote
+        PREDICT_DAG     //Traverse a decision DAG (class count - 1 evaluations)
+    };
+
+    //Storage layout of the support vectors
+    enum Layout
+    {
+        LAYOUT_DENSE,   //One dense row per support vector
+        LAYOUT_SPARSE,  //Compressed sparse rows (non-zero values and columns)
+        LAYOUT_LOW_RANK,//Low rank factors U * V of the support vector matrix
+        LAYOUT_PRODUCT_QUANTIZED //Byte codes into per-subspace codebooks
+    };
+
+    //One-vs-one decision function for a pair of classes
+    struct DecisionFunction
+    {
+        double rho;     //Decision function offset
+        int    offset;  //Index of the first coefficient in alpha/index arrays
+        int    count;   //Number of support vectors used by the function
+    };
+
+    //Model compiled into an executable as read-only buffers (see 
+    //WriteSource()). Only the buffers of the model's layout are set, the 
+    //rest are null.
+    struct StaticModel
+    {
+        int    kernelType;
+        double gamma;
+        double coef0;
+        double degree;
+        int    varCount;
+        int    svCount;
+        int    classCount;
+        Layout layout;
+        double density;
+        const float *supportVectors;            //LAYOUT_DENSE: svCount x varCount
+        int    nonZeroCount;
+        const float *svValues;                  //LAYOUT_SPARSE: nonZeroCount values
+        const int *svColumns;                   //LAYOUT_SPARSE: nonZeroCount columns
+        const int *svRowStart;                  //LAYOUT_SPARSE: svCount + 1 row starts
+        int    rank;
+        const float *lowRankU;                  //LAYOUT_LOW_RANK: svCount x rank
+        const float *lowRankV;                  //LAYOUT_LOW_RANK: rank x varCount
+        int    pqSubspaceDim;
+        int    pqCentroids;
+        const float *pqCodebooks;               //LAYOUT_PRODUCT_QUANTIZED: (subspaces * centroids) x subspace dim
+        const unsigned char *pqCodes;           //LAYOUT_PRODUCT_QUANTIZED: svCount x subspaces
+        const int *classLabels;                 //classCount labels
+        const DecisionFunction *decisionFunctions; //classCount * (classCount - 1) / 2 functions
+        int    coefficientCount;
+        const double *alpha;                    //coefficientCount coefficients
+        const int *index;                       //coefficientCount support vector indices
+    };
+
+    //Prediction with the decision values it was made from. Margins are the
+    //sum of the pairwise decision values in favour of each class, so for a
+    //binary model margins[1] == -margins[0] is the signed distance from the
+    //separating hyperplane (positive for the second class label). In DAG mode
+    //only the evaluated pairs contribute to the votes and margins.
+    struct Prediction
+    {
+        float              label;    //Predicted class label
+        float              decision; //Decision value of a binary model (margins[1])
+        std::vector<int>   votes;    //Number of pairwise wins of each class
+        std::vector<float> margins;  //Summed pairwise decision values of each class
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    SvmModel();
+    virtual ~SvmModel();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    bool  Create(const cv::Ptr<cv::ml::SVM> &svm, const std::vector<int> &classLabels);
+    bool  Create(const SvmKernel &kernel, const cv::Mat &supportVectors, 
+                 const std::vector<DecisionFunction> &decisionFunctions, const std::vector<double> &alpha,
+                 const std::vector<int> &index, const std::vector<int> &classLabels);
+    bool  SetLowRank(const cv::Mat &u, const cv::Mat &v);
+    bool  Quantize(int subspaceDim, int centroids);
+    bool  Place(int numaNode, bool hugePages);
+    bool  Wrap(const StaticModel &model);
+    void  Write(cv::FileStorage &fs) const;
+    bool  Read(const cv::FileNode &node);
+    bool  ReadXml(const SvmXmlParser &parser);
+    bool  WriteSource(std::ostream &source, std::ostream &binary, const std::string &name,
+                      const std::string &binaryFilename) const;
+    float Predict(const float *sample, PredictMode mode, Prediction *prediction = nullptr) const;
+    void  PredictBatch(const cv::Mat &samples, PredictMode mode, std::vector<Prediction> &predictions) const;
+    bool  IsValid() const;
+
+    int   GetVarCount() const;
+    int   GetClassCount() const;
+    int   GetSupportVectorCount() const;
+    const std::vector<int>& GetClassLabels() const;
+    Layout GetLayout() const;
+    size_t GetMemoryUsage() const;
+    void  GetSupportVectors(cv::Mat &supportVectors) const;
+    std::string Describe() const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    float  PredictVote(const float *sample, Prediction *prediction) const;
+    float  PredictDag(const float *sample, Prediction *prediction) const;
+    float  Vote(const double *kernel, Prediction *prediction) const;
+    void   AddDecision(int i, int j, double sum, Prediction *prediction) const;
+    void   ChooseLayout();
+    bool   IsConsistent() const;
+    double Kernel(const float *sample, int sv) const;
+    double DotProduct(const float *sample, int sv) const;
+    const float* PrepareSample(const float *sample, std::vector<float> &buffer) const;
+    int    DecisionIndex(int i, int j) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    int    m_kernelType;
+    double m_gamma;
+    double m_coef0;
+    double m_degree;
+    int    m_varCount;
+    int    m_svCount;
+
+    //Support vectors in the layout chosen when the model was created
+    Layout             m_layout;
+    double             m_density;        //Fraction of non-zero support vector values
+    double             m_sparseSpeedup;  //Expected dot product speedup of the sparse layout
+    cv::Mat            m_supportVectors; //LAYOUT_DENSE: one support vector per row (CV_32FC1)
+    cv::Mat            m_svValues;       //LAYOUT_SPARSE: non-zero values (CV_32FC1)
+    cv::Mat            m_svColumns;      //LAYOUT_SPARSE: column of each non-zero value (CV_32SC1)
+    cv::Mat            m_svRowStart;     //LAYOUT_SPARSE: first value of each support vector (CV_32SC1)
+    cv::Mat            m_lowRankU;       //LAYOUT_LOW_RANK: support vectors x rank (CV_32FC1)
+    cv::Mat            m_lowRankV;       //LAYOUT_LOW_RANK: rank x features (CV_32FC1)
+    int                m_pqSubspaceDim;  //LAYOUT_PRODUCT_QUANTIZED: features per subspace
+    int                m_pqCentroids;    //LAYOUT_PRODUCT_QUANTIZED: centroids per subspace
+    cv::Mat            m_pqCodebooks;    //LAYOUT_PRODUCT_QUANTIZED: (subspaces * centroids) x subspace dim
+    cv::Mat            m_pqCodes;        //LAYOUT_PRODUCT_QUANTIZED: support vectors x subspaces (CV_8UC1)
+
+    std::vector<DecisionFunction> m_decisionFunctions; //Ordered (0,1), (0,2) ... (n-2,n-1)
+    std::vector<double>           m_alpha;             //Coefficients of all decision functions
+    std::vector<int>              m_index;             //Support vector index of each coefficient
+    std::vector<int>              m_classLabels;       //Label returned for each class
+
+    //Memory holding the support vector buffers after Place() is called
+    std::shared_ptr<void> m_placedMemory;
+
+};
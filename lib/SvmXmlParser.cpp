@@ -0,0 +1,378 @@
+/******************************************************************************
+
+    FILENAME:       SvmXmlParser.cpp
+
+    DESCRIPTION:    Fast reader for the OpenCV XML model file schema
+                    (opencv_ml_svm). The file is memory mapped and elements
+                    are located by scanning for their tags, without building
+                    a node tree. Large number lists such as the support
+                    vectors are split into chunks and parsed in parallel with
+                    std::from_chars straight into the caller's buffers.
+
+    AUTHOR:         David Sharpe
+
+******************************************************************************/
+#include "SvmXmlParser.h"
+#include "opencv2/opencv.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+
+using namespace cv;
+
+//Start and end tags of the items of a list
+static const std::string_view ITEM_START = "<_>";
+static const std::string_view ITEM_END = "</_>";
+
+//Chunks each thread parses when parsing rows in parallel
+static const int CHUNKS_PER_THREAD = 4;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//  Default constructor
+///////////////////////////////////////////////////////////////////////////////
+SvmXmlParser::SvmXmlParser()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Destructor
+///////////////////////////////////////////////////////////////////////////////
+SvmXmlParser::~SvmXmlParser()
+{
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Map an XML model file and locate the opencv_ml_svm element
+//
+// PARAMETERS:
+//  filename - path to the model file
+//
+// RETURNS:
+//  true if the file is an XML file holding an OpenCV SVM model
+///////////////////////////////////////////////////////////////////////////////
+bool SvmXmlParser::Open(const std::string &filename)
+{
+    m_model = Element();
+    m_trailer = Element();
+
+    if (m_file.Open(filename) == false)
+    {
+        return false;
+    }
+
+    const Element document(reinterpret_cast<const char*>(m_file.GetData()), m_file.GetSize());
+    const Element storage = Find(document, "opencv_storage");
+    m_model = Find(storage, "opencv_ml_svm");
+    if (m_model.data() == nullptr)
+    {
+        m_file.Close();
+        return false;
+    }
+
+    const size_t modelEnd = static_cast<size_t>(m_model.data() + m_model.size() - storage.data());
+    m_trailer = storage.substr(modelEnd);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the content of the opencv_ml_svm element
+//
+// RETURNS:
+//  Model element
+///////////////////////////////////////////////////////////////////////////////
+SvmXmlParser::Element SvmXmlParser::GetModel() const
+{
+    return m_model;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the part of the document after the model, which holds any extension
+//  nodes saved with the model (e.g. feature_map or low_rank)
+//
+// RETURNS:
+//  Document content after the model element
+///////////////////////////////////////////////////////////////////////////////
+SvmXmlParser::Element SvmXmlParser::GetTrailer() const
+{
+    return m_trailer;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Find the first element with a name inside a parent element
+//
+// PARAMETERS:
+//  parent - element to search
+//  name - element name
+//
+// RETURNS:
+//  Content of the element (null data if it was not found)
+///////////////////////////////////////////////////////////////////////////////
+SvmXmlParser::Element SvmXmlParser::Find(const Element &parent, const char *name) const
+{
+    const std::string start = std::string("<") + name;
+    const std::string end = std::string("</") + name + ">";
+
+    size_t pos = 0;
+    while ((pos = parent.find(start, pos)) != Element::npos)
+    {
+        //Skip longer names starting with the same characters
+        pos += start.size();
+        if (pos < parent.size() && (parent[pos] == '>' || std::isspace(static_cast<unsigned char>(parent[pos]))))
+        {
+            const size_t contentStart = parent.find('>', pos);
+            const size_t contentEnd = (contentStart != Element::npos) ? parent.find(end, contentStart) : Element::npos;
+            if (contentEnd == Element::npos)
+            {
+                break;
+            }
+
+            return parent.substr(contentStart + 1, contentEnd - contentStart - 1);
+        }
+    }
+
+    return Element();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the items of a list element (<_> elements)
+//
+// PARAMETERS:
+//  list - list element
+//  items - reference to return the content of each item
+///////////////////////////////////////////////////////////////////////////////
+void SvmXmlParser::GetItems(const Element &list, std::vector<Element> &items) const
+{
+    items.clear();
+
+    size_t pos = 0;
+    while ((pos = list.find(ITEM_START, pos)) != Element::npos)
+    {
+        pos += ITEM_START.size();
+        const size_t end = list.find(ITEM_END, pos);
+        if (end == Element::npos)
+        {
+            break;
+        }
+
+        items.push_back(list.substr(pos, end - pos));
+        pos = end + ITEM_END.size();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Get the text of an element without surrounding white space
+//
+// PARAMETERS:
+//  element - element
+//  text - reference to return the text
+//
+// RETURNS:
+//  true if the element exists
+///////////////////////////////////////////////////////////////////////////////
+bool SvmXmlParser::GetText(const Element &element, std::string &text) const
+{
+    if (element.data() == nullptr)
+    {
+        return false;
+    }
+
+    size_t first = 0;
+    size_t last = element.size();
+    while (first < last && std::isspace(static_cast<unsigned char>(element[first])))
+    {
+        first++;
+    }
+    while (last > first && std::isspace(static_cast<unsigned char>(element[last - 1])))
+    {
+        last--;
+    }
+
+    text.assign(element.data() + first, last - first);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Parse the value of a scalar element
+//
+// PARAMETERS:
+//  element - element
+//  value - reference to return the value
+//
+// RETURNS:
+//  true if the element holds a number
+///////////////////////////////////////////////////////////////////////////////
+bool SvmXmlParser::GetValue(const Element &element, int &value) const
+{
+    return GetValues(element, &value, 1);
+}
+
+bool SvmXmlParser::GetValue(const Element &element, double &value) const
+{
+    return GetValues(element, &value, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Parse a white space separated list of numbers
+//
+// PARAMETERS:
+//  element - element holding the list
+//  values - pointer to return the values
+//  count - number of values to parse
+//
+// RETURNS:
+//  true if the element holds at least count numbers
+///////////////////////////////////////////////////////////////////////////////
+bool SvmXmlParser::GetValues(const Element &element, float *values, int count) const
+{
+    return element.data() != nullptr &&
+           ParseValues(element.data(), element.data() + element.size(), values, count) != nullptr;
+}
+
+bool SvmXmlParser::GetValues(const Element &element, double *values, int count) const
+{
+    return element.data() != nullptr &&
+           ParseValues(element.data(), element.data() + element.size(), values, count) != nullptr;
+}
+
+bool SvmXmlParser::GetValues(const Element &element, int *values, int count) const
+{
+    return element.data() != nullptr &&
+           ParseValues(element.data(), element.data() + element.size(), values, count) != nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Parse a list of rows of numbers (a list of <_> items of cols values
+//  each) into a matrix. The list is split into chunks of roughly equal size
+//  that are parsed in parallel. Rows belong to the chunk their start tag
+//  is in, so the rows of each chunk are counted first to find where each
+//  chunk's rows go.
+//
+// PARAMETERS:
+//  list - list element
+//  data - pointer to return the values (rows x cols, row major)
+//  rows - number of rows
+//  cols - number of values in each row
+//
+// RETURNS:
+//  true if the list holds exactly rows rows of cols numbers
+///////////////////////////////////////////////////////////////////////////////
+bool SvmXmlParser::GetRows(const Element &list, float *data, int rows, int cols) const
+{
+    if (list.data() == nullptr || rows <= 0 || cols <= 0)
+    {
+        return false;
+    }
+
+    const int chunkCount = std::max(1, std::min(rows, getNumThreads() * CHUNKS_PER_THREAD));
+    std::vector<size_t> chunkStart(chunkCount + 1);
+    for (int c = 0; c <= chunkCount; c++)
+    {
+        chunkStart[c] = list.size() * c / chunkCount;
+    }
+
+    //Count the rows starting in each chunk
+    std::vector<int> chunkRows(chunkCount, 0);
+    parallel_for_(Range(0, chunkCount), [&](const Range &range)
+    {
+        for (int c = range.start; c < range.end; c++)
+        {
+            size_t pos = chunkStart[c];
+            while ((pos = list.find(ITEM_START, pos)) < chunkStart[c + 1])
+            {
+                chunkRows[c]++;
+                pos += ITEM_START.size();
+            }
+        }
+    });
+
+    std::vector<int> firstRow(chunkCount + 1, 0);
+    for (int c = 0; c < chunkCount; c++)
+    {
+        firstRow[c + 1] = firstRow[c] + chunkRows[c];
+    }
+    if (firstRow[chunkCount] != rows)
+    {
+        return false;
+    }
+
+    //Parse each chunk's rows into place
+    std::atomic<bool> valid(true);
+    parallel_for_(Range(0, chunkCount), [&](const Range &range)
+    {
+        const char *listEnd = list.data() + list.size();
+        for (int c = range.start; c < range.end && valid; c++)
+        {
+            size_t pos = chunkStart[c];
+            for (int row = firstRow[c]; row < firstRow[c + 1]; row++)
+            {
+                pos = list.find(ITEM_START, pos) + ITEM_START.size();
+                const char *end = ParseValues(list.data() + pos, listEnd, data + static_cast<size_t>(row) * cols, cols);
+
+                //Each row must end after exactly cols values
+                while (end != nullptr && end < listEnd && std::isspace(static_cast<unsigned char>(*end)))
+                {
+                    end++;
+                }
+                if (end == nullptr || Element(end, listEnd - end).substr(0, ITEM_END.size()) != ITEM_END)
+                {
+                    valid = false;
+                    break;
+                }
+                pos = static_cast<size_t>(end - list.data());
+            }
+        }
+    });
+
+    return valid;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DESCRIPTION:
+//  Parse white space separated numbers
+//
+// PARAMETERS:
+//  begin - first character to parse
+//  end - one past the last character that may be parsed
+//  values - pointer to return the values
+//  count - number of values to parse
+//
+// RETURNS:
+//  Pointer to the character after the last value (null if fewer than count
+//  numbers were found)
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+const char *SvmXmlParser::ParseValues(const char *begin, const char *end, T *values, int count)
+{
+    const char *next = begin;
+    for (int i = 0; i < count; i++)
+    {
+        while (next < end && std::isspace(static_cast<unsigned char>(*next)))
+        {
+            next++;
+        }
+
+        const std::from_chars_result result = std::from_chars(next, end, values[i]);
+        if (result.ec != std::errc())
+        {
+            return nullptr;
+        }
+        next = result.ptr;
+    }
+
+    return next;
+}
@@ -0,0 +1,84 @@
+/******************************************************************************
+
+    FILENAME:       SvmXmlParser.h
+
+    DESCRIPTION:    Fast reader for the OpenCV XML model file schema
+                    (opencv_ml_svm). The file is memory mapped and elements
+                    are located by scanning for their tags, without building
+                    a node tree. Large number lists such as the support
+                    vectors are split into chunks and parsed in parallel with
+                    std::from_chars straight into the caller's buffers.
+
+    AUTHOR:         David Sharpe
+
+    DEPENDENCIES:   OpenCV 2.4.x
+
+******************************************************************************/
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Include Files
+///////////////////////////////////////////////////////////////////////////////
+#include "MappedFile.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Class Definition
+///////////////////////////////////////////////////////////////////////////////
+class SvmXmlParser
+{
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Types
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    //Content of an element (between its start and end tags), empty data if
+    //the element was not found
+    typedef std::string_view Element;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Construction/Destruction
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    SvmXmlParser();
+    virtual ~SvmXmlParser();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    ///////////////////////////////////////////////////////////////////////////
+public:
+    bool    Open(const std::string &filename);
+    Element GetModel() const;
+    Element GetTrailer() const;
+    Element Find(const Element &parent, const char *name) const;
+    void    GetItems(const Element &list, std::vector<Element> &items) const;
+
+    bool    GetText(const Element &element, std::string &text) const;
+    bool    GetValue(const Element &element, int &value) const;
+    bool    GetValue(const Element &element, double &value) const;
+    bool    GetValues(const Element &element, float *values, int count) const;
+    bool    GetValues(const Element &element, double *values, int count) const;
+    bool    GetValues(const Element &element, int *values, int count) const;
+    bool    GetRows(const Element &list, float *data, int rows, int cols) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    template <typename T>
+    static const char *ParseValues(const char *begin, const char *end, T *values, int count);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    ///////////////////////////////////////////////////////////////////////////
+private:
+    MappedFile m_file;
+
+    //Content of the opencv_ml_svm element and the rest of the document after it
+    Element m_model;
+    Element m_trailer;
+
+};